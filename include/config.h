@@ -7,14 +7,18 @@
 #include <pthread.h>
 #include <signal.h>
 #include <sys/time.h>
+#include "digest.h"
+#include "pattern.h"
 
 // 宏定义
-#define MAX_EXCLUDE_PATTERNS 16
-#define MAX_INCLUDE_PATTERNS 16
 #define MAX_SOURCE_DIRS 32
 #define MAX_MANIFEST_FILES 32
 #define MAX_PATH 4096
 #define MAX_PROGRESS_BARS 32  // 新增：最大进度条数量
+#define MIN_MEMORY_LIMIT (16UL * 1024 * 1024)  // --memory-limit 下限
+#define MAX_THREADS 256       // --threads / MIRRORGUARD_THREADS 上限
+#define DEFAULT_TREE_BLOCK_SIZE (16UL * 1024 * 1024)  // 树哈希默认块大小
+#define MIN_TREE_BLOCK_SIZE (64UL * 1024)
 
 // TUI 模式
 typedef enum {
@@ -26,6 +30,19 @@ typedef enum {
     TUI_MODE_DEBUG          // 调试 TUI
 } TuiMode;
 
+// 读取引擎 (--io-engine)
+typedef enum {
+    IO_ENGINE_SYNC = 0,     // read() 同步读取（默认）
+    IO_ENGINE_URING         // io_uring 批量异步读取，不可用时回退到同步
+} IoEngine;
+
+// 页缓存策略 (--cache-mode)
+typedef enum {
+    CACHE_MODE_NORMAL = 0,  // 正常经过页缓存（默认）
+    CACHE_MODE_DONTNEED,    // 读后 posix_fadvise(DONTNEED) 丢弃
+    CACHE_MODE_DIRECT       // O_DIRECT 绕过页缓存，不支持时退回 DONTNEED
+} CacheMode;
+
 // 日志级别
 typedef enum { LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG, LOG_TRACE } LogLevel;
 
@@ -70,7 +87,9 @@ typedef struct {
     volatile size_t current;       // 当前进度
     volatile size_t total;         // 总量
     volatile double speed;         // 速度 (bytes/s)
+    volatile double eta;           // 预计剩余秒数，<0 表示未知
     volatile time_t last_update;   // 最后更新时间
+    volatile size_t last_current;  // last_update 时的进度，用于计算速度
     volatile int active;           // 是否活跃
     volatile int finished;         // 是否完成
     pthread_mutex_t lock;          // 线程锁
@@ -89,6 +108,7 @@ typedef struct {
     int dry_run;
     int force_overwrite;
     int threads;
+    int scan_threads;              // 目录遍历线程数 (0 表示与 threads 相同)
     int recursive;
     int preserve_timestamps;
     int case_sensitive;
@@ -96,11 +116,31 @@ typedef struct {
     int tui_mode;                  // 新增：TUI 模式
     ProgressStyle progress_style;  // 新增：进度条样式
     ProgressColor progress_color;  // 新增：进度条颜色
-    const char *exclude_patterns[MAX_EXCLUDE_PATTERNS];
-    int exclude_count;
-    const char *include_patterns[MAX_INCLUDE_PATTERNS];
-    int include_count;
-    const char *output_format; // "sha256sum", "json", "csv"
+    DigestAlgo digest_algo;        // 摘要算法 (--algo，验证/比较时取自清单头)
+    int tree_hash;                 // 大文件分块并行哈希 (树哈希)
+    size_t tree_block_size;        // 树哈希块大小
+    const char *block_list_path;   // 验证时使用的块摘要文件 (<清单>.blocks)
+    IoEngine io_engine;            // 哈希读取引擎
+    CacheMode cache_mode;          // 哈希读取的页缓存策略
+    const char *hash_cache_path;   // 持久哈希缓存文件 (--hash-cache)
+    int rehash;                    // 忽略缓存命中，全部重新计算
+    long cache_max_age;            // 未再出现的缓存条目保留秒数，<0 表示永久保留
+    PatternSet *exclude_patterns;  // 排除模式 (-x)，解析参数后编译
+    PatternSet *include_patterns;  // 包含模式 (-i)，只作用于文件
+    int ignore_files;              // 遍历时读取各目录的 .mirrorguardignore
+    const char *output_format; // "mirrorguard" (带大小字段), "sha256sum", "mgidx" (二进制)
+    int record_mtime;              // 清单中同时记录 mtime
+    int compress;                  // 文本清单写成分块压缩格式 (-z)
+    int shard_index;               // 本节点处理的分片 (--shard=i/N，1 起)，shard_count 为 0 表示不分片
+    int shard_count;
+    int shard_by_dir;              // 按首级目录分片 (--shard-by=dir)
+    const char *report_path;       // 验证结果报告 (--report)，供 --merge 汇总各分片
+    const char *coordinator_addr;  // 生成时作为协调器监听的地址 (--coordinator)，文件交给 worker 进程哈希
+    const char *worker_addr;       // worker 模式连接的协调器地址 (--worker)
+    int lease_timeout;             // worker 租约秒数 (--lease-timeout)，超时未响应的批次重新分配
+    int resume;                    // 从续传日志恢复上次中断的生成/验证 (--resume)
+    const char *journal_path;      // 续传日志路径 (--journal，默认 <清单>.journal / <清单>.verify-journal)
+    size_t memory_limit;           // 文件列表内存上限，超出部分排序写入临时文件 (0 表示不限制)
     const char *log_file;
     FILE *log_fp;
 
@@ -110,6 +150,10 @@ typedef struct {
     int compare_mode;
     int diff_mode;
     int direct_compare_mode;
+    int convert_mode;              // 清单格式转换 (--convert)
+    int lookup_mode;               // 按路径查询清单条目 (--lookup)
+    int merge_mode;                // 合并分片清单或验证报告 (--merge)
+    int worker_mode;               // 为协调器哈希文件 (--worker)
 
     // 参数
     const char *source_dirs[MAX_SOURCE_DIRS];
@@ -120,6 +164,10 @@ typedef struct {
     int manifest_count;
     const char *source_dir1;
     const char *source_dir2;
+    char *const *lookup_paths;     // --lookup 查询的路径
+    int lookup_count;
+    char *const *merge_inputs;     // --merge 的输入 (分片清单或报告)
+    int merge_count;
 
     // 进度条管理
     ProgressBar progress_bars[MAX_PROGRESS_BARS];
@@ -135,6 +183,11 @@ typedef struct {
     volatile size_t extra_files;
     volatile size_t error_files;
     volatile size_t bytes_processed;
+    volatile size_t scanned_files;    // 遍历已发现的文件数 (遍历结束前持续增长)
+    volatile size_t scanned_bytes;    // 遍历已发现的文件总大小
+    volatile size_t hashed_files;     // 已完成哈希 (含缓存命中与失败) 的文件数
+    volatile size_t hashed_bytes;     // 已完成哈希 (含缓存命中) 的文件总大小
+    volatile int scan_complete;       // 遍历已结束，总量已确定
     struct timeval start_time;
     struct timeval end_time;
     pthread_mutex_t lock;
@@ -146,6 +199,7 @@ extern volatile sig_atomic_t g_interrupted;
 
 void init_config();
 int parse_args(int argc, char **argv);
+int parse_size(const char *str, size_t *out);
 int validate_args(int argc, char **argv);
 void cleanup_config();
 int is_tui_option(const char *arg);  // 新增
@@ -1,28 +1,98 @@
 #ifndef DATA_STRUCTS_H
 #define DATA_STRUCTS_H
 
-#include <openssl/sha.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <pthread.h>
+#include "digest.h"
 
-#define SHA256_DIGEST_LENGTH 32
-
-// 文件信息结构
+// 文件信息结构 (遍历与清单读写使用的完整视图)
 typedef struct {
     char *path;
-    char hash[SHA256_DIGEST_LENGTH * 2 + 1];
+    Digest digest;                 // 二进制摘要
     size_t size;
     time_t mtime;
 } FileInfo;
 
-// 文件列表结构
+#define FILE_LIST_CHUNK 4096               // 每个分段的条目数
+#define FILE_LIST_ARENA_BLOCK (1024 * 1024)  // 路径存储块大小
+
+// 路径存储块：路径依次追加，整块释放
+typedef struct PathArenaBlock {
+    struct PathArenaBlock *next;
+    size_t used;
+    char data[];
+} PathArenaBlock;
+
+// 列表内部的紧凑条目：完整路径 = 目录路径 + '/' + 文件名 (根目录下只有文件名)
 typedef struct {
-    FileInfo *files;
-    size_t count;
-    size_t capacity;
+    const char *name;              // 文件名 (存储块中，其后依次为摘要字节与可选的树哈希块大小)
+    uint64_t size;
+    int64_t mtime;
+    uint32_t dir;                  // 所在目录编号
+    uint16_t name_len;
+    uint8_t digest_len;
+    uint8_t tree;                  // 1 表示摘要之后存有树哈希块大小
+} FileEntry;
+
+// 驻留的目录路径：同一目录下的所有条目共享一份
+typedef struct {
+    const char *path;              // 相对目录路径，不含结尾 '/'，根目录为空串
+    uint32_t len;
+    uint32_t hash;
+    uint32_t rank;                 // 按 路径 + '/' 排序后的名次 (排序前计算)
+} FileListDir;
+
+// 排序键：所在目录的名次与条目下标，不同目录的条目多数只凭名次即可定序
+typedef struct {
+    uint32_t rank;
+    uint32_t index;
+} FileListSortKey;
+
+// 文件列表结构：条目按固定大小分段分配，扩容只增长分段指针表，已有条目地址不变；
+// 设置内存上限后，超出部分排序写入临时文件 (有序段)，读取时多路归并
+typedef struct {
+    FileEntry **chunks;            // 分段指针表
+    size_t chunk_count;
+    size_t chunk_capacity;
+    size_t count;                  // 内存中的条目数
+    PathArenaBlock *arena;         // 文件名与摘要的存储块 (链表头)
+    FileListDir *dirs;             // 目录编号 → 目录路径
+    uint32_t dir_count;
+    uint32_t dir_capacity;
+    uint32_t *dir_slots;           // 目录路径散列表 (开放寻址，存编号 + 1)
+    size_t dir_slot_count;
+    uint32_t last_dir;             // 上一次插入的目录，连续插入同一目录时跳过查找
+    uint32_t *rank_last;           // 名次 → 子孙目录中的最大名次 (子孙目录的名次连续)
+    PathArenaBlock *dir_arena;     // 目录路径的存储块，落盘时保留
+    size_t dir_memory;             // 目录表的估算占用
+    size_t memory_used;            // 内存中条目的估算占用 (含目录表)
+    size_t memory_limit;           // 0 表示不限制
+    FILE **runs;                   // 已落盘的有序段
+    size_t run_count;
+    size_t spilled;                // 已落盘的条目数
+    uint32_t *path_slots;          // 路径索引 (开放寻址，存条目下标 + 1)，按需建立，添加条目后失效
+    size_t path_slot_count;
     pthread_mutex_t lock;
 } FileList;
 
+// 有序遍历器：内存中的条目排序后与所有有序段按路径多路归并
+typedef struct {
+    const FileList *list;
+    FileListSortKey *sorted;       // 内存条目的有序排序键
+    size_t sorted_count;
+    size_t sorted_pos;
+    size_t source_count;           // 0 号为内存条目，其余为有序段
+    FileInfo *heads;               // 各来源的当前条目
+    char *head_paths;              // 各来源当前条目的路径缓冲 (每个来源 MAX_PATH)
+    size_t *heap;                  // 按当前条目排序的来源下标 (小顶堆)
+    size_t heap_size;
+    FILE **runs;
+    FileInfo current;
+    char *current_path;            // 返回条目的路径 (来源的缓冲会被下一条覆盖)
+} FileListIter;
+
 // 文件状态
 typedef enum {
     FILE_STATUS_MISSING = -2,
@@ -43,8 +113,18 @@ typedef enum {
 
 FileList* create_file_list();
 void free_file_list(FileList *list);
-int add_file_to_list(FileList *list, const char *path, const char *hash, size_t size, time_t mtime);
-FileInfo* create_file_info(const char *path, const char *hash, size_t size, time_t mtime);
+int add_file_to_list(FileList *list, const char *path, const Digest *digest, size_t size, time_t mtime);
+int add_file_to_list_n(FileList *list, const char *path, size_t len, const Digest *digest, size_t size,
+                       time_t mtime);
+void file_list_set_memory_limit(FileList *list, size_t limit);
+size_t file_list_total(const FileList *list);
+const char* file_list_path(const FileList *list, size_t index, char *buf, size_t size);
+int file_list_build_index(FileList *list);
+int file_list_find(const FileList *list, const char *path, size_t *index);
+int file_list_iter_begin(FileList *list, FileListIter *it);
+const FileInfo* file_list_iter_next(FileListIter *it);
+void file_list_iter_end(FileListIter *it);
+FileInfo* create_file_info(const char *path, const Digest *digest, size_t size, time_t mtime);
 void free_file_info(FileInfo *info);
 
 // 添加排序函数声明
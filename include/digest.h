@@ -0,0 +1,58 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stddef.h>
+#include <string.h>
+
+#define MAX_DIGEST_LENGTH 32  // 所有引擎中最长的摘要 (SHA-256/BLAKE3)
+#define HASH_STR_MAX 192       // 清单中哈希字段的最大长度 (含算法标签，如 tree-sha256:<块大小>:<hex>)
+#define TREE_HASH_PREFIX "tree-"  // 树哈希标签: tree-<算法>:<块大小>:<hex>
+
+// 摘要算法
+typedef enum {
+    DIGEST_ALGO_SHA256 = 0,        // OpenSSL EVP，默认
+    DIGEST_ALGO_BLAKE3,            // libblake3 (SIMD)，编译时可选
+    DIGEST_ALGO_XXH3_128,          // libxxhash XXH3-128，非密码学，编译时可选
+    DIGEST_ALGO_COUNT
+} DigestAlgo;
+
+// 摘要引擎描述
+typedef struct {
+    DigestAlgo algo;
+    const char *name;              // 清单头与 --algo 使用的名称
+    size_t digest_len;             // 摘要字节数
+    int available;                 // 当前构建是否支持
+} DigestEngine;
+
+typedef struct DigestCtx DigestCtx;
+
+// 二进制摘要：内存中只保存原始字节，十六进制仅在清单读写时转换
+typedef struct {
+    size_t tree_block_size;                 // 树哈希块大小，0 表示整文件摘要
+    unsigned char len;                      // 摘要字节数，0 表示无摘要
+    unsigned char bytes[MAX_DIGEST_LENGTH]; // 未用部分填零，比较时按定宽进行
+} Digest;
+
+// 定宽比较，避免逐字符 strcmp
+static inline int digest_equal(const Digest *a, const Digest *b) {
+    return a->len == b->len && a->tree_block_size == b->tree_block_size &&
+           memcmp(a->bytes, b->bytes, MAX_DIGEST_LENGTH) == 0;
+}
+
+const DigestEngine* digest_engine_get(DigestAlgo algo);
+const DigestEngine* digest_engine_by_name(const char *name);
+void digest_list_engines(char *buf, size_t size);
+
+DigestCtx* digest_ctx_new(DigestAlgo algo);
+int digest_init(DigestCtx *ctx);
+int digest_update(DigestCtx *ctx, const void *data, size_t len);
+int digest_final(DigestCtx *ctx, unsigned char *out);
+void digest_ctx_free(DigestCtx *ctx);
+
+void digest_to_hex(const unsigned char *digest, size_t len, char *hex);
+int digest_from_hex(const char *hex, size_t len, unsigned char *out);
+void digest_set(Digest *digest, const unsigned char *bytes, size_t len, size_t tree_block_size);
+int digest_format(const Digest *digest, DigestAlgo algo, char *out, size_t size);
+int digest_parse(const char *str, size_t len, DigestAlgo algo, Digest *digest);
+
+#endif // DIGEST_H
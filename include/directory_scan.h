@@ -3,6 +3,13 @@
 
 #include "data_structs.h"
 
-int scan_directory(const char *dir_path, FileList *list);
+#define SMALL_FILE_MAX (16 * 1024)  // 不超过此大小的文件走批量哈希 (仅 sha256)
+#define SMALL_FILE_BATCH 64         // 每个批量任务的文件数
+#define SCAN_DIRENT_BUFFER (64 * 1024)  // 每次 getdents64 读取的缓冲区
+#define SCAN_FD_BUDGET 256          // 队列中最多持有的目录描述符数
+
+int scan_directory(const char *dir_path, FileList *list, int source);
+int scan_directory_metadata(const char *dir_path, FileList *list);
+int scan_wait(void);
 
 #endif // DIRECTORY_SCAN_H
\ No newline at end of file
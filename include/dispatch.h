@@ -0,0 +1,36 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <sys/types.h>
+#include "config.h"
+#include "digest.h"
+
+#define DISPATCH_PROTOCOL 1                    // 协调器与 worker 的协议版本
+#define DISPATCH_BATCH_FILES 64                // 每批最多文件数
+#define DISPATCH_BATCH_BYTES (64LL * 1024 * 1024)  // 每批累计大小上限 (大文件单独成批)
+#define DISPATCH_LEASE_DEFAULT 60              // 默认租约秒数
+#define DISPATCH_MAX_WORKERS 256               // 同时连接的 worker 上限
+#define DISPATCH_CONNECT_RETRY 30              // worker 等待协调器启动的秒数
+#define DISPATCH_LINE_MAX (MAX_PATH + HASH_STR_MAX + 64)
+
+// 分布式生成：协调器 (-g --coordinator <地址>) 负责遍历与写清单，待哈希的文件进入队列，
+// worker 进程 (--worker <地址>) 主动拉取一批文件，哈希后逐个把结果流式送回；
+// 地址为 unix:<路径> (或以 / 开头的路径) 或 <主机>:<端口>，worker 须以相同路径挂载源目录
+//
+// 协议为文本行：
+//   worker -> 协调器: HELLO mirrorguard-worker <版本> <名称> | GET | PING | OK <编号> <摘要> | FAIL <编号>
+//   协调器 -> worker: CONFIG <算法> <租约秒数> | BATCH <n> 及 n 行 <编号> <路径> | DONE
+// worker 在上一批尚未哈希完时即可再次 GET，新批次并入其持有的文件；
+// worker 每隔租约的三分之一发送一次 PING；连接断开或租约到期时其持有的文件重新排队
+
+// 哈希结果回调 (digest 为 NULL 表示失败或中断)，在协调器线程中调用
+typedef void (*DispatchDone)(void *arg, const Digest *digest);
+
+int dispatch_start(const char *addr);
+int dispatch_active(void);
+int dispatch_submit(const char *path, off_t size, DispatchDone done, void *arg);
+int dispatch_wait(void);
+
+int dispatch_worker_run(const char *addr);
+
+#endif // DISPATCH_H
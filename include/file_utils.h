@@ -1,11 +1,24 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
-#include <openssl/evp.h>
 #include <sys/stat.h>
 #include "data_structs.h"
+#include "digest.h"
 
-int compute_sha256(const char *file_path, char *hash_str);
-FileStatus verify_file(const char *mirror_dir, const char *rel_path, const char *expected_hash);
+#define DIRECT_IO_ALIGN 4096                      // O_DIRECT 缓冲区对齐
+#define DIRECT_IO_BUFFER_SIZE (1024 * 1024)       // O_DIRECT 每次读取大小
+#define DONTNEED_WINDOW ((off_t)8 * 1024 * 1024)  // fadvise 模式下丢弃页缓存的步长
+
+void drop_file_cache(int fd, off_t offset, off_t len);
+int compute_file_hash(const char *file_path, DigestAlgo algo, Digest *digest);
+int compute_tree_hash(const char *file_path, DigestAlgo algo, size_t block_size, Digest *digest,
+                      unsigned char **block_digests, size_t *block_count);
+int block_log_open(const char *path);
+void block_log_append(const char *rel_path, const unsigned char *digests, size_t count,
+                      size_t digest_len);
+int block_log_close(void);
+void block_list_free(void);
+FileStatus verify_file(const char *mirror_dir, const char *rel_path, const Digest *expected,
+                       long long expected_size);
 
 #endif // FILE_UTILS_H
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef GZBLOCK_H
+#define GZBLOCK_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GZBLOCK_SIZE (1024 * 1024)         // 每块解压后的大小上限 (只在行边界处切块)
+#define GZBLOCK_INDEX_CHUNK 65000          // 每个索引成员携带的索引字节数上限 (gzip 附加字段最长 65535)
+#define GZBLOCK_FOOTER_DATA 40             // 尾部成员的附加字段长度
+#define GZBLOCK_FOOTER_SIZE (10 + 2 + 4 + GZBLOCK_FOOTER_DATA + 2 + 8)
+#define GZBLOCK_FLAG_SORTED 0x01           // 条目按路径排序，可按首路径定位块
+
+// 分块压缩清单：每块是一个独立的 gzip 成员，只含完整的行，整个文件仍可直接 zcat；
+// 块索引与尾部放在文件末尾不产生输出的空 gzip 成员的附加字段 (子字段 'M''I' / 'M''F') 中：
+//   块索引项: offset u64 | 压缩长度 u32 | 解压长度 u32 | 首路径长度 u16 | 首路径 (小端)
+//   尾部:     索引偏移 u64 | 块数 u64 | 条目数 u64 | 标志 u64 | 解压总长 u64
+
+// 索引中的一块
+typedef struct {
+    uint64_t offset;
+    uint32_t csize;
+    uint32_t usize;
+    const char *first_path;        // 块中首个条目的路径 (指向映射，不以 '\0' 结尾)
+    uint16_t first_path_len;
+} GzBlock;
+
+// 已映射的分块压缩清单 (映射由调用方持有)
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    GzBlock *blocks;
+    size_t block_count;
+    uint64_t entry_count;
+    int sorted;
+    size_t max_usize;              // 最大块的解压长度，读取缓冲区按此分配
+} GzBlockIndex;
+
+typedef struct GzBlockWriter GzBlockWriter;
+
+int gzblock_available(void);
+int gzblock_detect(const void *data, size_t size);
+int gzblock_open(GzBlockIndex *index, const void *data, size_t size);
+int gzblock_inflate(const GzBlockIndex *index, size_t block, char *out);
+size_t gzblock_find(const GzBlockIndex *index, const char *path, size_t len);
+void gzblock_close(GzBlockIndex *index);
+
+GzBlockWriter* gzblock_writer_open(FILE *fp);
+int gzblock_writer_add(GzBlockWriter *writer, const char *line, size_t len, const char *path, size_t path_len);
+int gzblock_writer_close(GzBlockWriter *writer);
+
+#endif // GZBLOCK_H
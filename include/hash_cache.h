@@ -0,0 +1,39 @@
+#ifndef HASH_CACHE_H
+#define HASH_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include "digest.h"
+
+#define HASH_CACHE_MAGIC "MGHCACHE"
+#define HASH_CACHE_VERSION 1
+#define DEFAULT_CACHE_MAX_AGE (30L * 24 * 3600)  // 未再出现的条目保留 30 天
+
+// 缓存文件头，其后为按 (dev, ino) 排序的定长记录，可直接 mmap 二分查找
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+} HashCacheHeader;
+
+// 缓存记录：元数据任一项变化即视为失效
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+    int64_t last_seen;             // 最近一次命中或写入的时间 (秒)
+    uint8_t algo;
+    uint8_t len;
+    uint8_t reserved[6];
+    unsigned char digest[MAX_DIGEST_LENGTH];
+} HashCacheRecord;
+
+int hash_cache_open(const char *path);
+int hash_cache_lookup(const struct stat *sb, DigestAlgo algo, Digest *digest);
+void hash_cache_store(const struct stat *sb, DigestAlgo algo, const Digest *digest);
+int hash_cache_close(int save);
+
+#endif // HASH_CACHE_H
@@ -0,0 +1,15 @@
+#ifndef IGNORE_H
+#define IGNORE_H
+
+#define IGNORE_FILE_NAME ".mirrorguardignore"
+
+// 一个目录的忽略规则 (gitignore 语义)，通过 parent 继承上级目录的规则；
+// 每个目录的忽略文件只在遍历到该目录时解析一次，所有子目录共享引用
+typedef struct IgnoreRules IgnoreRules;
+
+IgnoreRules* ignore_rules_load(IgnoreRules *parent, int dir_fd, const char *rel_dir);
+IgnoreRules* ignore_rules_ref(IgnoreRules *rules);
+void ignore_rules_release(IgnoreRules *rules);
+int ignore_rules_match(const IgnoreRules *rules, const char *rel_path, int is_dir);
+
+#endif // IGNORE_H
@@ -0,0 +1,57 @@
+#ifndef INODE_SET_H
+#define INODE_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "digest.h"
+#include "data_structs.h"
+
+#define INODE_SET_SHARDS 64        // 分段锁数量，遍历线程与哈希线程按 inode 分散到各段
+
+// 同一 inode 的其他路径：首个路径哈希完成前到达的在此排队，完成后一并加入列表
+typedef struct InodeWaiter {
+    struct InodeWaiter *next;
+    FileList *list;
+    int source;                    // 所属源目录的序号
+    char rel_path[];
+} InodeWaiter;
+
+typedef enum {
+    INODE_PENDING = 0,             // 首个路径正在哈希
+    INODE_READY,                   // 摘要已得出
+    INODE_FAILED,                  // 读取失败或已中断
+    INODE_DIRECTORY                // 已遍历的目录 (符号链接防环)
+} InodeState;
+
+// 一个已见过的 (st_dev, st_ino)；发布后只读，生命周期到 inode_set_free 为止
+typedef struct InodeEntry {
+    struct InodeEntry *next;
+    uint64_t dev;
+    uint64_t ino;
+    InodeState state;
+    Digest digest;
+    unsigned char *blocks;         // 树哈希的块摘要，供其他路径写入块摘要文件
+    size_t block_count;
+    InodeWaiter *waiters;
+} InodeEntry;
+
+typedef enum {
+    INODE_CLAIM_ABSENT = 0,        // 未记录 (insert 为 0 或内存不足)：调用方自行哈希
+    INODE_CLAIM_NEW,               // 已登记，调用方负责哈希并发布
+    INODE_CLAIM_PENDING,           // 已排队，由首个路径完成后加入列表
+    INODE_CLAIM_DONE               // 已有结果，按 entry->state 使用
+} InodeClaim;
+
+// 并发 inode 表：硬链接与符号链接指向的同一文件只读取一次，摘要复用到所有路径
+typedef struct InodeSet InodeSet;
+
+InodeSet* inode_set_create(void);
+void inode_set_free(InodeSet *set);
+InodeClaim inode_set_claim(InodeSet *set, const struct stat *sb, FileList *list, int source,
+                           const char *rel_path, int insert, InodeEntry **entry);
+InodeWaiter* inode_set_publish(InodeSet *set, InodeEntry *entry, const Digest *digest,
+                               unsigned char *blocks, size_t block_count);
+int inode_set_add_dir(InodeSet *set, uint64_t dev, uint64_t ino);
+
+#endif // INODE_SET_H
@@ -0,0 +1,47 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include "digest.h"
+#include "data_structs.h"
+
+#define JOURNAL_SYNC_INTERVAL 5                        // 续传日志刷盘 (fsync) 的间隔秒数
+#define JOURNAL_GENERATE_TAG "# mirrorguard-journal generate"
+#define JOURNAL_VERIFY_TAG "# mirrorguard-journal verify"
+
+// 续传日志 (文本，只追加)：长时间运行被中断后 --resume 从中恢复进度，正常完成后删除
+//   生成: 头行 | <摘要> <大小> <mtime 纳秒> <块数> <源目录序号> *<路径>，其后为该文件的块摘要 (每行一个)
+//   验证: 头行 | <M|C|E> <序号> *<路径> (只记录失败条目) | @ <游标> <已处理数> (检查点)
+// 恢复时截掉末尾写了一半的记录；验证日志截到最后一个检查点
+
+// 验证日志中恢复的一条失败结果
+typedef struct {
+    FileStatus status;
+    char *path;
+} JournalResult;
+
+// 验证日志的恢复结果：序号小于 cursor 的清单条目均已验证
+typedef struct {
+    size_t cursor;
+    size_t processed;
+    JournalResult *results;
+    size_t result_count;
+} JournalResume;
+
+int journal_open_generate(const char *path, int resume);
+int journal_lookup(int source, const char *rel_path, const struct stat *sb, Digest *digest,
+                   unsigned char **blocks, size_t *block_count);
+void journal_record_file(int source, const char *rel_path, const Digest *digest, const unsigned char *blocks,
+                         size_t block_count, const struct stat *sb);
+
+int journal_open_verify(const char *path, const char *manifest_path, const char *mirror_dir, int resume,
+                        JournalResume *state);
+void journal_record_result(FileStatus status, size_t ordinal, const char *rel_path);
+void journal_checkpoint(size_t cursor, size_t processed, int force);
+void journal_free_resume(JournalResume *state);
+
+const char* journal_path(void);
+int journal_close(int keep);
+
+#endif // JOURNAL_H
@@ -0,0 +1,87 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stdio.h>
+#include "config.h"
+#include "data_structs.h"
+#include "digest.h"
+#include "mgidx.h"
+#include "gzblock.h"
+#include "shard.h"
+
+// 清单头: 文件首行 "# mirrorguard algo=<算法> [fields=size,mtime] [count=<条目数>] [shard=i/N [shard-by=dir]]"，
+// 缺省时按 sha256 处理
+#define MANIFEST_HEADER_PREFIX "# mirrorguard"
+
+// 条目附加字段，写在哈希与 *路径 之间: <hash> [size] [mtime] *<path>
+#define MANIFEST_FIELD_SIZE  0x01
+#define MANIFEST_FIELD_MTIME 0x02
+
+#define MANIFEST_PARALLEL_MIN (16 * 1024 * 1024)  // 超过此大小的清单分块并行解析
+#define MANIFEST_CHUNK_SIZE (4 * 1024 * 1024)     // 并行解析的块大小 (按行边界对齐)
+#define MANIFEST_LINE_MAX (HASH_STR_MAX + 48 + MAX_PATH)  // 一行条目的最大长度
+#define MANIFEST_WRITE_BUFFER (1024 * 1024)       // 文本清单的写缓冲区
+
+// 清单读取器：整个文件只读映射，按行切分，条目路径直接指向映射，不复制；
+// 二进制清单 (.mgidx) 按魔数识别，条目按路径顺序直接取自映射中的记录；
+// 分块压缩清单按 gzip 魔数识别，data 指向当前解压的块，逐块推进
+typedef struct {
+    const char *data;              // 映射的清单内容 (空文件为 NULL)
+    size_t size;
+    size_t start;                  // 首个条目行的偏移 (清单头之后)
+    size_t pos;                    // 下一行的偏移
+    DigestAlgo algo;               // 清单头声明的摘要算法
+    int fields;                    // 清单头声明的附加字段
+    size_t count;                  // 清单头声明的条目数，0 表示未声明
+    int shard_index;               // 清单头声明的分片 (shard_count 为 0 表示完整清单)
+    int shard_count;
+    int shard_by_dir;
+    MgIndex index;                 // 二进制清单
+    MgIndexCursor *cursor;         // 非 NULL 表示二进制清单
+    GzBlockIndex *blocks;          // 非 NULL 表示分块压缩清单 (映射由其持有)
+    size_t block;                  // 当前解压的块
+    char *block_buf;
+    int failed;                    // 读取中途出错 (压缩块损坏)，已读到的条目不完整
+} ManifestReader;
+
+// 清单条目：path 指向映射中的路径，不以 '\0' 结尾，读取器关闭前有效
+// (二进制清单的路径由游标还原，以 '\0' 结尾；压缩清单的路径指向当前块；二者均在下一次读取前有效)
+typedef struct {
+    Digest digest;
+    long long size;                // 未记录时为 -1
+    long long mtime;               // 未记录时为 -1
+    const char *path;
+    size_t path_len;
+} ManifestEntry;
+
+// 并行解析时对每个条目的回调，可能在多个线程中同时调用
+typedef void (*ManifestEntryFn)(void *arg, const ManifestEntry *entry);
+
+// 文本清单写出器：条目格式化到缓冲区后整块写出；压缩时交给后台线程分块压缩
+typedef struct {
+    FILE *fp;
+    GzBlockWriter *gz;
+    char *buffer;                  // 文件流的写缓冲区
+    DigestAlgo algo;
+    int fields;
+    char shard[SHARD_HEADER_MAX];  // 写入清单头的分片字段，默认取自 --shard
+    int failed;
+} ManifestWriter;
+
+int manifest_open(ManifestReader *reader, const char *path);
+int manifest_next(ManifestReader *reader, ManifestEntry *entry);
+void manifest_for_each(ManifestReader *reader, ManifestEntryFn fn, void *arg);
+void manifest_close(ManifestReader *reader);
+size_t manifest_estimate_total(ManifestReader *reader, size_t entries_read);
+int manifest_lookup(ManifestReader *reader, const char *path, ManifestEntry *entry);
+
+int manifest_output_fields(void);
+int manifest_output_binary(void);
+int manifest_write_header(FILE *fp, DigestAlgo algo, int fields, size_t count);
+int manifest_write_entry(FILE *fp, const FileInfo *info, DigestAlgo algo, int fields);
+int manifest_writer_open(ManifestWriter *writer, const char *path, DigestAlgo algo, int fields, int compress);
+int manifest_writer_header(ManifestWriter *writer, size_t count);
+int manifest_writer_entry(ManifestWriter *writer, const FileInfo *info);
+int manifest_writer_close(ManifestWriter *writer);
+
+#endif // MANIFEST_H
@@ -0,0 +1,79 @@
+#ifndef MGIDX_H
+#define MGIDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "data_structs.h"
+#include "digest.h"
+
+#define MGIDX_MAGIC "MGMINDEX"
+#define MGIDX_VERSION 1
+#define MGIDX_RESTART_INTERVAL 16  // 每 16 条路径存一条完整路径 (重启点)，稀疏索引只记录重启点
+
+// 记录长度：定长字段 + 摘要字节，按 8 字节对齐
+#define MGIDX_RECORD_SIZE(digest_len) (sizeof(MgIndexRecord) + (((size_t)(digest_len) + 7) & ~(size_t)7))
+
+// 二进制清单 (.mgidx)，本机字节序，只读映射后直接使用，不做任何解析：
+//   文件头 | 源目录 ('\0' 结尾，补齐到 8 字节) | 稀疏索引 | 定长记录 | 路径表
+// 条目按路径字节序排序，第 i 条记录对应路径表中的第 i 条路径
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint8_t algo;
+    uint8_t digest_len;
+    uint8_t fields;                // MANIFEST_FIELD_*：记录中的大小/mtime 是否有效
+    uint8_t reserved;
+    uint32_t root_count;
+    uint64_t count;
+    uint64_t roots_offset;
+    uint64_t index_offset;         // 每个重启点一个 uint64_t：该路径在路径表中的偏移
+    uint64_t records_offset;
+    uint64_t paths_offset;
+    uint64_t paths_size;
+} MgIndexHeader;
+
+// 定长记录，其后紧跟 digest_len 字节的摘要
+typedef struct {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t tree_block_size;      // 树哈希块大小，0 表示整文件摘要
+} MgIndexRecord;
+
+// 路径表中的一条路径：与上一条共享的前缀长度、其余部分的长度与字节；重启点的共享长度为 0
+typedef struct {
+    uint16_t shared;
+    uint16_t suffix_len;
+} MgIndexPathHeader;
+
+// 已映射的二进制清单 (映射由调用方持有)
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    const MgIndexHeader *header;
+    const unsigned char *records;
+    const unsigned char *paths;
+    size_t restart_count;
+} MgIndex;
+
+// 顺序读取游标：前缀压缩的路径逐条还原到 path (以 '\0' 结尾，下一次读取前有效)
+typedef struct {
+    const MgIndex *index;
+    size_t pos;                    // 下一条目的序号
+    size_t offset;                 // 下一条路径在路径表中的偏移
+    size_t path_len;
+    char path[MAX_PATH];
+} MgIndexCursor;
+
+int mgidx_detect(const void *data, size_t size);
+int mgidx_attach(MgIndex *index, const void *data, size_t size);
+const char* mgidx_root(const MgIndex *index, uint32_t n);
+void mgidx_record(const MgIndex *index, size_t i, Digest *digest, long long *size, long long *mtime);
+void mgidx_cursor_init(MgIndexCursor *cursor, const MgIndex *index);
+int mgidx_cursor_next(MgIndexCursor *cursor, size_t *i);
+int mgidx_find(const MgIndex *index, const char *path, size_t len, size_t *i);
+int mgidx_write(const char *path, FileList *list, DigestAlgo algo, int fields, const char *const *roots,
+                int root_count);
+
+#endif // MGIDX_H
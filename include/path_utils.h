@@ -6,5 +6,6 @@
 char* normalize_path(const char *path);
 int is_safe_path(const char *path);
 int should_exclude(const char *path);
+int should_exclude_dir(const char *path);
 
 #endif // PATH_UTILS_H
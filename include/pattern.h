@@ -0,0 +1,22 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stddef.h>
+
+// 包含/排除模式集合：启动时编译为一个多模式自动机，每条路径只扫描一遍
+//   普通字符串  子串匹配 (Aho-Corasick)
+//   通配模式    含 * ? [...] 时按路径分量匹配：* 不跨越 '/'，** 可跨越；
+//               无 '/' 的模式可匹配任一分量，匹配目录即匹配其下所有条目
+//   /前缀       以 '/' 开头时锚定到相对路径起始处
+typedef struct PatternSet PatternSet;
+
+PatternSet* pattern_set_create(void);
+int pattern_set_add(PatternSet *set, const char *pattern);
+int pattern_set_compile(PatternSet *set, int case_insensitive);
+int pattern_set_match(const PatternSet *set, const char *path);
+size_t pattern_set_count(const PatternSet *set);
+void pattern_set_free(PatternSet *set);
+int pattern_glob_match(const char *pattern, size_t pattern_len, const char *path, size_t path_len,
+                       int case_insensitive);
+
+#endif // PATTERN_H
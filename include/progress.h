@@ -6,6 +6,8 @@
 void init_progress_bars();
 void create_progress_bar(const char *name, size_t total, int index);
 void update_progress_bar(int index, size_t current);
+void set_progress_total(int index, size_t total);
+void update_scan_progress(int index);
 void finish_progress_bar(int index);
 void display_progress_bars();
 void cleanup_progress_bars();
@@ -0,0 +1,20 @@
+#ifndef SHA256_MB_H
+#define SHA256_MB_H
+
+#include <stddef.h>
+
+#define SHA256_MB_DIGEST_LENGTH 32
+
+// 单个待哈希消息
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    unsigned char *out;            // SHA256_MB_DIGEST_LENGTH 字节
+} Sha256MbJob;
+
+// 批量计算 SHA-256：多个消息按 SIMD 通道并行处理 (AVX-512 16 路 / AVX2 8 路)，
+// CPU 不支持时逐个使用 OpenSSL。jobs 的顺序会被调整。
+void sha256_mb_hash(Sha256MbJob *jobs, size_t count);
+const char* sha256_mb_kernel_name(void);
+
+#endif // SHA256_MB_H
@@ -0,0 +1,26 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+#include "data_structs.h"
+
+#define SHARD_MAX 65536                           // --shard=i/N 中 N 的上限
+#define SHARD_HEADER_MAX 48                       // 清单/报告头中分片字段的最大长度
+#define REPORT_HEADER_PREFIX "# mirrorguard-report"
+
+// 分片：--shard=i/N (1 <= i <= N) 按相对路径的 FNV-1a 哈希对 N 取余选取文件，
+// --shard-by=dir 时只哈希首级目录 (未选中的首级目录整棵子树不遍历)；
+// 结果只取决于路径，与主机和遍历顺序无关，N 个分片互不重叠且覆盖全部文件
+int shard_parse(const char *spec, int *index, int *count);
+int shard_selected(const char *path);
+void shard_format(char *buf, size_t size, int index, int count, int by_dir);
+void shard_parse_header(const char *line, int *index, int *count, int *by_dir);
+
+// 验证结果报告 (--report)：头行为总数与各类计数，其后每行一个失败条目 <M|C|E|X> *<路径>，按路径排序
+void report_add(FileStatus status, const char *path);
+int report_write(const char *path, size_t total);
+
+// 合并分片清单 (按路径多路归并为一份有序清单) 或分片验证报告 (合并为一份报告与汇总)
+int merge_shards(const char *output_path, char *const *inputs, int input_count);
+
+#endif // SHARD_H
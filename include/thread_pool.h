@@ -0,0 +1,54 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// 工作线程执行的任务
+typedef void (*ThreadPoolTask)(void *arg);
+
+// 并行循环的单次迭代
+typedef void (*ThreadPoolRangeTask)(void *arg, size_t index);
+
+typedef struct {
+    ThreadPoolTask fn;
+    void *arg;
+} ThreadPoolJob;
+
+// 无锁队列槽位：sequence 表示该槽位当前可写入还是可读取 (有界 MPMC 环形队列)
+typedef struct {
+    size_t sequence;
+    ThreadPoolTask fn;
+    void *arg;
+} ThreadPoolSlot;
+
+// 固定线程数的工作池，任务队列有界（满时提交方阻塞，形成背压）
+// 入队/出队通过 CAS 完成，互斥锁只在队列空 (工作线程休眠) 或满 (提交方休眠) 时使用
+typedef struct {
+    pthread_t *threads;
+    int thread_count;
+    ThreadPoolSlot *slots;         // 环形任务队列，容量为 2 的幂
+    size_t mask;
+    size_t enqueue_pos __attribute__((aligned(64)));
+    size_t dequeue_pos __attribute__((aligned(64)));
+    size_t outstanding __attribute__((aligned(64)));  // 已提交但尚未执行完的任务数
+    int idle_workers;              // 因队列为空而休眠的工作线程数
+    int blocked_submitters;        // 因队列已满而休眠的提交方数
+    int shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t idle;
+} ThreadPool;
+
+// 全局哈希工作池 (由 main 按 config.threads 创建)
+extern ThreadPool *g_hash_pool;
+
+ThreadPool* thread_pool_create(int threads, size_t queue_capacity);
+int thread_pool_submit(ThreadPool *pool, ThreadPoolTask fn, void *arg);
+int thread_pool_try_submit(ThreadPool *pool, ThreadPoolTask fn, void *arg);
+void thread_pool_parallel_for(ThreadPool *pool, size_t count, ThreadPoolRangeTask fn, void *arg);
+void thread_pool_wait(ThreadPool *pool);
+void thread_pool_destroy(ThreadPool *pool);
+
+#endif // THREAD_POOL_H
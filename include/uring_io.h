@@ -0,0 +1,13 @@
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include "digest.h"
+
+#define URING_QUEUE_DEPTH 16           // 每个文件同时在途的读请求数
+#define URING_BUFFER_SIZE (128 * 1024) // 每个注册缓冲区大小
+#define URING_UNAVAILABLE 1            // io_uring 不可用，调用方应回退到同步读取
+
+int uring_hash_file(const char *file_path, DigestCtx *mdctx);
+int uring_available(void);
+
+#endif // URING_IO_H
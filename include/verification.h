@@ -3,7 +3,11 @@
 
 #include "data_structs.h"
 
+#define VERIFY_WINDOW 4096          // 验证结果重排窗口：在途条目数上限，结果按清单顺序报告
+
 int generate_manifest_multi(const char *manifest_path);
 int verify_mirror(const char *mirror_dir, const char *manifest_path);
+int convert_manifest(const char *input_path, const char *output_path);
+int lookup_manifest(const char *manifest_path, char *const *paths, int path_count);
 
 #endif // VERIFICATION_H
\ No newline at end of file
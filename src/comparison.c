@@ -5,6 +5,7 @@
 #include "directory_scan.h"
 #include "file_utils.h"
 #include "data_structs.h"
+#include "manifest.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,11 +15,49 @@
 extern Config config;
 extern volatile sig_atomic_t g_interrupted;
 
-// 添加辅助函数：按路径排序文件列表
-int compare_file_info_by_path(const void *a, const void *b) {
-    const FileInfo *info_a = (const FileInfo *)a;
-    const FileInfo *info_b = (const FileInfo *)b;
-    return strcmp(info_a->path, info_b->path);
+// 清单条目加入列表 (并行解析时在多个线程中调用，列表自带锁)
+static void add_manifest_entry(void *arg, const ManifestEntry *entry) {
+    add_file_to_list_n((FileList *)arg, entry->path, entry->path_len, &entry->digest,
+                       entry->size < 0 ? 0 : entry->size, entry->mtime < 0 ? 0 : entry->mtime);
+}
+
+// 比较的一侧：文本清单读入列表后按路径有序遍历；二进制清单本身按路径排序，直接顺序读取
+typedef struct {
+    ManifestReader *reader;
+    FileList *list;                // 二进制清单时为 NULL
+    FileListIter it;
+    FileInfo info;
+} CompareSide;
+
+static int side_open(CompareSide *side, ManifestReader *reader, size_t memory_limit) {
+    side->reader = reader;
+    if (reader->cursor) return 0;
+
+    side->list = create_file_list();
+    if (!side->list) return -1;
+    file_list_set_memory_limit(side->list, memory_limit);
+    // 清单顺序无关，大清单分块并行解析
+    manifest_for_each(reader, add_manifest_entry, side->list);
+    return file_list_iter_begin(side->list, &side->it);
+}
+
+static const FileInfo* side_next(CompareSide *side) {
+    if (side->list) return file_list_iter_next(&side->it);
+
+    ManifestEntry entry;
+    if (!manifest_next(side->reader, &entry)) return NULL;
+    side->info.path = (char *)entry.path;  // 游标中以 '\0' 结尾的路径
+    side->info.digest = entry.digest;
+    side->info.size = entry.size < 0 ? 0 : (size_t)entry.size;
+    side->info.mtime = entry.mtime < 0 ? 0 : (time_t)entry.mtime;
+    return &side->info;
+}
+
+static void side_close(CompareSide *side) {
+    if (!side->list) return;
+    file_list_iter_end(&side->it);
+    free_file_list(side->list);
+    side->list = NULL;
 }
 
 // 比较两个清单文件
@@ -28,21 +67,26 @@ int compare_manifests(const char *manifest1, const char *manifest2) {
         return MIRRORGUARD_ERROR_INVALID_ARGS;
     }
 
-    FILE *file1 = fopen(manifest1, "r");
-    FILE *file2 = fopen(manifest2, "r");
-    if (!file1 || !file2) {
-        log_msg(LOG_ERROR, "无法打开清单文件");
-        if (file1) fclose(file1);
-        if (file2) fclose(file2);
-        return MIRRORGUARD_ERROR_FILE_IO;
+    ManifestReader reader1;
+    ManifestReader reader2;
+    int open_result = manifest_open(&reader1, manifest1);
+    if (open_result != MIRRORGUARD_OK) {
+        return open_result;
+    }
+    open_result = manifest_open(&reader2, manifest2);
+    if (open_result != MIRRORGUARD_OK) {
+        manifest_close(&reader1);
+        return open_result;
     }
 
-    char line1[MAX_PATH + SHA256_DIGEST_LENGTH * 2 + 10];
-    char line2[MAX_PATH + SHA256_DIGEST_LENGTH * 2 + 10];
-    char hash1[SHA256_DIGEST_LENGTH * 2 + 1];
-    char path1[MAX_PATH];
-    char hash2[SHA256_DIGEST_LENGTH * 2 + 1];
-    char path2[MAX_PATH];
+    // 不同算法的摘要无法比较
+    if (reader1.algo != reader2.algo) {
+        log_msg(LOG_ERROR, "清单摘要算法不同 (%s vs %s)，无法比较",
+                digest_engine_get(reader1.algo)->name, digest_engine_get(reader2.algo)->name);
+        manifest_close(&reader1);
+        manifest_close(&reader2);
+        return MIRRORGUARD_ERROR_INVALID_FORMAT;
+    }
 
     size_t same_count = 0;
     size_t diff_count = 0;
@@ -51,83 +95,60 @@ int compare_manifests(const char *manifest1, const char *manifest2) {
 
     log_msg(LOG_INFO, "开始比较清单: %s vs %s", manifest1, manifest2);
 
-    // 读取两个清单的所有行到内存中进行比较
-    FileList *list1 = create_file_list();
-    FileList *list2 = create_file_list();
-    if (!list1 || !list2) {
-        if (file1) fclose(file1);
-        if (file2) fclose(file2);
-        if (list1) free_file_list(list1);
-        if (list2) free_file_list(list2);
+    // 两侧按路径有序 (文本清单超出内存上限的部分从临时文件归并)，线性比较
+    CompareSide side1, side2;
+    memset(&side1, 0, sizeof(side1));
+    memset(&side2, 0, sizeof(side2));
+    if (side_open(&side1, &reader1, config.memory_limit / 2) != 0 ||
+        side_open(&side2, &reader2, config.memory_limit / 2) != 0) {
+        side_close(&side1);
+        side_close(&side2);
+        manifest_close(&reader1);
+        manifest_close(&reader2);
         return MIRRORGUARD_ERROR_MEMORY;
     }
 
-    // 读取第一个清单
-    while (fgets(line1, sizeof(line1), file1)) {
-        if (sscanf(line1, "%64s *%[^\n]", hash1, path1) == 2) {
-            add_file_to_list(list1, path1, hash1, 0, 0);
-        }
-    }
-
-    // 读取第二个清单
-    while (fgets(line2, sizeof(line2), file2)) {
-        if (sscanf(line2, "%64s *%[^\n]", hash2, path2) == 2) {
-            add_file_to_list(list2, path2, hash2, 0, 0);
-        }
-    }
-
-    fclose(file1);
-    fclose(file2);
-
-    // 按路径排序，避免重复处理
-    if (list1->count > 0) {
-        qsort(list1->files, list1->count, sizeof(FileInfo), compare_file_info_by_path);
-    }
-    if (list2->count > 0) {
-        qsort(list2->files, list2->count, sizeof(FileInfo), compare_file_info_by_path);
-    }
-
-    // 使用线性比较算法（类似归并排序）
-    size_t i = 0, j = 0;
-    while (i < list1->count && j < list2->count) {
-        int cmp = strcmp(list1->files[i].path, list2->files[j].path);
+    const FileInfo *a = side_next(&side1);
+    const FileInfo *b = side_next(&side2);
+    while (a && b) {
+        int cmp = strcmp(a->path, b->path);
         if (cmp == 0) {
             // 路径相同，比较哈希
-            if (strcmp(list1->files[i].hash, list2->files[j].hash) == 0) {
+            if (digest_equal(&a->digest, &b->digest)) {
                 same_count++;
             } else {
-                log_msg(LOG_WARN, "哈希不同: %s", list1->files[i].path);
+                log_msg(LOG_WARN, "哈希不同: %s", a->path);
                 diff_count++;
             }
-            i++;
-            j++;
+            a = side_next(&side1);
+            b = side_next(&side2);
         } else if (cmp < 0) {
             // 仅在清单1中存在
-            log_msg(LOG_WARN, "仅在清单1中存在: %s", list1->files[i].path);
+            log_msg(LOG_WARN, "仅在清单1中存在: %s", a->path);
             missing_in_2++;
-            i++;
+            a = side_next(&side1);
         } else {
             // 仅在清单2中存在
-            log_msg(LOG_WARN, "仅在清单2中存在: %s", list2->files[j].path);
+            log_msg(LOG_WARN, "仅在清单2中存在: %s", b->path);
             missing_in_1++;
-            j++;
+            b = side_next(&side2);
         }
     }
 
     // 处理剩余的文件
-    while (i < list1->count) {
-        log_msg(LOG_WARN, "仅在清单1中存在: %s", list1->files[i].path);
+    for (; a; a = side_next(&side1)) {
+        log_msg(LOG_WARN, "仅在清单1中存在: %s", a->path);
         missing_in_2++;
-        i++;
     }
-    while (j < list2->count) {
-        log_msg(LOG_WARN, "仅在清单2中存在: %s", list2->files[j].path);
+    for (; b; b = side_next(&side2)) {
+        log_msg(LOG_WARN, "仅在清单2中存在: %s", b->path);
         missing_in_1++;
-        j++;
     }
-
-    free_file_list(list1);
-    free_file_list(list2);
+    side_close(&side1);
+    side_close(&side2);
+    int read_failed = reader1.failed || reader2.failed;
+    manifest_close(&reader1);
+    manifest_close(&reader2);
 
     log_msg(LOG_INFO, "\n清单比较结果:");
     log_msg(LOG_INFO, "  完全相同: %zu", same_count);
@@ -135,6 +156,10 @@ int compare_manifests(const char *manifest1, const char *manifest2) {
     log_msg(LOG_INFO, "  仅在清单1: %zu", missing_in_2);
     log_msg(LOG_INFO, "  仅在清单2: %zu", missing_in_1);
 
+    if (read_failed) {
+        log_msg(LOG_ERROR, "❌ 清单读取不完整，比较结果不可靠");
+        return MIRRORGUARD_ERROR_INVALID_FORMAT;
+    }
     if (diff_count > 0 || missing_in_1 > 0 || missing_in_2 > 0) {
         log_msg(LOG_WARN, "❌ 清单内容不一致!");
         return MIRRORGUARD_ERROR_GENERAL;
@@ -154,18 +179,21 @@ int compare_directories(const char *dir1, const char *dir2) {
     FileList *list1 = create_file_list();
     FileList *list2 = create_file_list();
     if (!list1 || !list2) {
+        free_file_list(list1);
+        free_file_list(list2);
         return MIRRORGUARD_ERROR_MEMORY;
     }
+    file_list_set_memory_limit(list1, config.memory_limit / 2);
+    file_list_set_memory_limit(list2, config.memory_limit / 2);
 
+    // 两个目录的哈希在工作池中并行进行，遍历结束后统一等待
     log_msg(LOG_INFO, "开始扫描目录1: %s", dir1);
-    if (scan_directory(dir1, list1) != 0) {
-        free_file_list(list1);
-        free_file_list(list2);
-        return MIRRORGUARD_ERROR_FILE_IO;
+    int scan_failed = scan_directory(dir1, list1, 0) != 0;
+    if (!scan_failed) {
+        log_msg(LOG_INFO, "开始扫描目录2: %s", dir2);
+        scan_failed = scan_directory(dir2, list2, 1) != 0;
     }
-
-    log_msg(LOG_INFO, "开始扫描目录2: %s", dir2);
-    if (scan_directory(dir2, list2) != 0) {
+    if (scan_wait() != 0 || scan_failed) {
         free_file_list(list1);
         free_file_list(list2);
         return MIRRORGUARD_ERROR_FILE_IO;
@@ -176,54 +204,54 @@ int compare_directories(const char *dir1, const char *dir2) {
     size_t missing_in_1 = 0;
     size_t missing_in_2 = 0;
 
-    log_msg(LOG_INFO, "开始比较 %zu 个文件 vs %zu 个文件", list1->count, list2->count);
+    log_msg(LOG_INFO, "开始比较 %zu 个文件 vs %zu 个文件", file_list_total(list1), file_list_total(list2));
 
-    // 按路径排序，避免重复处理
-    if (list1->count > 0) {
-        qsort(list1->files, list1->count, sizeof(FileInfo), compare_file_info_by_path);
-    }
-    if (list2->count > 0) {
-        qsort(list2->files, list2->count, sizeof(FileInfo), compare_file_info_by_path);
+    // 按路径有序遍历 (超出内存上限的部分从临时文件归并)，线性比较
+    FileListIter it1, it2;
+    if (file_list_iter_begin(list1, &it1) != 0 || file_list_iter_begin(list2, &it2) != 0) {
+        file_list_iter_end(&it1);
+        free_file_list(list1);
+        free_file_list(list2);
+        return MIRRORGUARD_ERROR_MEMORY;
     }
-
-    // 使用线性比较算法（类似归并排序）
-    size_t i = 0, j = 0;
-    while (i < list1->count && j < list2->count) {
-        int cmp = strcmp(list1->files[i].path, list2->files[j].path);
+    const FileInfo *a = file_list_iter_next(&it1);
+    const FileInfo *b = file_list_iter_next(&it2);
+    while (a && b) {
+        int cmp = strcmp(a->path, b->path);
         if (cmp == 0) {
             // 路径相同，比较哈希
-            if (strcmp(list1->files[i].hash, list2->files[j].hash) == 0) {
+            if (digest_equal(&a->digest, &b->digest)) {
                 same_count++;
             } else {
-                log_msg(LOG_WARN, "文件内容不同: %s", list1->files[i].path);
+                log_msg(LOG_WARN, "文件内容不同: %s", a->path);
                 diff_count++;
             }
-            i++;
-            j++;
+            a = file_list_iter_next(&it1);
+            b = file_list_iter_next(&it2);
         } else if (cmp < 0) {
             // 仅在目录1中存在
-            log_msg(LOG_WARN, "仅在目录1中存在: %s", list1->files[i].path);
+            log_msg(LOG_WARN, "仅在目录1中存在: %s", a->path);
             missing_in_2++;
-            i++;
+            a = file_list_iter_next(&it1);
         } else {
             // 仅在目录2中存在
-            log_msg(LOG_WARN, "仅在目录2中存在: %s", list2->files[j].path);
+            log_msg(LOG_WARN, "仅在目录2中存在: %s", b->path);
             missing_in_1++;
-            j++;
+            b = file_list_iter_next(&it2);
         }
     }
 
     // 处理剩余的文件
-    while (i < list1->count) {
-        log_msg(LOG_WARN, "仅在目录1中存在: %s", list1->files[i].path);
+    for (; a; a = file_list_iter_next(&it1)) {
+        log_msg(LOG_WARN, "仅在目录1中存在: %s", a->path);
         missing_in_2++;
-        i++;
     }
-    while (j < list2->count) {
-        log_msg(LOG_WARN, "仅在目录2中存在: %s", list2->files[j].path);
+    for (; b; b = file_list_iter_next(&it2)) {
+        log_msg(LOG_WARN, "仅在目录2中存在: %s", b->path);
         missing_in_1++;
-        j++;
     }
+    file_list_iter_end(&it1);
+    file_list_iter_end(&it2);
 
     free_file_list(list1);
     free_file_list(list2);
@@ -2,6 +2,11 @@
 #include "logging.h"
 #include "progress.h"
 #include "tui.h"
+#include "thread_pool.h"
+#include "hash_cache.h"
+#include "journal.h"
+#include "shard.h"
+#include "dispatch.h"
 #include <sys/time.h>
 #include <signal.h>
 #include <unistd.h>
@@ -36,6 +41,18 @@ void init_config() {
     config.force_overwrite = 0;
     config.threads = sysconf(_SC_NPROCESSORS_ONLN); // 默认为CPU核心数
     if (config.threads > 32) config.threads = 32; // 限制最大线程数
+    if (config.threads < 1) config.threads = 1;
+    const char *env_threads = getenv("MIRRORGUARD_THREADS");
+    if (env_threads && *env_threads) {
+        int n = atoi(env_threads);
+        if (n >= 1 && n <= MAX_THREADS) {
+            config.threads = n;
+        } else {
+            fprintf(stderr, "警告: 忽略无效的 MIRRORGUARD_THREADS=%s (范围 1-%d)\n", env_threads, MAX_THREADS);
+        }
+    }
+    config.memory_limit = 0;
+    config.scan_threads = 0;  // 默认与哈希线程数相同
     config.recursive = 1;
     config.preserve_timestamps = 0;
     config.case_sensitive = 1;
@@ -43,9 +60,30 @@ void init_config() {
     config.tui_mode = TUI_MODE_NONE;  // 默认无TUI
     config.progress_style = PROGRESS_STYLE_DEFAULT;
     config.progress_color = PROGRESS_COLOR_GREEN;
-    config.exclude_count = 0;
-    config.include_count = 0;
-    config.output_format = "sha256sum";
+    config.digest_algo = DIGEST_ALGO_SHA256;
+    config.tree_hash = 0;
+    config.tree_block_size = DEFAULT_TREE_BLOCK_SIZE;
+    config.block_list_path = NULL;
+    config.io_engine = IO_ENGINE_SYNC;
+    config.cache_mode = CACHE_MODE_NORMAL;
+    config.hash_cache_path = NULL;
+    config.rehash = 0;
+    config.cache_max_age = DEFAULT_CACHE_MAX_AGE;
+    config.exclude_patterns = NULL;
+    config.include_patterns = NULL;
+    config.ignore_files = 1;
+    config.output_format = "mirrorguard";
+    config.record_mtime = 0;
+    config.compress = 0;
+    config.shard_index = 0;
+    config.shard_count = 0;
+    config.shard_by_dir = 0;
+    config.report_path = NULL;
+    config.coordinator_addr = NULL;
+    config.worker_addr = NULL;
+    config.lease_timeout = DISPATCH_LEASE_DEFAULT;
+    config.resume = 0;
+    config.journal_path = NULL;
     config.log_file = NULL;
     config.log_fp = NULL;
 
@@ -55,6 +93,10 @@ void init_config() {
     config.compare_mode = 0;
     config.diff_mode = 0;
     config.direct_compare_mode = 0;
+    config.convert_mode = 0;
+    config.lookup_mode = 0;
+    config.merge_mode = 0;
+    config.worker_mode = 0;
 
     // 参数初始化
     config.source_count = 0;
@@ -63,6 +105,10 @@ void init_config() {
     config.manifest_count = 0;
     config.source_dir1 = NULL;
     config.source_dir2 = NULL;
+    config.lookup_paths = NULL;
+    config.lookup_count = 0;
+    config.merge_inputs = NULL;
+    config.merge_count = 0;
 
     // 初始化统计
     stats.total_files = 0;
@@ -72,6 +118,11 @@ void init_config() {
     stats.extra_files = 0;
     stats.error_files = 0;
     stats.bytes_processed = 0;
+    stats.scanned_files = 0;
+    stats.scanned_bytes = 0;
+    stats.hashed_files = 0;
+    stats.hashed_bytes = 0;
+    stats.scan_complete = 0;
     pthread_mutex_init(&stats.lock, NULL);
     gettimeofday(&stats.start_time, NULL);
 
@@ -79,27 +130,244 @@ void init_config() {
     init_progress_bars();
 }
 
+// 解析带单位的大小 (如 64K、16M、1G)
+int parse_size(const char *str, size_t *out) {
+    if (!str || !out) return -1;
+
+    char *end;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (end == str) return -1;
+
+    switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+        default: break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    if (*end != '\0') return -1;
+
+    *out = (size_t)value;
+    return 0;
+}
+
 int parse_args(int argc, char **argv) {
     if (argc == 0 || argv == NULL) return MIRRORGUARD_OK; // 避免未使用警告
 
-    // 检查是否有 --tui 参数
-    for (int i = 1; i < argc; i++) {
-        if (strncmp(argv[i], "--tui=", 6) == 0) {
-            const char *tui_val = argv[i] + 6;
-            int tui_num = atoi(tui_val);
-            if (tui_num >= 0 && tui_num <= 5) {
-                config.tui_mode = tui_num;
-            } else {
-                fprintf(stderr, "错误: TUI 模式必须在 0-5 之间\n");
-                return MIRRORGUARD_ERROR_INVALID_ARGS;
-            }
-        }
-    }
+    // 长选项
+    enum { OPT_TUI = 256, OPT_THREADS, OPT_TREE_HASH, OPT_BLOCK_SIZE, OPT_ALGO, OPT_IO_ENGINE, OPT_CACHE_MODE,
+           OPT_HASH_CACHE, OPT_REHASH, OPT_CACHE_MAX_AGE, OPT_RECORD_MTIME,
+           OPT_SCAN_THREADS, OPT_MEMORY_LIMIT, OPT_NO_IGNORE_FILES, OPT_CONVERT, OPT_LOOKUP,
+           OPT_RESUME, OPT_JOURNAL, OPT_SHARD, OPT_SHARD_BY, OPT_REPORT, OPT_MERGE,
+           OPT_COORDINATOR, OPT_WORKER, OPT_LEASE_TIMEOUT };
+    static const struct option long_options[] = {
+        {"generate",         no_argument,       NULL, 'g'},
+        {"verify",           no_argument,       NULL, 'v'},
+        {"compare",          no_argument,       NULL, 'c'},
+        {"diff",             no_argument,       NULL, 'd'},
+        {"help",             no_argument,       NULL, 'h'},
+        {"quiet",            no_argument,       NULL, 'q'},
+        {"dry-run",          no_argument,       NULL, 'n'},
+        {"progress",         no_argument,       NULL, 'p'},
+        {"follow-symlinks",  no_argument,       NULL, 'f'},
+        {"no-recursive",     no_argument,       NULL, 'r'},
+        {"no-hidden",        no_argument,       NULL, 'H'},
+        {"no-extra-check",   no_argument,       NULL, 'e'},
+        {"case-insensitive", no_argument,       NULL, 'C'},
+        {"force",            no_argument,       NULL, 'F'},
+        {"compress",         no_argument,       NULL, 'z'},
+        {"exclude",          required_argument, NULL, 'x'},
+        {"include",          required_argument, NULL, 'i'},
+        {"no-ignore-files",  no_argument,       NULL, OPT_NO_IGNORE_FILES},
+        {"output-format",    required_argument, NULL, 'o'},
+        {"log-file",         required_argument, NULL, 'l'},
+        {"tui",              required_argument, NULL, OPT_TUI},
+        {"threads",          required_argument, NULL, OPT_THREADS},
+        {"scan-threads",     required_argument, NULL, OPT_SCAN_THREADS},
+        {"memory-limit",     required_argument, NULL, OPT_MEMORY_LIMIT},
+        {"tree-hash",        no_argument,       NULL, OPT_TREE_HASH},
+        {"block-size",       required_argument, NULL, OPT_BLOCK_SIZE},
+        {"algo",             required_argument, NULL, OPT_ALGO},
+        {"io-engine",        required_argument, NULL, OPT_IO_ENGINE},
+        {"cache-mode",       required_argument, NULL, OPT_CACHE_MODE},
+        {"hash-cache",       required_argument, NULL, OPT_HASH_CACHE},
+        {"rehash",           no_argument,       NULL, OPT_REHASH},
+        {"cache-max-age",    required_argument, NULL, OPT_CACHE_MAX_AGE},
+        {"record-mtime",     no_argument,       NULL, OPT_RECORD_MTIME},
+        {"convert",          no_argument,       NULL, OPT_CONVERT},
+        {"lookup",           no_argument,       NULL, OPT_LOOKUP},
+        {"resume",           no_argument,       NULL, OPT_RESUME},
+        {"journal",          required_argument, NULL, OPT_JOURNAL},
+        {"shard",            required_argument, NULL, OPT_SHARD},
+        {"shard-by",         required_argument, NULL, OPT_SHARD_BY},
+        {"report",           required_argument, NULL, OPT_REPORT},
+        {"merge",            no_argument,       NULL, OPT_MERGE},
+        {"coordinator",      required_argument, NULL, OPT_COORDINATOR},
+        {"worker",           required_argument, NULL, OPT_WORKER},
+        {"lease-timeout",    required_argument, NULL, OPT_LEASE_TIMEOUT},
+        {NULL, 0, NULL, 0}
+    };
 
     // 参数解析逻辑
     int opt;
-    while ((opt = getopt(argc, argv, "gvcdhVqnpfrHeCFx:i:o:l:")) != -1) {  // 移除 't' 选项
+    while ((opt = getopt_long(argc, argv, "gvcdhVqnpfrHeCFzx:i:o:l:", long_options, NULL)) != -1) {
         switch (opt) {
+            case OPT_TUI: { // TUI 模式
+                int tui_num = atoi(optarg);
+                if (tui_num >= 0 && tui_num <= 5) {
+                    config.tui_mode = tui_num;
+                } else {
+                    fprintf(stderr, "错误: TUI 模式必须在 0-5 之间\n");
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                break;
+            }
+            case OPT_THREADS: { // 工作线程数
+                int n = atoi(optarg);
+                if (n < 1 || n > MAX_THREADS) {
+                    fprintf(stderr, "错误: 线程数必须在 1-%d 之间\n", MAX_THREADS);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.threads = n;
+                break;
+            }
+            case OPT_SCAN_THREADS: { // 目录遍历线程数
+                int n = atoi(optarg);
+                if (n < 1 || n > MAX_THREADS) {
+                    fprintf(stderr, "错误: 遍历线程数必须在 1-%d 之间\n", MAX_THREADS);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.scan_threads = n;
+                break;
+            }
+            case OPT_MEMORY_LIMIT: { // 文件列表内存上限
+                size_t size;
+                if (parse_size(optarg, &size) != 0 || size < MIN_MEMORY_LIMIT) {
+                    fprintf(stderr, "错误: 无效的内存上限 '%s' (最小 %luM)\n", optarg, MIN_MEMORY_LIMIT / 1024 / 1024);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.memory_limit = size;
+                break;
+            }
+            case OPT_NO_IGNORE_FILES: // 不读取 .mirrorguardignore
+                config.ignore_files = 0;
+                break;
+            case OPT_TREE_HASH: // 树哈希
+                config.tree_hash = 1;
+                break;
+            case OPT_BLOCK_SIZE: { // 树哈希块大小
+                size_t size;
+                if (parse_size(optarg, &size) != 0 || size < MIN_TREE_BLOCK_SIZE) {
+                    fprintf(stderr, "错误: 无效的块大小 '%s' (最小 %luK)\n", optarg, MIN_TREE_BLOCK_SIZE / 1024);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.tree_block_size = size;
+                break;
+            }
+            case OPT_ALGO: { // 摘要算法
+                const DigestEngine *engine = digest_engine_by_name(optarg);
+                if (!engine || !engine->available) {
+                    char names[128];
+                    digest_list_engines(names, sizeof(names));
+                    fprintf(stderr, "错误: %s摘要算法 '%s' (可用: %s)\n",
+                            engine ? "当前构建不支持" : "未知的", optarg, names);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.digest_algo = engine->algo;
+                break;
+            }
+            case OPT_IO_ENGINE: // 读取引擎
+                if (strcmp(optarg, "sync") == 0) {
+                    config.io_engine = IO_ENGINE_SYNC;
+                } else if (strcmp(optarg, "uring") == 0 || strcmp(optarg, "io_uring") == 0) {
+                    config.io_engine = IO_ENGINE_URING;
+                } else {
+                    fprintf(stderr, "错误: 无效的读取引擎 '%s' (可用: sync/uring)\n", optarg);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                break;
+            case OPT_CACHE_MODE: // 页缓存策略
+                if (strcmp(optarg, "normal") == 0) {
+                    config.cache_mode = CACHE_MODE_NORMAL;
+                } else if (strcmp(optarg, "dontneed") == 0) {
+                    config.cache_mode = CACHE_MODE_DONTNEED;
+                } else if (strcmp(optarg, "direct") == 0) {
+                    config.cache_mode = CACHE_MODE_DIRECT;
+                } else {
+                    fprintf(stderr, "错误: 无效的缓存模式 '%s' (可用: normal/dontneed/direct)\n", optarg);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                break;
+            case OPT_RECORD_MTIME: // 清单记录 mtime
+                config.record_mtime = 1;
+                break;
+            case OPT_HASH_CACHE: // 持久哈希缓存
+                config.hash_cache_path = optarg;
+                break;
+            case OPT_REHASH: // 强制重新计算
+                config.rehash = 1;
+                break;
+            case OPT_CACHE_MAX_AGE: { // 缓存条目保留天数
+                char *end;
+                long days = strtol(optarg, &end, 10);
+                if (*end != '\0' || end == optarg || days < -1) {
+                    fprintf(stderr, "错误: 无效的缓存保留天数 '%s' (-1 表示永久保留)\n", optarg);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.cache_max_age = days < 0 ? -1 : days * 24 * 3600;
+                break;
+            }
+            case OPT_CONVERT: // 清单格式转换
+                config.convert_mode = 1;
+                break;
+            case OPT_LOOKUP: // 查询清单条目
+                config.lookup_mode = 1;
+                break;
+            case OPT_RESUME: // 从续传日志恢复
+                config.resume = 1;
+                break;
+            case OPT_JOURNAL: // 续传日志路径
+                config.journal_path = optarg;
+                break;
+            case OPT_SHARD: // 本节点处理的分片
+                if (shard_parse(optarg, &config.shard_index, &config.shard_count) != 0) {
+                    fprintf(stderr, "错误: 无效的分片 '%s' (格式 i/N，1 <= i <= N <= %d)\n", optarg, SHARD_MAX);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                break;
+            case OPT_SHARD_BY: // 分片依据
+                if (strcmp(optarg, "path") == 0) {
+                    config.shard_by_dir = 0;
+                } else if (strcmp(optarg, "dir") == 0) {
+                    config.shard_by_dir = 1;
+                } else {
+                    fprintf(stderr, "错误: 不支持的分片依据 '%s' (可用: path/dir)\n", optarg);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                break;
+            case OPT_REPORT: // 验证结果报告
+                config.report_path = optarg;
+                break;
+            case OPT_MERGE: // 合并分片清单/报告
+                config.merge_mode = 1;
+                break;
+            case OPT_COORDINATOR: // 作为协调器分发哈希任务
+                config.coordinator_addr = optarg;
+                break;
+            case OPT_WORKER: // 为协调器哈希文件
+                config.worker_mode = 1;
+                config.worker_addr = optarg;
+                break;
+            case OPT_LEASE_TIMEOUT: { // 租约秒数
+                char *end;
+                long seconds = strtol(optarg, &end, 10);
+                if (*end != '\0' || end == optarg || seconds < 1 || seconds > 86400) {
+                    fprintf(stderr, "错误: 无效的租约秒数 '%s' (1-86400)\n", optarg);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
+                config.lease_timeout = (int)seconds;
+                break;
+            }
             case 'g': // generate mode
                 config.generate_mode = 1;
                 break;
@@ -140,20 +408,32 @@ int parse_args(int argc, char **argv) {
             case 'C': // case insensitive
                 config.case_sensitive = 0;
                 break;
+            case 'z': // compress
+                config.compress = 1;
+                break;
             case 'F': // force
                 config.force_overwrite = 1;
                 break;
             case 'x': // exclude
-                if (config.exclude_count < MAX_EXCLUDE_PATTERNS) {
-                    config.exclude_patterns[config.exclude_count++] = optarg;
+                if (!config.exclude_patterns) config.exclude_patterns = pattern_set_create();
+                if (pattern_set_add(config.exclude_patterns, optarg) != 0) {
+                    fprintf(stderr, "错误: 内存不足，无法添加排除模式\n");
+                    return MIRRORGUARD_ERROR_MEMORY;
                 }
                 break;
             case 'i': // include
-                if (config.include_count < MAX_INCLUDE_PATTERNS) {
-                    config.include_patterns[config.include_count++] = optarg;
+                if (!config.include_patterns) config.include_patterns = pattern_set_create();
+                if (pattern_set_add(config.include_patterns, optarg) != 0) {
+                    fprintf(stderr, "错误: 内存不足，无法添加包含模式\n");
+                    return MIRRORGUARD_ERROR_MEMORY;
                 }
                 break;
             case 'o': // output format
+                if (strcmp(optarg, "mirrorguard") != 0 && strcmp(optarg, "sha256sum") != 0 &&
+                    strcmp(optarg, "mgidx") != 0) {
+                    fprintf(stderr, "错误: 不支持的清单格式 '%s' (可用: mirrorguard/sha256sum/mgidx)\n", optarg);
+                    return MIRRORGUARD_ERROR_INVALID_ARGS;
+                }
                 config.output_format = optarg;
                 break;
             case 'l': // log file
@@ -167,8 +447,9 @@ int parse_args(int argc, char **argv) {
     // 解析剩余参数（源目录、清单文件等）
     int remaining = optind;
     if (config.generate_mode) {
-        // 解析生成模式的参数
-        while (remaining < argc && argv[remaining][0] != '-' && !is_tui_option(argv[remaining])) {
+        // 解析生成模式的参数：最后一个为清单文件，其余为源目录
+        int last = argc - 1;
+        while (remaining < last && !is_tui_option(argv[remaining])) {
             if (config.source_count < MAX_SOURCE_DIRS) {
                 config.source_dirs[config.source_count++] = argv[remaining];
             } else {
@@ -176,8 +457,8 @@ int parse_args(int argc, char **argv) {
             }
             remaining++;
         }
-        if (remaining < argc) {
-            config.manifest_path = argv[remaining];
+        if (remaining <= last) {
+            config.manifest_path = argv[last];
         }
     } else if (config.verify_mode) {
         // 解析验证模式的参数
@@ -192,6 +473,43 @@ int parse_args(int argc, char **argv) {
         // 解析直接比较模式的参数
         if (remaining < argc) config.source_dir1 = argv[remaining++];
         if (remaining < argc) config.source_dir2 = argv[remaining];
+    } else if (config.convert_mode) {
+        // 解析转换模式的参数：输入清单、输出清单
+        if (remaining < argc) config.manifest_files[0] = argv[remaining++];
+        if (remaining < argc) config.manifest_files[1] = argv[remaining];
+        config.manifest_count = 2;
+    } else if (config.lookup_mode) {
+        // 解析查询模式的参数：清单文件，其后为要查询的路径
+        if (remaining < argc) config.manifest_path = argv[remaining++];
+        config.lookup_paths = argv + remaining;
+        config.lookup_count = argc - remaining;
+    } else if (config.merge_mode) {
+        // 解析合并模式的参数：输出文件，其后为各分片的清单或报告
+        if (remaining < argc) config.manifest_path = argv[remaining++];
+        config.merge_inputs = argv + remaining;
+        config.merge_count = argc - remaining;
+    }
+
+    if (config.resume && config.dry_run) {
+        fprintf(stderr, "错误: 模拟运行 (-n) 不记录续传日志，不能与 --resume 同时使用\n");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    if (config.coordinator_addr && config.tree_hash) {
+        fprintf(stderr, "错误: 分布式生成 (--coordinator) 不支持 --tree-hash\n");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    if (config.compress && strcmp(config.output_format, "mgidx") == 0) {
+        fprintf(stderr, "错误: 二进制清单 (-o mgidx) 不支持 -z 压缩\n");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    // 所有模式编译为自动机 (-C 可能出现在模式之后，故在最后统一编译)
+    if (pattern_set_compile(config.exclude_patterns, !config.case_sensitive) != 0 ||
+        pattern_set_compile(config.include_patterns, !config.case_sensitive) != 0) {
+        fprintf(stderr, "错误: 内存不足，无法编译匹配模式\n");
+        return MIRRORGUARD_ERROR_MEMORY;
     }
 
     return MIRRORGUARD_OK;
@@ -205,8 +523,9 @@ int is_tui_option(const char *arg) {
 int validate_args(int argc, char **argv) {
     if (argc == 0 || argv == NULL) return MIRRORGUARD_OK; // 避免未使用警告
 
-    int mode_count = config.generate_mode + config.verify_mode +
-                     config.compare_mode + config.direct_compare_mode;
+    int mode_count = config.generate_mode + config.verify_mode + config.compare_mode +
+                     config.direct_compare_mode + config.convert_mode + config.lookup_mode + config.merge_mode +
+                     config.worker_mode;
 
     if (mode_count == 0) {
         // 如果没有操作模式，但有 -V 参数，这可能是版本请求
@@ -234,12 +553,39 @@ int validate_args(int argc, char **argv) {
         if (!config.source_dir1 || !config.source_dir2) {
             return MIRRORGUARD_ERROR_INVALID_ARGS;
         }
+    } else if (config.convert_mode) {
+        if (config.manifest_count != 2 || !config.manifest_files[0] || !config.manifest_files[1]) {
+            return MIRRORGUARD_ERROR_INVALID_ARGS;
+        }
+    } else if (config.lookup_mode) {
+        if (!config.manifest_path || config.lookup_count < 1) {
+            return MIRRORGUARD_ERROR_INVALID_ARGS;
+        }
+    } else if (config.merge_mode) {
+        if (!config.manifest_path || config.merge_count < 1) {
+            return MIRRORGUARD_ERROR_INVALID_ARGS;
+        }
+    }
+
+    // 协调器只用于生成
+    if (config.coordinator_addr && !config.generate_mode) {
+        return MIRRORGUARD_ERROR_CONFLICT;
     }
 
     return MIRRORGUARD_OK;
 }
 
 void cleanup_config() {
+    // 停止哈希工作池
+    thread_pool_destroy(g_hash_pool);
+    g_hash_pool = NULL;
+
+    // 保存哈希缓存 (须在工作池停止后，保证所有结果已写入)
+    hash_cache_close(!config.dry_run);
+
+    // 未正常结束的续传日志刷盘保留
+    journal_close(1);
+
     // 清理资源
     if (config.log_fp) {
         fclose(config.log_fp);
@@ -255,15 +601,10 @@ void cleanup_config() {
     cleanup_progress_bars();
 
     // 清理排除/包含模式
-    for (int i = 0; i < config.exclude_count; i++) {
-        config.exclude_patterns[i] = NULL;
-    }
-    config.exclude_count = 0;
-
-    for (int i = 0; i < config.include_count; i++) {
-        config.include_patterns[i] = NULL;
-    }
-    config.include_count = 0;
+    pattern_set_free(config.exclude_patterns);
+    config.exclude_patterns = NULL;
+    pattern_set_free(config.include_patterns);
+    config.include_patterns = NULL;
 
     // 重置源目录
     config.source_count = 0;
@@ -1,70 +1,685 @@
 #include "data_structs.h"
+#include "config.h"
 #include "logging.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
 #include <pthread.h>
 
+// 有序段中的记录：定长头部后紧跟路径 (不含结尾 0)
+typedef struct {
+    Digest digest;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t path_len;
+} SpillRecord;
+
+// 单条目的估算占用：紧凑条目 + 文件名 + 摘要 + 排序时的指针与归并缓冲
+#define FILE_LIST_ENTRY_COST(name_len, digest_len) \
+    (sizeof(FileEntry) + (name_len) + 1 + (digest_len) + sizeof(size_t) + 2 * sizeof(FileListSortKey))
+// 单个目录的估算占用：目录表项 + 路径 + 两个散列槽
+#define FILE_LIST_DIR_COST(len) (sizeof(FileListDir) + (len) + 1 + 2 * sizeof(uint32_t))
+
+// 按路径排序文件列表；路径相同时按摘要与大小定序，保证输出稳定
+int compare_file_info_by_path(const void *a, const void *b) {
+    const FileInfo *info_a = (const FileInfo *)a;
+    const FileInfo *info_b = (const FileInfo *)b;
+    int cmp = strcmp(info_a->path, info_b->path);
+    if (cmp != 0) return cmp;
+    // 多源目录可能有同名文件，按摘要与大小定序，保证并行扫描的输出稳定
+    cmp = memcmp(info_a->digest.bytes, info_b->digest.bytes, MAX_DIGEST_LENGTH);
+    if (cmp != 0) return cmp;
+    return (info_a->size > info_b->size) - (info_a->size < info_b->size);
+}
+
 FileList* create_file_list() {
-    FileList *list = malloc(sizeof(FileList));
+    FileList *list = calloc(1, sizeof(FileList));
     if (!list) {
         return NULL;
     }
 
-    list->files = NULL;
-    list->count = 0;
-    list->capacity = 0;
     pthread_mutex_init(&list->lock, NULL);
 
     return list;
 }
 
+static void free_arena(PathArenaBlock *block) {
+    while (block) {
+        PathArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
 void free_file_list(FileList *list) {
     if (!list) return;
 
-    for (size_t i = 0; i < list->count; i++) {
-        free_file_info(&list->files[i]);
+    for (size_t i = 0; i < list->chunk_count; i++) {
+        free(list->chunks[i]);
+    }
+    free(list->chunks);
+    free_arena(list->arena);
+    free_arena(list->dir_arena);
+    free(list->dirs);
+    free(list->dir_slots);
+    free(list->rank_last);
+    free(list->path_slots);
+    for (size_t i = 0; i < list->run_count; i++) {
+        fclose(list->runs[i]);
     }
-    free(list->files);
+    free(list->runs);
     pthread_mutex_destroy(&list->lock);
     free(list);
 }
 
-int add_file_to_list(FileList *list, const char *path, const char *hash, size_t size, time_t mtime) {
-    if (!list || !path || !hash) return -1;
+// 设置内存上限 (字节)，0 表示不限制
+void file_list_set_memory_limit(FileList *list, size_t limit) {
+    if (list) list->memory_limit = limit;
+}
+
+// 列表中的条目总数 (含已落盘的条目)
+size_t file_list_total(const FileList *list) {
+    return list ? list->count + list->spilled : 0;
+}
+
+static FileEntry* entry_at(const FileList *list, size_t index) {
+    return &list->chunks[index / FILE_LIST_CHUNK][index % FILE_LIST_CHUNK];
+}
+
+// 拼出条目的完整相对路径；buf 至少 MAX_PATH 字节
+static void entry_path(const FileList *list, const FileEntry *entry, char *buf) {
+    const FileListDir *dir = &list->dirs[entry->dir];
+    size_t pos = 0;
+    if (dir->len > 0) {
+        memcpy(buf, dir->path, dir->len);
+        buf[dir->len] = '/';
+        pos = dir->len + 1;
+    }
+    memcpy(buf + pos, entry->name, entry->name_len + 1);
+}
+
+static void entry_digest(const FileEntry *entry, Digest *digest) {
+    const unsigned char *bytes = (const unsigned char *)entry->name + entry->name_len + 1;
+    size_t tree_block_size = 0;
+    if (entry->tree) memcpy(&tree_block_size, bytes + entry->digest_len, sizeof(size_t));
+    digest_set(digest, bytes, entry->digest_len, tree_block_size);
+}
+
+// 还原为完整的文件信息，路径写入 buf
+static void entry_to_info(const FileList *list, const FileEntry *entry, FileInfo *info, char *buf) {
+    entry_path(list, entry, buf);
+    info->path = buf;
+    entry_digest(entry, &info->digest);
+    info->size = entry->size;
+    info->mtime = entry->mtime;
+}
+
+// 取内存中第 index 个条目的路径 (不含已落盘的条目)
+const char* file_list_path(const FileList *list, size_t index, char *buf, size_t size) {
+    if (!list || index >= list->count || size < MAX_PATH) return NULL;
+    entry_path(list, entry_at(list, index), buf);
+    return buf;
+}
+
+// 从存储块中分配；调用方持有列表锁
+static char* arena_alloc(PathArenaBlock **arena, size_t len) {
+    PathArenaBlock *block = *arena;
+    if (!block || block->used + len > FILE_LIST_ARENA_BLOCK) {
+        block = malloc(sizeof(PathArenaBlock) + FILE_LIST_ARENA_BLOCK);
+        if (!block) return NULL;
+        block->next = *arena;
+        block->used = 0;
+        *arena = block;
+    }
+    char *dst = block->data + block->used;
+    block->used += len;
+    return dst;
+}
+
+static uint32_t dir_hash(const char *path, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)path[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// 散列表扩容为 slot_count 个槽并重新放入所有目录
+static int dir_rehash(FileList *list, size_t slot_count) {
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) return -1;
+    for (uint32_t id = 0; id < list->dir_count; id++) {
+        size_t i = list->dirs[id].hash & (slot_count - 1);
+        while (slots[i]) i = (i + 1) & (slot_count - 1);
+        slots[i] = id + 1;
+    }
+    free(list->dir_slots);
+    list->dir_slots = slots;
+    list->dir_slot_count = slot_count;
+    return 0;
+}
+
+// 在目录散列表中查找，找到时返回 1
+static int find_dir(const FileList *list, const char *path, size_t len, uint32_t hash, uint32_t *id) {
+    if (!list->dir_slots) return 0;
+    size_t mask = list->dir_slot_count - 1;
+    for (size_t i = hash & mask; list->dir_slots[i]; i = (i + 1) & mask) {
+        const FileListDir *dir = &list->dirs[list->dir_slots[i] - 1];
+        if (dir->hash == hash && dir->len == len && memcmp(dir->path, path, len) == 0) {
+            *id = list->dir_slots[i] - 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 查找或登记目录路径，返回目录编号；调用方持有列表锁
+static int intern_dir(FileList *list, const char *path, size_t len, uint32_t *id) {
+    if (list->dir_count > 0) {
+        const FileListDir *last = &list->dirs[list->last_dir];
+        if (last->len == len && memcmp(last->path, path, len) == 0) {
+            *id = list->last_dir;
+            return 0;
+        }
+    }
+
+    uint32_t hash = dir_hash(path, len);
+    if (find_dir(list, path, len, hash, id)) {
+        list->last_dir = *id;
+        return 0;
+    }
+
+    // 新目录：负载超过一半时散列表翻倍
+    if ((size_t)(list->dir_count + 1) * 2 > list->dir_slot_count &&
+        dir_rehash(list, list->dir_slot_count ? list->dir_slot_count * 2 : 256) != 0) {
+        return -1;
+    }
+    if (list->dir_count == list->dir_capacity) {
+        uint32_t new_capacity = list->dir_capacity ? list->dir_capacity * 2 : 64;
+        FileListDir *dirs = realloc(list->dirs, new_capacity * sizeof(FileListDir));
+        if (!dirs) return -1;
+        list->dirs = dirs;
+        list->dir_capacity = new_capacity;
+    }
+    char *stored = arena_alloc(&list->dir_arena, len + 1);
+    if (!stored) return -1;
+    memcpy(stored, path, len);
+    stored[len] = '\0';
+
+    FileListDir *dir = &list->dirs[list->dir_count];
+    dir->path = stored;
+    dir->len = (uint32_t)len;
+    dir->hash = hash;
+
+    size_t mask = list->dir_slot_count - 1;
+    size_t i = hash & mask;
+    while (list->dir_slots[i]) i = (i + 1) & mask;
+    list->dir_slots[i] = list->dir_count + 1;
+
+    *id = list->last_dir = list->dir_count++;
+    list->dir_memory += FILE_LIST_DIR_COST(len);
+    list->memory_used += FILE_LIST_DIR_COST(len);
+    return 0;
+}
+
+// 路径索引的散列值：目录编号与文件名共同决定，查找时无需拼出完整路径
+static uint32_t entry_hash(uint32_t dir, const char *name, size_t name_len) {
+    return dir_hash(name, name_len) ^ (dir * 0x9e3779b1u);
+}
+
+// 为内存中的条目建立路径索引 (负载不超过一半)，之后可用 file_list_find 按路径查找；
+// 建立后再添加条目会使索引失效
+int file_list_build_index(FileList *list) {
+    if (!list) return -1;
+    size_t slot_count = 16;
+    while (slot_count < list->count * 2) slot_count *= 2;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) return -1;
+
+    size_t mask = slot_count - 1;
+    for (size_t index = 0; index < list->count; index++) {
+        const FileEntry *entry = entry_at(list, index);
+        size_t i = entry_hash(entry->dir, entry->name, entry->name_len) & mask;
+        while (slots[i]) i = (i + 1) & mask;
+        slots[i] = (uint32_t)index + 1;
+    }
+    free(list->path_slots);
+    list->path_slots = slots;
+    list->path_slot_count = slot_count;
+    return 0;
+}
+
+// 按完整相对路径查找内存中的条目，找到时返回 1 并写入下标；需先建立索引
+int file_list_find(const FileList *list, const char *path, size_t *index) {
+    if (!list || !path || !list->path_slots) return 0;
 
-    FileInfo *info = create_file_info(path, hash, size, mtime);
-    if (!info) return -1;
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path) : 0;
+    const char *name = slash ? slash + 1 : path;
+    size_t name_len = strlen(name);
+
+    uint32_t dir;
+    if (!find_dir(list, path, dir_len, dir_hash(path, dir_len), &dir)) return 0;
+
+    size_t mask = list->path_slot_count - 1;
+    for (size_t i = entry_hash(dir, name, name_len) & mask; list->path_slots[i]; i = (i + 1) & mask) {
+        const FileEntry *entry = entry_at(list, list->path_slots[i] - 1);
+        if (entry->dir == dir && entry->name_len == name_len && memcmp(entry->name, name, name_len) == 0) {
+            *index = list->path_slots[i] - 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 第 i 个字节 (按 目录 + '/' + 文件名 拼接)
+static inline unsigned char entry_path_char(const FileListDir *dir, const FileEntry *entry, size_t i) {
+    if (dir->len == 0) return (unsigned char)entry->name[i];
+    if (i < dir->len) return (unsigned char)dir->path[i];
+    if (i == dir->len) return '/';
+    return (unsigned char)entry->name[i - dir->len - 1];
+}
+
+// 按 路径 + '/' 比较两个目录 (根目录为空串，排在最前)
+static int compare_dirs(const void *a, const void *b) {
+    const FileListDir *dir_a = *(const FileListDir * const *)a;
+    const FileListDir *dir_b = *(const FileListDir * const *)b;
+    if (dir_a->len == 0 || dir_b->len == 0) return (dir_a->len != 0) - (dir_b->len != 0);
+    size_t common = dir_a->len < dir_b->len ? dir_a->len : dir_b->len;
+    int cmp = memcmp(dir_a->path, dir_b->path, common);
+    if (cmp != 0 || dir_a->len == dir_b->len) return cmp;
+    unsigned char ca = dir_a->len > common ? (unsigned char)dir_a->path[common] : '/';
+    unsigned char cb = dir_b->len > common ? (unsigned char)dir_b->path[common] : '/';
+    if (ca != cb) return (int)ca - (int)cb;
+    return dir_a->len < dir_b->len ? -1 : 1;
+}
+
+// ancestor 是否为 dir 本身或其祖先目录
+static int dir_contains(const FileListDir *ancestor, const FileListDir *dir) {
+    if (ancestor->len == 0) return 1;
+    return dir->len >= ancestor->len && memcmp(dir->path, ancestor->path, ancestor->len) == 0 &&
+           (dir->len == ancestor->len || dir->path[ancestor->len] == '/');
+}
+
+// 计算目录名次与子孙范围：名次不同且互不包含的目录，其下条目的顺序由名次决定
+static int rank_dirs(FileList *list) {
+    size_t n = list->dir_count ? list->dir_count : 1;
+    FileListDir **order = malloc(n * sizeof(FileListDir *));
+    FileListDir **stack = malloc(n * sizeof(FileListDir *));
+    uint32_t *rank_last = realloc(list->rank_last, n * sizeof(uint32_t));
+    if (!order || !stack || !rank_last) {
+        free(order);
+        free(stack);
+        return -1;
+    }
+    list->rank_last = rank_last;
+    for (uint32_t i = 0; i < list->dir_count; i++) {
+        order[i] = &list->dirs[i];
+    }
+    qsort(order, list->dir_count, sizeof(FileListDir *), compare_dirs);
+
+    size_t depth = 0;
+    for (uint32_t rank = 0; rank < list->dir_count; rank++) {
+        while (depth > 0 && !dir_contains(stack[depth - 1], order[rank])) {
+            rank_last[stack[--depth]->rank] = rank - 1;
+        }
+        order[rank]->rank = rank;
+        stack[depth++] = order[rank];
+    }
+    while (depth > 0) {
+        rank_last[stack[--depth]->rank] = list->dir_count - 1;
+    }
+    free(order);
+    free(stack);
+    return 0;
+}
+
+// 与 compare_file_info_by_path 相同的顺序，但不拼接路径 (需先调用 rank_dirs)
+static int compare_keys(const FileList *list, const FileListSortKey *key_a, const FileListSortKey *key_b) {
+    // 互不包含的目录：由名次决定，无需访问条目
+    if (key_a->rank < key_b->rank && key_b->rank > list->rank_last[key_a->rank]) return -1;
+    if (key_b->rank < key_a->rank && key_a->rank > list->rank_last[key_b->rank]) return 1;
+
+    const FileEntry *a = entry_at(list, key_a->index);
+    const FileEntry *b = entry_at(list, key_b->index);
+    int cmp;
+    if (key_a->rank == key_b->rank) {
+        cmp = strcmp(a->name, b->name);
+    } else {
+        // 一方目录是另一方的祖先：比较祖先侧的文件名与另一侧在祖先之下的剩余路径
+        int swapped = key_a->rank > key_b->rank;
+        if (swapped) {
+            const FileEntry *entry = a; a = b; b = entry;
+        }
+        const FileListDir *dir_a = &list->dirs[a->dir];
+        const FileListDir *dir_b = &list->dirs[b->dir];
+        size_t offset = dir_a->len ? dir_a->len + 1 : 0;
+        size_t len_b = dir_b->len + 1 + b->name_len - offset;
+        cmp = 0;
+        for (size_t i = 0; cmp == 0 && i < a->name_len && i < len_b; i++) {
+            cmp = (int)(unsigned char)a->name[i] - (int)entry_path_char(dir_b, b, offset + i);
+        }
+        // 剩余路径至少包含一个 '/'，不会与文件名完全相同
+        if (cmp == 0) cmp = a->name_len < len_b ? -1 : 1;
+        return swapped ? -cmp : cmp;
+    }
+    if (cmp != 0) return cmp;
+
+    // 路径相同 (多源同名文件)，还原摘要后按原规则定序
+    Digest digest_a, digest_b;
+    entry_digest(a, &digest_a);
+    entry_digest(b, &digest_b);
+    cmp = memcmp(digest_a.bytes, digest_b.bytes, MAX_DIGEST_LENGTH);
+    if (cmp != 0) return cmp;
+    return (a->size > b->size) - (a->size < b->size);
+}
+
+// 自底向上归并排序 (比较需要目录表，qsort 无法传入上下文)；返回存放结果的数组
+static FileListSortKey* sort_keys(const FileList *list, FileListSortKey *items, FileListSortKey *tmp, size_t n) {
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                tmp[k++] = compare_keys(list, &items[j], &items[i]) < 0 ? items[j++] : items[i++];
+            }
+            while (i < mid) tmp[k++] = items[i++];
+            while (j < hi) tmp[k++] = items[j++];
+        }
+        FileListSortKey *swap = items;
+        items = tmp;
+        tmp = swap;
+    }
+    return items;
+}
+
+// 内存中的条目排序后的排序键数组
+static FileListSortKey* sort_in_memory(FileList *list) {
+    size_t n = list->count ? list->count : 1;
+    FileListSortKey *items = malloc(n * sizeof(FileListSortKey));
+    FileListSortKey *tmp = malloc(n * sizeof(FileListSortKey));
+    if (!items || !tmp || rank_dirs(list) != 0) {
+        free(items);
+        free(tmp);
+        return NULL;
+    }
+    for (size_t i = 0; i < list->count; i++) {
+        items[i].rank = list->dirs[entry_at(list, i)->dir].rank;
+        items[i].index = (uint32_t)i;
+    }
+    FileListSortKey *sorted = sort_keys(list, items, tmp, list->count);
+    free(sorted == items ? tmp : items);
+    return sorted;
+}
+
+// 创建已删除目录项的临时文件，进程退出时自动回收
+static FILE* open_spill_file(void) {
+    const char *dir = getenv("TMPDIR");
+    char path[MAX_PATH];
+    snprintf(path, sizeof(path), "%s/mirrorguard-spill-XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        log_msg(LOG_ERROR, "无法创建临时文件 '%s': %s", path, strerror(errno));
+        return NULL;
+    }
+    unlink(path);
+    FILE *fp = fdopen(fd, "w+b");
+    if (!fp) close(fd);
+    return fp;
+}
+
+// 内存中的条目排序后写入一个有序段，然后清空内存部分；调用方持有列表锁
+static int spill_run(FileList *list) {
+    FILE **runs = realloc(list->runs, (list->run_count + 1) * sizeof(FILE *));
+    if (!runs) return -1;
+    list->runs = runs;
+
+    FileListSortKey *sorted = sort_in_memory(list);
+    FILE *fp = sorted ? open_spill_file() : NULL;
+    if (!fp) {
+        free(sorted);
+        return -1;
+    }
+
+    char path[MAX_PATH];
+    for (size_t i = 0; i < list->count; i++) {
+        FileInfo info;
+        SpillRecord rec;
+        entry_to_info(list, entry_at(list, sorted[i].index), &info, path);
+        memset(&rec, 0, sizeof(rec));
+        rec.digest = info.digest;
+        rec.size = info.size;
+        rec.mtime = info.mtime;
+        rec.path_len = strlen(path);
+        fwrite(&rec, sizeof(rec), 1, fp);
+        fwrite(path, 1, rec.path_len, fp);
+    }
+    free(sorted);
+
+    if (fflush(fp) != 0 || ferror(fp) || fseek(fp, 0, SEEK_SET) != 0) {
+        log_msg(LOG_ERROR, "写入临时文件失败: %s", strerror(errno));
+        fclose(fp);
+        return -1;
+    }
+
+    list->runs[list->run_count++] = fp;
+    list->spilled += list->count;
+    list->count = 0;
+    // 目录表在各有序段之间共用，不随条目清空
+    list->memory_used = list->dir_memory;
+
+    // 保留一个存储块复用，分段保留给后续条目
+    if (list->arena) {
+        free_arena(list->arena->next);
+        list->arena->next = NULL;
+        list->arena->used = 0;
+    }
+    return 0;
+}
+
+int add_file_to_list(FileList *list, const char *path, const Digest *digest, size_t size, time_t mtime) {
+    if (!path) return -1;
+    return add_file_to_list_n(list, path, strlen(path), digest, size, mtime);
+}
+
+// 路径以长度给出，不必以 '\0' 结尾 (如清单映射中的路径)
+int add_file_to_list_n(FileList *list, const char *path, size_t len, const Digest *digest, size_t size,
+                       time_t mtime) {
+    if (!list || !path || !digest) return -1;
+
+    size_t dir_len = len;
+    while (dir_len > 0 && path[dir_len - 1] != '/') dir_len--;
+    const char *name = path + dir_len;
+    size_t name_len = len - dir_len;
+    if (dir_len > 0) dir_len--;
+    if (len >= MAX_PATH) {
+        log_msg(LOG_ERROR, "路径过长: %.*s", (int)len, path);
+        return -1;
+    }
+    size_t cost = FILE_LIST_ENTRY_COST(name_len, digest->len);
 
     pthread_mutex_lock(&list->lock);
 
-    if (list->count >= list->capacity) {
-        size_t new_capacity = list->capacity ? list->capacity * 2 : 128;
-        if (new_capacity > 1000000) { // 防止内存耗尽
-            pthread_mutex_unlock(&list->lock);
-            free_file_info(info);
-            log_msg(LOG_ERROR, "文件列表过大，防止内存溢出");
-            return -1;
+    if (list->memory_limit > 0 && list->count > 0 &&
+        list->memory_used + cost > list->memory_limit &&
+        spill_run(list) != 0) {
+        log_msg(LOG_WARN, "无法写出有序段，继续在内存中累积");
+        list->memory_limit = 0;
+    }
+
+    // 排序键以 32 位记录下标
+    if (list->count == UINT32_MAX) {
+        pthread_mutex_unlock(&list->lock);
+        log_msg(LOG_ERROR, "文件列表条目过多，请设置 --memory-limit");
+        return -1;
+    }
+
+    size_t chunk = list->count / FILE_LIST_CHUNK;
+    if (chunk == list->chunk_count) {
+        if (list->chunk_count == list->chunk_capacity) {
+            size_t new_capacity = list->chunk_capacity ? list->chunk_capacity * 2 : 16;
+            FileEntry **chunks = realloc(list->chunks, new_capacity * sizeof(FileEntry *));
+            if (!chunks) {
+                pthread_mutex_unlock(&list->lock);
+                log_msg(LOG_ERROR, "内存分配失败: 文件列表");
+                return -1;
+            }
+            list->chunks = chunks;
+            list->chunk_capacity = new_capacity;
         }
-        FileInfo *new_files = realloc(list->files, new_capacity * sizeof(FileInfo));
-        if (!new_files) {
+        list->chunks[list->chunk_count] = malloc(FILE_LIST_CHUNK * sizeof(FileEntry));
+        if (!list->chunks[list->chunk_count]) {
             pthread_mutex_unlock(&list->lock);
-            free_file_info(info);
             log_msg(LOG_ERROR, "内存分配失败: 文件列表");
             return -1;
         }
-        list->files = new_files;
-        list->capacity = new_capacity;
+        list->chunk_count++;
+    }
+
+    // 文件名、摘要与树哈希块大小连续存放
+    uint32_t dir;
+    size_t stored_len = name_len + 1 + digest->len + (digest->tree_block_size ? sizeof(size_t) : 0);
+    char *stored = intern_dir(list, path, dir_len, &dir) == 0 ? arena_alloc(&list->arena, stored_len) : NULL;
+    if (!stored) {
+        pthread_mutex_unlock(&list->lock);
+        log_msg(LOG_ERROR, "内存分配失败: 文件列表");
+        return -1;
+    }
+    memcpy(stored, name, name_len);
+    stored[name_len] = '\0';
+    memcpy(stored + name_len + 1, digest->bytes, digest->len);
+    if (digest->tree_block_size) {
+        memcpy(stored + name_len + 1 + digest->len, &digest->tree_block_size, sizeof(size_t));
     }
 
-    list->files[list->count] = *info;
+    FileEntry *entry = &list->chunks[chunk][list->count % FILE_LIST_CHUNK];
+    entry->name = stored;
+    entry->size = size;
+    entry->mtime = mtime;
+    entry->dir = dir;
+    entry->name_len = (uint16_t)name_len;
+    entry->digest_len = digest->len;
+    entry->tree = digest->tree_block_size != 0;
     list->count++;
+    if (list->path_slots) {
+        free(list->path_slots);
+        list->path_slots = NULL;
+        list->path_slot_count = 0;
+    }
+    list->memory_used += cost;
 
     pthread_mutex_unlock(&list->lock);
-    free_file_info(info);
     return 0;
 }
 
-FileInfo* create_file_info(const char *path, const char *hash, size_t size, time_t mtime) {
+// 读取来源 source 的下一条目到 heads[source]；来源耗尽时返回 0
+static int iter_fill(FileListIter *it, size_t source) {
+    if (source == 0) {
+        if (it->sorted_pos >= it->sorted_count) return 0;
+        entry_to_info(it->list, entry_at(it->list, it->sorted[it->sorted_pos++].index), &it->heads[0], it->head_paths);
+        return 1;
+    }
+
+    FILE *fp = it->runs[source - 1];
+    SpillRecord rec;
+    if (fread(&rec, sizeof(rec), 1, fp) != 1) return 0;
+    char *path = it->head_paths + source * MAX_PATH;
+    if (rec.path_len >= MAX_PATH || fread(path, 1, rec.path_len, fp) != rec.path_len) {
+        log_msg(LOG_ERROR, "临时文件已损坏");
+        return 0;
+    }
+    path[rec.path_len] = '\0';
+
+    FileInfo *head = &it->heads[source];
+    head->path = path;
+    head->digest = rec.digest;
+    head->size = rec.size;
+    head->mtime = rec.mtime;
+    return 1;
+}
+
+static int iter_less(const FileListIter *it, size_t a, size_t b) {
+    return compare_file_info_by_path(&it->heads[it->heap[a]], &it->heads[it->heap[b]]) < 0;
+}
+
+static void iter_sift_down(FileListIter *it, size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < it->heap_size && iter_less(it, left, smallest)) smallest = left;
+        if (right < it->heap_size && iter_less(it, right, smallest)) smallest = right;
+        if (smallest == i) return;
+        size_t tmp = it->heap[i];
+        it->heap[i] = it->heap[smallest];
+        it->heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// 开始按路径顺序遍历列表；遍历期间不能再向列表添加条目
+int file_list_iter_begin(FileList *list, FileListIter *it) {
+    memset(it, 0, sizeof(*it));
+    if (!list) return -1;
+
+    it->list = list;
+    it->runs = list->runs;
+    it->source_count = list->run_count + 1;
+    it->sorted = sort_in_memory(list);
+    it->sorted_count = list->count;
+    it->heads = malloc(it->source_count * sizeof(FileInfo));
+    it->heap = malloc(it->source_count * sizeof(size_t));
+    it->head_paths = malloc(it->source_count * MAX_PATH);
+    it->current_path = malloc(MAX_PATH);
+    if (!it->sorted || !it->heads || !it->heap || !it->head_paths || !it->current_path) {
+        file_list_iter_end(it);
+        log_msg(LOG_ERROR, "内存分配失败: 文件列表遍历");
+        return -1;
+    }
+
+    for (size_t i = 0; i < list->run_count; i++) {
+        fseek(list->runs[i], 0, SEEK_SET);
+    }
+    for (size_t source = 0; source < it->source_count; source++) {
+        if (iter_fill(it, source)) it->heap[it->heap_size++] = source;
+    }
+    for (size_t i = it->heap_size / 2; i-- > 0; ) {
+        iter_sift_down(it, i);
+    }
+    return 0;
+}
+
+// 取下一个条目；返回的指针在下一次调用前有效，结束时返回 NULL
+const FileInfo* file_list_iter_next(FileListIter *it) {
+    if (!it->heap || it->heap_size == 0) return NULL;
+
+    size_t source = it->heap[0];
+    it->current = it->heads[source];
+    size_t len = strlen(it->current.path);
+    memcpy(it->current_path, it->current.path, len + 1);
+    it->current.path = it->current_path;
+
+    if (!iter_fill(it, source)) {
+        it->heap[0] = it->heap[--it->heap_size];
+    }
+    iter_sift_down(it, 0);
+    return &it->current;
+}
+
+void file_list_iter_end(FileListIter *it) {
+    free(it->sorted);
+    free(it->heads);
+    free(it->heap);
+    free(it->head_paths);
+    free(it->current_path);
+    memset(it, 0, sizeof(*it));
+}
+
+FileInfo* create_file_info(const char *path, const Digest *digest, size_t size, time_t mtime) {
     FileInfo *info = malloc(sizeof(FileInfo));
     if (!info) return NULL;
 
@@ -74,11 +689,10 @@ FileInfo* create_file_info(const char *path, const char *hash, size_t size, time
         return NULL;
     }
 
-    if (hash) {
-        strncpy(info->hash, hash, sizeof(info->hash) - 1);
-        info->hash[sizeof(info->hash) - 1] = '\0';
+    if (digest) {
+        info->digest = *digest;
     } else {
-        info->hash[0] = '\0';
+        memset(&info->digest, 0, sizeof(info->digest));
     }
 
     info->size = size;
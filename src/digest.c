@@ -0,0 +1,367 @@
+#include "digest.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <openssl/evp.h>
+#ifdef HAVE_BLAKE3
+#include <blake3.h>
+#endif
+#ifdef HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
+// 引擎表，下标与 DigestAlgo 一致
+static const DigestEngine engines[DIGEST_ALGO_COUNT] = {
+    { DIGEST_ALGO_SHA256,   "sha256",  32, 1 },
+#ifdef HAVE_BLAKE3
+    { DIGEST_ALGO_BLAKE3,   "blake3",  32, 1 },
+#else
+    { DIGEST_ALGO_BLAKE3,   "blake3",  32, 0 },
+#endif
+#ifdef HAVE_XXHASH
+    { DIGEST_ALGO_XXH3_128, "xxh3",    16, 1 },
+#else
+    { DIGEST_ALGO_XXH3_128, "xxh3",    16, 0 },
+#endif
+};
+
+struct DigestCtx {
+    DigestAlgo algo;
+    union {
+        EVP_MD_CTX *evp;
+#ifdef HAVE_BLAKE3
+        blake3_hasher *blake3;
+#endif
+#ifdef HAVE_XXHASH
+        XXH3_state_t *xxh3;
+#endif
+    } u;
+};
+
+const DigestEngine* digest_engine_get(DigestAlgo algo) {
+    if ((int)algo < 0 || algo >= DIGEST_ALGO_COUNT) return NULL;
+    return &engines[algo];
+}
+
+const DigestEngine* digest_engine_by_name(const char *name) {
+    if (!name) return NULL;
+    for (int i = 0; i < DIGEST_ALGO_COUNT; i++) {
+        if (strcmp(engines[i].name, name) == 0) {
+            return &engines[i];
+        }
+    }
+    // 兼容常见别名
+    if (strcmp(name, "xxh3-128") == 0 || strcmp(name, "xxh128") == 0) {
+        return &engines[DIGEST_ALGO_XXH3_128];
+    }
+    return NULL;
+}
+
+// 列出当前构建可用的引擎，用于帮助与错误信息
+void digest_list_engines(char *buf, size_t size) {
+    if (!buf || size == 0) return;
+    buf[0] = '\0';
+    for (int i = 0; i < DIGEST_ALGO_COUNT; i++) {
+        if (!engines[i].available) continue;
+        if (buf[0]) strncat(buf, "/", size - strlen(buf) - 1);
+        strncat(buf, engines[i].name, size - strlen(buf) - 1);
+    }
+}
+
+static const EVP_MD* digest_evp_md(DigestAlgo algo) {
+    switch (algo) {
+        case DIGEST_ALGO_SHA256:  return EVP_sha256();
+        default:                  return NULL;
+    }
+}
+
+DigestCtx* digest_ctx_new(DigestAlgo algo) {
+    const DigestEngine *engine = digest_engine_get(algo);
+    if (!engine || !engine->available) {
+        log_msg(LOG_ERROR, "不支持的摘要算法: %d", (int)algo);
+        return NULL;
+    }
+
+    DigestCtx *ctx = malloc(sizeof(DigestCtx));
+    if (!ctx) return NULL;
+    ctx->algo = algo;
+
+    switch (algo) {
+        case DIGEST_ALGO_SHA256:
+            ctx->u.evp = EVP_MD_CTX_new();
+            if (!ctx->u.evp) {
+                free(ctx);
+                return NULL;
+            }
+            break;
+#ifdef HAVE_BLAKE3
+        case DIGEST_ALGO_BLAKE3:
+            ctx->u.blake3 = malloc(sizeof(blake3_hasher));
+            if (!ctx->u.blake3) {
+                free(ctx);
+                return NULL;
+            }
+            break;
+#endif
+#ifdef HAVE_XXHASH
+        case DIGEST_ALGO_XXH3_128:
+            ctx->u.xxh3 = XXH3_createState();
+            if (!ctx->u.xxh3) {
+                free(ctx);
+                return NULL;
+            }
+            break;
+#endif
+        default:
+            free(ctx);
+            return NULL;
+    }
+
+    return ctx;
+}
+
+// 开始新的摘要计算 (上下文可重复使用)
+int digest_init(DigestCtx *ctx) {
+    if (!ctx) return -1;
+
+    switch (ctx->algo) {
+        case DIGEST_ALGO_SHA256:
+            if (EVP_DigestInit_ex(ctx->u.evp, digest_evp_md(ctx->algo), NULL) != 1) {
+                log_msg(LOG_ERROR, "EVP_DigestInit_ex failed");
+                return -1;
+            }
+            return 0;
+#ifdef HAVE_BLAKE3
+        case DIGEST_ALGO_BLAKE3:
+            blake3_hasher_init(ctx->u.blake3);
+            return 0;
+#endif
+#ifdef HAVE_XXHASH
+        case DIGEST_ALGO_XXH3_128:
+            return XXH3_128bits_reset(ctx->u.xxh3) == XXH_OK ? 0 : -1;
+#endif
+        default:
+            return -1;
+    }
+}
+
+int digest_update(DigestCtx *ctx, const void *data, size_t len) {
+    if (!ctx) return -1;
+
+    switch (ctx->algo) {
+        case DIGEST_ALGO_SHA256:
+            if (EVP_DigestUpdate(ctx->u.evp, data, len) != 1) {
+                log_msg(LOG_ERROR, "EVP_DigestUpdate failed");
+                return -1;
+            }
+            return 0;
+#ifdef HAVE_BLAKE3
+        case DIGEST_ALGO_BLAKE3:
+            blake3_hasher_update(ctx->u.blake3, data, len);
+            return 0;
+#endif
+#ifdef HAVE_XXHASH
+        case DIGEST_ALGO_XXH3_128:
+            return XXH3_128bits_update(ctx->u.xxh3, data, len) == XXH_OK ? 0 : -1;
+#endif
+        default:
+            return -1;
+    }
+}
+
+// 输出 digest_engine_get(algo)->digest_len 字节
+int digest_final(DigestCtx *ctx, unsigned char *out) {
+    if (!ctx || !out) return -1;
+
+    switch (ctx->algo) {
+        case DIGEST_ALGO_SHA256:
+            if (EVP_DigestFinal_ex(ctx->u.evp, out, NULL) != 1) {
+                log_msg(LOG_ERROR, "EVP_DigestFinal_ex failed");
+                return -1;
+            }
+            return 0;
+#ifdef HAVE_BLAKE3
+        case DIGEST_ALGO_BLAKE3:
+            blake3_hasher_finalize(ctx->u.blake3, out, BLAKE3_OUT_LEN);
+            return 0;
+#endif
+#ifdef HAVE_XXHASH
+        case DIGEST_ALGO_XXH3_128: {
+            XXH128_canonical_t canonical;
+            XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(ctx->u.xxh3));
+            memcpy(out, canonical.digest, sizeof(canonical.digest));
+            return 0;
+        }
+#endif
+        default:
+            return -1;
+    }
+}
+
+void digest_ctx_free(DigestCtx *ctx) {
+    if (!ctx) return;
+
+    switch (ctx->algo) {
+        case DIGEST_ALGO_SHA256:
+            EVP_MD_CTX_free(ctx->u.evp);
+            break;
+#ifdef HAVE_BLAKE3
+        case DIGEST_ALGO_BLAKE3:
+            free(ctx->u.blake3);
+            break;
+#endif
+#ifdef HAVE_XXHASH
+        case DIGEST_ALGO_XXH3_128:
+            XXH3_freeState(ctx->u.xxh3);
+            break;
+#endif
+        default:
+            break;
+    }
+    free(ctx);
+}
+
+#if defined(__SSE2__)
+// 0-15 的半字节转为 '0'-'9'/'a'-'f'
+static inline __m128i nibbles_to_hex(__m128i v) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(v, _mm_set1_epi8('0')), letters);
+}
+
+// 16 个十六进制字符转为半字节值，含非法字符时返回 -1
+static inline int hex_to_nibbles(__m128i v, __m128i *out) {
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20)); // 大写字母转小写
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xFFFF) return -1;
+
+    *out = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+                        _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    return 0;
+}
+#endif
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 二进制转十六进制 (SSE2 每次 16 字节，剩余部分逐字节)
+void digest_to_hex(const unsigned char *digest, size_t len, char *hex) {
+    static const char digits[] = "0123456789abcdef";
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= len; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(digest + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask);
+        __m128i lo = _mm_and_si128(in, mask);
+        _mm_storeu_si128((__m128i *)(hex + i * 2), nibbles_to_hex(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i *)(hex + i * 2 + 16), nibbles_to_hex(_mm_unpackhi_epi8(hi, lo)));
+    }
+#endif
+    for (; i < len; i++) {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[len * 2] = '\0';
+}
+
+// 十六进制转二进制，len 为输出字节数 (读取 2*len 个字符)；含非法字符返回 -1
+int digest_from_hex(const char *hex, size_t len, unsigned char *out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i low_byte = _mm_set1_epi16(0x00ff);
+    for (; i + 16 <= len; i += 16) {
+        __m128i a, b;
+        if (hex_to_nibbles(_mm_loadu_si128((const __m128i *)(hex + i * 2)), &a) != 0 ||
+            hex_to_nibbles(_mm_loadu_si128((const __m128i *)(hex + i * 2 + 16)), &b) != 0) {
+            return -1;
+        }
+        // 每个 16 位通道: 低字节为高半字节，高字节为低半字节
+        a = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(a, low_byte), 4), _mm_srli_epi16(a, 8));
+        b = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(b, low_byte), 4), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < len; i++) {
+        int hi = hex_value(hex[i * 2]);
+        int lo = hi < 0 ? -1 : hex_value(hex[i * 2 + 1]);
+        if (lo < 0) return -1;
+        out[i] = (unsigned char)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+void digest_set(Digest *digest, const unsigned char *bytes, size_t len, size_t tree_block_size) {
+    memset(digest, 0, sizeof(Digest));
+    if (len > MAX_DIGEST_LENGTH) len = MAX_DIGEST_LENGTH;
+    memcpy(digest->bytes, bytes, len);
+    digest->len = (unsigned char)len;
+    digest->tree_block_size = tree_block_size;
+}
+
+// 输出清单中的哈希字段: <hex> 或 tree-<算法>:<块大小>:<hex>
+int digest_format(const Digest *digest, DigestAlgo algo, char *out, size_t size) {
+    const DigestEngine *engine = digest_engine_get(algo);
+    if (!digest || !engine || !out || size < (size_t)digest->len * 2 + 1) return -1;
+
+    if (digest->tree_block_size == 0) {
+        digest_to_hex(digest->bytes, digest->len, out);
+        return 0;
+    }
+
+    char hex[MAX_DIGEST_LENGTH * 2 + 1];
+    digest_to_hex(digest->bytes, digest->len, hex);
+    int n = snprintf(out, size, "%s%s:%zu:%s", TREE_HASH_PREFIX, engine->name, digest->tree_block_size, hex);
+    return n < 0 || (size_t)n >= size ? -1 : 0;
+}
+
+// 解析清单中的哈希字段；长度必须与 algo 的摘要长度一致
+int digest_parse(const char *str, size_t len, DigestAlgo algo, Digest *digest) {
+    const DigestEngine *engine = digest_engine_get(algo);
+    if (!str || !digest || !engine) return -1;
+
+    size_t tree_block_size = 0;
+    size_t prefix_len = strlen(TREE_HASH_PREFIX);
+    if (len > prefix_len && memcmp(str, TREE_HASH_PREFIX, prefix_len) == 0) {
+        const char *name = str + prefix_len;
+        const char *end = str + len;
+        const char *colon = memchr(name, ':', (size_t)(end - name));
+        if (!colon || colon - name >= 32) return -1;
+
+        char algo_name[32];
+        memcpy(algo_name, name, colon - name);
+        algo_name[colon - name] = '\0';
+        const DigestEngine *tree_engine = digest_engine_by_name(algo_name);
+        if (!tree_engine || tree_engine->algo != algo) return -1; // 树哈希算法须与清单头一致
+
+        // 块大小 (十进制，最多 19 位以免溢出)
+        const char *p = colon + 1;
+        unsigned long long block_size = 0;
+        while (p < end && *p >= '0' && *p <= '9' && p - colon <= 19) {
+            block_size = block_size * 10 + (unsigned)(*p - '0');
+            p++;
+        }
+        if (p == colon + 1 || p >= end || *p != ':' || block_size == 0) return -1;
+        tree_block_size = (size_t)block_size;
+        len -= (size_t)(p + 1 - str);
+        str = p + 1;
+    }
+
+    if (len != engine->digest_len * 2) return -1;
+
+    memset(digest, 0, sizeof(Digest));
+    if (digest_from_hex(str, engine->digest_len, digest->bytes) != 0) return -1;
+    digest->len = (unsigned char)engine->digest_len;
+    digest->tree_block_size = tree_block_size;
+    return 0;
+}
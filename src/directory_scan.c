@@ -1,141 +1,998 @@
+#define _GNU_SOURCE // syscall
 #include "directory_scan.h"
 #include "config.h"
 #include "logging.h"
 #include "path_utils.h"
 #include "file_utils.h"
+#include "thread_pool.h"
+#include "sha256_mb.h"
+#include "hash_cache.h"
+#include "journal.h"
+#include "dispatch.h"
+#include "progress.h"
+#include "ignore.h"
+#include "inode_set.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <sched.h>
+#include <sys/syscall.h>
 
 extern Config config;
+extern Statistics stats;
 extern volatile sig_atomic_t g_interrupted;
 
-// 递归扫描目录
-int scan_directory(const char *dir_path, FileList *list) {
-    if (!dir_path || !list) {
-        log_msg(LOG_ERROR, "扫描目录参数错误");
+// 本轮扫描 (到 scan_wait 为止) 见过的文件 inode：硬链接与符号链接指向的同一文件只读取一次
+static InodeSet *g_inodes = NULL;
+static size_t shared_files = 0;    // 复用已有摘要的路径数
+static size_t shared_bytes = 0;
+
+// 哈希任务：由工作线程计算哈希并加入列表
+typedef struct {
+    char *path;        // 用于读取的路径
+    char *rel_path;    // 记录到列表中的相对路径
+    struct stat sb;    // 扫描时的文件状态 (哈希缓存的键)
+    FileList *list;
+    int source;        // 所属源目录的序号 (续传日志的键)
+    InodeEntry *inode; // 非 NULL 时完成后把摘要发布给同一 inode 的其他路径
+} HashJob;
+
+// 文件哈希完成 (含失败与缓存命中)：更新流水线进度，每 256 个文件刷新一次进度条
+static void scan_files_done(size_t count, size_t bytes) {
+    __atomic_add_fetch(&stats.hashed_bytes, bytes, __ATOMIC_RELAXED);
+    size_t before = __atomic_fetch_add(&stats.hashed_files, count, __ATOMIC_RELAXED);
+    if (config.progress && (before / 256 != (before + count) / 256)) {
+        update_scan_progress(0);
+    }
+}
+
+// 摘要已得出：写入块摘要文件 (树哈希)、加入列表并记入续传日志
+static void scan_add_file(FileList *list, int source, const char *rel_path, const Digest *digest,
+                          const unsigned char *blocks, size_t block_count, const struct stat *sb) {
+    if (blocks) {
+        block_log_append(rel_path, blocks, block_count, digest_engine_get(config.digest_algo)->digest_len);
+    }
+    add_file_to_list(list, rel_path, digest, sb->st_size, sb->st_mtime);
+    journal_record_file(source, rel_path, digest, blocks, block_count, sb);
+}
+
+// 同一 inode 的另一条路径：复用首个路径的摘要 (含树哈希的块摘要)，首个路径失败时同样跳过
+static void inode_add_name(FileList *list, int source, const char *rel_path, const InodeEntry *inode,
+                           const struct stat *sb) {
+    if (inode->state == INODE_READY && !g_interrupted) {
+        scan_add_file(list, source, rel_path, &inode->digest, inode->blocks, inode->block_count, sb);
+        __atomic_add_fetch(&shared_files, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&shared_bytes, sb->st_size, __ATOMIC_RELAXED);
+    }
+    scan_files_done(1, sb->st_size);
+}
+
+// 首个路径哈希结束 (digest 为 NULL 表示失败)：发布结果，期间排队的其他路径一并加入列表
+static void inode_publish(InodeEntry *inode, const Digest *digest, unsigned char *blocks,
+                          size_t block_count, const struct stat *sb) {
+    InodeWaiter *waiter = inode_set_publish(g_inodes, inode, digest, blocks, block_count);
+    while (waiter) {
+        InodeWaiter *next = waiter->next;
+        inode_add_name(waiter->list, waiter->source, waiter->rel_path, inode, sb);
+        free(waiter);
+        waiter = next;
+    }
+}
+
+// 哈希结束 (digest 为 NULL 表示失败)：加入列表，发布给同一 inode 的其他路径，释放任务
+static void hash_job_finish(HashJob *job, const Digest *digest, unsigned char *digests, size_t count) {
+    if (digest) {
+        if (!digests) hash_cache_store(&job->sb, config.digest_algo, digest);
+        scan_add_file(job->list, job->source, job->rel_path, digest, digests, count, &job->sb);
+    }
+    scan_files_done(1, job->sb.st_size);
+    if (job->inode) {
+        inode_publish(job->inode, digest, digests, count, &job->sb);
+    } else {
+        free(digests);
+    }
+
+    free(job->path);
+    free(job->rel_path);
+    free(job);
+}
+
+static void hash_job_run(void *arg) {
+    HashJob *job = (HashJob *)arg;
+    Digest digest;
+    unsigned char *digests = NULL;
+    size_t count = 0;
+    int ok;
+
+    if (config.tree_hash && (size_t)job->sb.st_size > config.tree_block_size) {
+        // 大文件：分块并行计算树哈希，并记录块摘要
+        ok = !g_interrupted &&
+             compute_tree_hash(job->path, config.digest_algo, config.tree_block_size,
+                               &digest, &digests, &count) == 0;
+    } else {
+        ok = !g_interrupted && compute_file_hash(job->path, config.digest_algo, &digest) == 0;
+    }
+    hash_job_finish(job, ok ? &digest : NULL, digests, count);
+}
+
+// worker 返回的结果 (在协调器线程中调用)
+static void hash_job_remote_done(void *arg, const Digest *digest) {
+    hash_job_finish((HashJob *)arg, g_interrupted ? NULL : digest, NULL, 0);
+}
+
+// 小文件批量任务：一次读入一批小文件，用多缓冲 SHA-256 同时计算，
+// 省去逐文件创建摘要上下文和逐次加锁更新统计的开销
+typedef struct {
+    size_t count;
+    char *paths[SMALL_FILE_BATCH];
+    char *rel_paths[SMALL_FILE_BATCH];
+    struct stat sbs[SMALL_FILE_BATCH];
+    InodeEntry *inodes[SMALL_FILE_BATCH];
+    FileList *list;
+    int source;
+} SmallFileBatch;
+
+// 待遍历的目录：rel_dir 为相对扫描根目录的路径 (根目录为空串)；
+// fd 为父目录遍历时用 openat 打开的目录描述符，超出预算时为 -1，取出后相对根目录打开；
+// ignore 为父目录生效的忽略规则 (引用)，遍历时叠加本目录的忽略文件；
+// follow 表示经目录符号链接进入，打开时跟随最后一级，dev/ino 为链接指向的目录
+typedef struct {
+    int fd;
+    char *rel_dir;
+    IgnoreRules *ignore;
+    int follow;
+    uint64_t dev;
+    uint64_t ino;
+} ScanDir;
+
+// 每个遍历线程一个双端队列：本线程从尾部压入/弹出 (深度优先，局部性好)，
+// 空闲线程从头部窃取 (通常是较浅、子树较大的目录)
+typedef struct {
+    ScanDir **items;               // 环形缓冲区
+    size_t capacity;
+    size_t head;
+    size_t count;
+    pthread_mutex_t lock;
+} ScanDeque;
+
+// getdents64 返回的目录项 (glibc 未导出此结构)
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+struct ScanState;
+
+typedef struct {
+    struct ScanState *scan;
+    ScanDeque deque;
+    SmallFileBatch *pending_batch; // 本线程正在填充的小文件批次
+    IgnoreRules *ignore;           // 正在遍历的目录生效的忽略规则
+    unsigned int seed;             // 选择窃取对象
+    pthread_t thread;
+    char path[MAX_PATH];           // 逐级拼接的完整路径，相对路径是其后缀
+    char dirents[SCAN_DIRENT_BUFFER] __attribute__((aligned(8)));
+} ScanWorker;
+
+// 一次 scan_directory 调用的共享状态
+typedef struct ScanState {
+    FileList *list;
+    int source;                    // 源目录序号，随条目记入续传日志
+    int root_fd;
+    char root[MAX_PATH];           // 规范化的根目录，含末尾分隔符 (根目录为 "." 时为空串)
+    size_t root_len;
+    size_t held_fds;               // 队列中持有的目录描述符数
+    ScanWorker *workers;
+    int worker_count;
+    size_t outstanding;            // 已入队但尚未处理完的目录数，归零即遍历结束
+    size_t queued;                 // 仍在队列中等待的目录数
+    int sleepers;
+    int failed;                    // 有目录无法打开，终止遍历
+    int metadata_only;             // 只记录路径与元数据，不读取文件内容
+    InodeSet *dirs;                // 跟随符号链接时已遍历的目录 (防环)
+    ScanDir **deferred;            // 待跟随的目录符号链接，本轮遍历结束后按路径顺序处理
+    size_t deferred_count;
+    size_t deferred_capacity;
+    pthread_mutex_t deferred_lock;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t work_available;
+} ScanState;
+
+// 读取整个小文件；文件已变为大文件或非普通文件时返回 1，由调用方走普通路径
+static int read_small_file(const char *path, unsigned char *buf, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        log_msg(LOG_WARN, "无法打开文件 '%s': %s", path, strerror(errno));
         return -1;
     }
 
-    char full_path[MAX_PATH];
-    DIR *dir;
-    struct dirent *entry;
     struct stat sb;
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size > SMALL_FILE_MAX) {
+        close(fd);
+        return 1;
+    }
 
-    // 规范化目录路径
-    char *norm_dir_path = normalize_path(dir_path);
-    if (!norm_dir_path) {
-        log_msg(LOG_ERROR, "路径规范化失败: %s", dir_path);
+    // 多读一个字节以发现扫描后增长的文件
+    size_t total = 0;
+    while (total <= SMALL_FILE_MAX) {
+        ssize_t n = read(fd, buf + total, SMALL_FILE_MAX + 1 - total);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg(LOG_ERROR, "读取文件 '%s' 失败: %s", path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        if (n == 0) break;
+        total += n;
+    }
+    drop_file_cache(fd, 0, 0);
+    close(fd);
+
+    if (total > SMALL_FILE_MAX) return 1;
+    *len = total;
+    return 0;
+}
+
+static void small_batch_run(void *arg) {
+    SmallFileBatch *batch = (SmallFileBatch *)arg;
+    unsigned char *data = malloc((size_t)SMALL_FILE_BATCH * (SMALL_FILE_MAX + 1));
+    Sha256MbJob jobs[SMALL_FILE_BATCH];
+    Digest digests[SMALL_FILE_BATCH];
+    int ok[SMALL_FILE_BATCH];
+    unsigned char out[SMALL_FILE_BATCH][SHA256_MB_DIGEST_LENGTH];
+    size_t job_count = 0;
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < batch->count; i++) {
+        ok[i] = 0;
+        if (g_interrupted) continue;
+
+        unsigned char *buf = data ? data + i * (SMALL_FILE_MAX + 1) : NULL;
+        size_t len = 0;
+        int ret = buf ? read_small_file(batch->paths[i], buf, &len) : 1;
+        if (ret == 1) {
+            // 内存不足或文件已变化：逐个计算
+            ok[i] = compute_file_hash(batch->paths[i], DIGEST_ALGO_SHA256, &digests[i]) == 0;
+        } else if (ret == 0) {
+            jobs[job_count].data = buf;
+            jobs[job_count].len = len;
+            jobs[job_count].out = out[i];
+            job_count++;
+            bytes += len;
+            ok[i] = 2;
+        }
+    }
+
+    sha256_mb_hash(jobs, job_count);
+
+    for (size_t i = 0; i < batch->count; i++) {
+        if (ok[i] == 2) digest_set(&digests[i], out[i], SHA256_MB_DIGEST_LENGTH, 0);
+        int done = ok[i] && !g_interrupted;
+        if (done) {
+            hash_cache_store(&batch->sbs[i], DIGEST_ALGO_SHA256, &digests[i]);
+            scan_add_file(batch->list, batch->source, batch->rel_paths[i], &digests[i], NULL, 0, &batch->sbs[i]);
+        }
+        if (batch->inodes[i]) {
+            inode_publish(batch->inodes[i], done ? &digests[i] : NULL, NULL, 0, &batch->sbs[i]);
+        }
+        free(batch->paths[i]);
+        free(batch->rel_paths[i]);
+    }
+
+    pthread_mutex_lock(&stats.lock);
+    stats.bytes_processed += bytes;
+    pthread_mutex_unlock(&stats.lock);
+
+    size_t batch_bytes = 0;
+    for (size_t i = 0; i < batch->count; i++) batch_bytes += batch->sbs[i].st_size;
+    scan_files_done(batch->count, batch_bytes);
+
+    free(data);
+    free(batch);
+}
+
+// 提交遍历线程当前的批次
+static void flush_small_batch(ScanWorker *worker) {
+    SmallFileBatch *batch = worker->pending_batch;
+    worker->pending_batch = NULL;
+    if (!batch || batch->count == 0) {
+        free(batch);
+        return;
+    }
+    if (!g_hash_pool || thread_pool_submit(g_hash_pool, small_batch_run, batch) != 0) {
+        small_batch_run(batch);
+    }
+}
+
+// 小文件加入批次，批次满时提交；失败时返回 -1 由调用方单独提交
+static int add_small_file(ScanWorker *worker, const char *path, const char *rel_path,
+                          const struct stat *sb, InodeEntry *inode) {
+    SmallFileBatch *batch = worker->pending_batch;
+    if (!batch) {
+        batch = calloc(1, sizeof(SmallFileBatch));
+        if (!batch) return -1;
+        batch->list = worker->scan->list;
+        batch->source = worker->scan->source;
+        worker->pending_batch = batch;
+    }
+
+    size_t i = batch->count;
+    batch->paths[i] = strdup(path);
+    batch->rel_paths[i] = strdup(rel_path);
+    if (!batch->paths[i] || !batch->rel_paths[i]) {
+        free(batch->paths[i]);
+        free(batch->rel_paths[i]);
         return -1;
     }
+    batch->sbs[i] = *sb;
+    batch->inodes[i] = inode;
+    batch->count++;
 
-    if (!(dir = opendir(norm_dir_path))) {
-        log_msg(LOG_WARN, "无法打开目录 '%s': %s", norm_dir_path, strerror(errno));
-        free(norm_dir_path);  // 释放内存
+    if (batch->count == SMALL_FILE_BATCH) {
+        flush_small_batch(worker);
+    }
+    return 0;
+}
+
+// 将文件交给哈希工作池 (分布式生成时交给协调器)；未创建工作池时在当前线程计算
+// 续传日志或哈希缓存命中时直接加入列表，不读取文件
+// 硬链接 (st_nlink > 1) 与符号链接目标按 inode 登记，同一文件只读取一次，其余路径复用摘要；
+// 跟随符号链接时所有普通文件都登记，无论文件本身与指向它的链接哪个先被扫描到
+static void submit_hash_job(ScanWorker *worker, const char *path, const char *rel_path,
+                            const struct stat *sb, int via_symlink) {
+    FileList *list = worker->scan->list;
+    int source = worker->scan->source;
+    if (worker->scan->metadata_only) {
+        static const Digest no_digest;
+        add_file_to_list(list, rel_path, &no_digest, sb->st_size, sb->st_mtime);
+        return;
+    }
+    __atomic_add_fetch(&stats.scanned_files, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.scanned_bytes, sb->st_size, __ATOMIC_RELAXED);
+
+    InodeEntry *inode = NULL;
+    if (g_inodes && (sb->st_nlink > 1 || via_symlink || config.follow_symlinks)) {
+        switch (inode_set_claim(g_inodes, sb, list, source, rel_path, 1, &inode)) {
+        case INODE_CLAIM_DONE:
+            inode_add_name(list, source, rel_path, inode, sb);
+            return;
+        case INODE_CLAIM_PENDING:
+            return;
+        default:
+            break;
+        }
+    }
+
+    // 续传：上次运行已完成且未变化的文件 (含树哈希的块摘要) 直接复用，日志中已有记录
+    Digest cached;
+    unsigned char *blocks;
+    size_t block_count;
+    if (journal_lookup(source, rel_path, sb, &cached, &blocks, &block_count)) {
+        if (blocks) {
+            block_log_append(rel_path, blocks, block_count, digest_engine_get(config.digest_algo)->digest_len);
+        }
+        add_file_to_list(list, rel_path, &cached, sb->st_size, sb->st_mtime);
+        scan_files_done(1, sb->st_size);
+        if (inode) {
+            inode_publish(inode, &cached, blocks, block_count, sb);
+        } else {
+            free(blocks);
+        }
+        return;
+    }
+
+    int tree = config.tree_hash && (size_t)sb->st_size > config.tree_block_size;
+    if (!tree && hash_cache_lookup(sb, config.digest_algo, &cached)) {
+        scan_add_file(list, source, rel_path, &cached, NULL, 0, sb);
+        scan_files_done(1, sb->st_size);
+        if (inode) inode_publish(inode, &cached, NULL, 0, sb);
+        return;
+    }
+
+    // 小文件批量路径用普通 read()，指定了 O_DIRECT 或 io_uring 时改走配置的读取路径
+    if (config.digest_algo == DIGEST_ALGO_SHA256 && (size_t)sb->st_size <= SMALL_FILE_MAX && !dispatch_active() &&
+        config.cache_mode != CACHE_MODE_DIRECT && config.io_engine == IO_ENGINE_SYNC &&
+        add_small_file(worker, path, rel_path, sb, inode) == 0) {
+        return;
+    }
+
+    HashJob *job = malloc(sizeof(HashJob));
+    if (!job) {
+        log_msg(LOG_ERROR, "内存分配失败: 哈希任务");
+        scan_files_done(1, sb->st_size);
+        if (inode) inode_publish(inode, NULL, NULL, 0, sb);
+        return;
+    }
+
+    job->path = strdup(path);
+    job->rel_path = strdup(rel_path);
+    if (!job->path || !job->rel_path) {
+        free(job->path);
+        free(job->rel_path);
+        free(job);
+        log_msg(LOG_ERROR, "内存分配失败: 哈希任务");
+        scan_files_done(1, sb->st_size);
+        if (inode) inode_publish(inode, NULL, NULL, 0, sb);
+        return;
+    }
+    job->sb = *sb;
+    job->list = list;
+    job->source = source;
+    job->inode = inode;
+
+    // 分布式生成：交给协调器分发给 worker 进程，队列内存不足时退回本地计算
+    if (dispatch_active() && dispatch_submit(job->path, job->sb.st_size, hash_job_remote_done, job) == 0) {
+        return;
+    }
+    if (!g_hash_pool || thread_pool_submit(g_hash_pool, hash_job_run, job) != 0) {
+        hash_job_run(job);
+    }
+}
+
+static void scan_dir_free(ScanState *scan, ScanDir *dir) {
+    if (!dir) return;
+    if (dir->fd != -1) {
+        close(dir->fd);
+        __atomic_sub_fetch(&scan->held_fds, 1, __ATOMIC_RELAXED);
+    }
+    ignore_rules_release(dir->ignore);
+    free(dir->rel_dir);
+    free(dir);
+}
+
+static int scan_deque_push(ScanDeque *deque, ScanDir *dir) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        size_t new_capacity = deque->capacity ? deque->capacity * 2 : 64;
+        ScanDir **items = malloc(new_capacity * sizeof(ScanDir *));
+        if (!items) {
+            pthread_mutex_unlock(&deque->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < deque->count; i++) {
+            items[i] = deque->items[(deque->head + i) % deque->capacity];
+        }
+        free(deque->items);
+        deque->items = items;
+        deque->capacity = new_capacity;
+        deque->head = 0;
+    }
+    deque->items[(deque->head + deque->count) % deque->capacity] = dir;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+// 本线程从尾部取
+static ScanDir* scan_deque_pop(ScanDeque *deque) {
+    ScanDir *dir = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        dir = deque->items[(deque->head + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return dir;
+}
+
+// 其他线程从头部窃取
+static ScanDir* scan_deque_steal(ScanDeque *deque) {
+    ScanDir *dir = NULL;
+    if (pthread_mutex_trylock(&deque->lock) != 0) return NULL;
+    if (deque->count > 0) {
+        dir = deque->items[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return dir;
+}
+
+static ScanDir* scan_dir_new(ScanWorker *worker, const char *rel_dir) {
+    ScanDir *dir = calloc(1, sizeof(ScanDir));
+    if (!dir) return NULL;
+    dir->fd = -1;
+    dir->rel_dir = strdup(rel_dir);
+    if (!dir->rel_dir) {
+        free(dir);
+        return NULL;
+    }
+    dir->ignore = ignore_rules_ref(worker->ignore);
+    return dir;
+}
+
+// 目录压入 worker 的队列；成功后计入 outstanding，并唤醒空闲线程；失败时由调用方释放
+static int scan_push(ScanWorker *worker, ScanDir *dir) {
+    ScanState *scan = worker->scan;
+
+    // 先计数再入队，保证取出方看到的计数不小于实际数量
+    __atomic_add_fetch(&scan->outstanding, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&scan->idle_lock);
+    scan->queued++;
+    pthread_mutex_unlock(&scan->idle_lock);
+
+    if (scan_deque_push(&worker->deque, dir) != 0) {
+        pthread_mutex_lock(&scan->idle_lock);
+        scan->queued--;
+        pthread_mutex_unlock(&scan->idle_lock);
+        __atomic_sub_fetch(&scan->outstanding, 1, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+
+    pthread_mutex_lock(&scan->idle_lock);
+    if (scan->sleepers > 0) {
+        pthread_cond_signal(&scan->work_available);
+    }
+    pthread_mutex_unlock(&scan->idle_lock);
+    return 0;
+}
+
+// 子目录入队；预算内在父目录下 openat 子目录并随任务保存，取出时无需再按路径查找
+static int scan_enqueue(ScanWorker *worker, int parent_fd, const char *name, const char *rel_dir) {
+    ScanState *scan = worker->scan;
+    ScanDir *dir = scan_dir_new(worker, rel_dir);
+    if (!dir) return -1;
+    if (parent_fd != -1 &&
+        __atomic_add_fetch(&scan->held_fds, 1, __ATOMIC_RELAXED) <= SCAN_FD_BUDGET) {
+        dir->fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (dir->fd == -1) __atomic_sub_fetch(&scan->held_fds, 1, __ATOMIC_RELAXED);
+    } else if (parent_fd != -1) {
+        __atomic_sub_fetch(&scan->held_fds, 1, __ATOMIC_RELAXED);
+    }
+    if (scan_push(worker, dir) != 0) {
+        scan_dir_free(scan, dir);
         return -1;
     }
+    return 0;
+}
+
+// 目录符号链接暂不进入：本轮遍历结束、真实目录都已登记后再按路径顺序跟随，
+// 目标已遍历 (含指向祖先形成的环) 时跳过，结果与遍历线程的调度无关
+static int scan_defer(ScanWorker *worker, const char *rel_path, const struct stat *sb) {
+    ScanState *scan = worker->scan;
+    ScanDir *dir = scan_dir_new(worker, rel_path);
+    if (!dir) return -1;
+    dir->follow = 1;
+    dir->dev = (uint64_t)sb->st_dev;
+    dir->ino = (uint64_t)sb->st_ino;
 
-    while ((entry = readdir(dir)) != NULL) {
-        // 检查中断
-        if (g_interrupted) {
-            closedir(dir);
-            free(norm_dir_path);  // 释放内存
+    pthread_mutex_lock(&scan->deferred_lock);
+    if (scan->deferred_count == scan->deferred_capacity) {
+        size_t new_capacity = scan->deferred_capacity ? scan->deferred_capacity * 2 : 16;
+        ScanDir **grown = realloc(scan->deferred, new_capacity * sizeof(ScanDir *));
+        if (!grown) {
+            pthread_mutex_unlock(&scan->deferred_lock);
+            scan_dir_free(scan, dir);
             return -1;
         }
+        scan->deferred = grown;
+        scan->deferred_capacity = new_capacity;
+    }
+    scan->deferred[scan->deferred_count++] = dir;
+    pthread_mutex_unlock(&scan->deferred_lock);
+    return 0;
+}
 
-        // 跳过 . 和 ..
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+static int compare_scan_dirs(const void *a, const void *b) {
+    return strcmp((*(ScanDir * const *)a)->rel_dir, (*(ScanDir * const *)b)->rel_dir);
+}
+
+// 跟随本轮登记的目录符号链接，返回入队的目录数 (遍历线程均已退出)
+static size_t scan_follow_deferred(ScanState *scan) {
+    ScanDir **deferred = scan->deferred;
+    size_t count = scan->deferred_count;
+    scan->deferred = NULL;
+    scan->deferred_count = 0;
+    scan->deferred_capacity = 0;
+    if (count > 1) qsort(deferred, count, sizeof(ScanDir *), compare_scan_dirs);
+
+    size_t queued = 0;
+    for (size_t i = 0; i < count; i++) {
+        ScanDir *dir = deferred[i];
+        int added = inode_set_add_dir(scan->dirs, dir->dev, dir->ino);
+        if (added == 1 && scan_push(&scan->workers[0], dir) == 0) {
+            queued++;
             continue;
         }
+        // added == 0: 目标目录已经遍历过，直接丢弃
+        if (added != 0) {
+            log_msg(LOG_ERROR, "内存分配失败: 目录队列");
+            scan->failed = 1;
+        }
+        scan_dir_free(scan, dir);
+    }
+    free(deferred);
+    return queued;
+}
 
-        // 构建完整路径
-        snprintf(full_path, sizeof(full_path), "%s/%s", norm_dir_path, entry->d_name);
+// 取下一个目录：先取本线程队列，再从其他线程窃取，都没有时休眠等待；
+// 遍历结束或终止时返回 NULL
+static ScanDir* scan_next_dir(ScanWorker *worker) {
+    ScanState *scan = worker->scan;
 
-        // 规范化路径
-        char *norm_path = normalize_path(full_path);
-        if (!norm_path) {
-            continue;
+    for (;;) {
+        ScanDir *dir = scan_deque_pop(&worker->deque);
+        if (!dir && scan->worker_count > 1) {
+            int start = rand_r(&worker->seed) % scan->worker_count;
+            for (int i = 0; i < scan->worker_count && !dir; i++) {
+                ScanWorker *victim = &scan->workers[(start + i) % scan->worker_count];
+                if (victim != worker) dir = scan_deque_steal(&victim->deque);
+            }
         }
 
-        // 检查路径安全性
-        if (!is_safe_path(norm_path)) {
-            log_msg(LOG_WARN, "不安全路径，跳过: %s", norm_path);
-            free(norm_path);  // 释放内存
+        pthread_mutex_lock(&scan->idle_lock);
+        if (dir) {
+            scan->queued--;
+            pthread_mutex_unlock(&scan->idle_lock);
+            return dir;
+        }
+        // 窃取时对方正持锁，队列里其实还有目录：重试而不休眠
+        if (scan->queued > 0 && !scan->failed && !g_interrupted) {
+            pthread_mutex_unlock(&scan->idle_lock);
+            sched_yield();
             continue;
         }
+        if (__atomic_load_n(&scan->outstanding, __ATOMIC_SEQ_CST) == 0 || scan->failed || g_interrupted) {
+            pthread_cond_broadcast(&scan->work_available);
+            pthread_mutex_unlock(&scan->idle_lock);
+            return NULL;
+        }
+        scan->sleepers++;
+        pthread_cond_wait(&scan->work_available, &scan->idle_lock);
+        scan->sleepers--;
+        pthread_mutex_unlock(&scan->idle_lock);
+    }
+}
 
-        // 检查排除
-        if (should_exclude(norm_path)) {
-            free(norm_path);  // 释放内存
-            continue;
+// 目录处理完毕；最后一个目录完成时唤醒所有空闲线程退出
+static void scan_dir_done(ScanState *scan) {
+    if (__atomic_sub_fetch(&scan->outstanding, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&scan->idle_lock);
+        pthread_cond_broadcast(&scan->work_available);
+        pthread_mutex_unlock(&scan->idle_lock);
+    }
+}
+
+static void scan_fail(ScanState *scan) {
+    pthread_mutex_lock(&scan->idle_lock);
+    scan->failed = 1;
+    pthread_cond_broadcast(&scan->work_available);
+    pthread_mutex_unlock(&scan->idle_lock);
+}
+
+// 条目是否跳过：命令行模式与忽略文件；被跳过的目录不会入队，其子树不再打开
+static int scan_excluded(ScanWorker *worker, const char *rel_path, int is_dir) {
+    if (is_dir ? should_exclude_dir(rel_path) : should_exclude(rel_path)) return 1;
+    return ignore_rules_match(worker->ignore, rel_path, is_dir);
+}
+
+// 按目录项类型分派一个条目；full_path 为完整路径，rel_path 为其相对根目录的后缀
+static int scan_entry(ScanWorker *worker, int dir_fd, const char *name, unsigned char d_type,
+                      const char *full_path, const char *rel_path) {
+    struct stat sb;
+
+    // 模式按相对路径匹配，与验证时清单中的路径一致 (目录项名不含 / 且已跳过 . 和 ..，无需再次规范化)；
+    // 目录只检查隐藏与排除模式，包含模式只作用于文件
+
+    // 符号链接 (不跟随时无需 stat)
+    if (d_type == DT_LNK) {
+        if (!config.follow_symlinks) return 0;
+
+        // 跟随符号链接：fstatat 取目标状态，文件经链接路径直接打开，无需 realpath 逐级解析；
+        // 同一目标经多个链接只哈希一次，目录链接推迟到本轮遍历结束后按 inode 去重进入
+        if (fstatat(dir_fd, name, &sb, 0) == -1) return 0;
+        if (S_ISREG(sb.st_mode)) {
+            if (!scan_excluded(worker, rel_path, 0)) submit_hash_job(worker, full_path, rel_path, &sb, 1);
+        } else if (S_ISDIR(sb.st_mode) && worker->scan->dirs && !scan_excluded(worker, rel_path, 1)) {
+            if (scan_defer(worker, rel_path, &sb) != 0) {
+                log_msg(LOG_ERROR, "内存分配失败: 目录队列");
+                return -1;
+            }
         }
+        return 0;
+    }
 
-        // 获取文件状态
-        if (lstat(norm_path, &sb) == -1) {
-            log_msg(LOG_WARN, "无法获取状态 '%s': %s", norm_path, strerror(errno));
-            free(norm_path);  // 释放内存
-            continue;
+    // 子目录入队，由本线程或空闲线程继续遍历 (d_type 已知时无需 stat)
+    if (d_type == DT_DIR) {
+        if (!config.recursive || scan_excluded(worker, rel_path, 1)) return 0;
+        if (scan_enqueue(worker, dir_fd, name, rel_path) != 0) {
+            log_msg(LOG_ERROR, "内存分配失败: 目录队列");
+            return -1;
+        }
+        return 0;
+    }
+
+    // 普通文件需要大小与时间戳；文件系统不提供 d_type 时也需要 stat 判断类型
+    if (d_type != DT_REG && d_type != DT_UNKNOWN) {
+        return 0;
+    }
+    if (d_type == DT_REG && scan_excluded(worker, rel_path, 0)) {
+        return 0;
+    }
+    if (fstatat(dir_fd, name, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
+        log_msg(LOG_WARN, "无法获取状态 '%s': %s", full_path, strerror(errno));
+        return 0;
+    }
+    if (S_ISREG(sb.st_mode)) {
+        if (d_type == DT_UNKNOWN && scan_excluded(worker, rel_path, 0)) return 0;
+        submit_hash_job(worker, full_path, rel_path, &sb, 0);
+        return 0;
+    }
+    if (d_type == DT_UNKNOWN) {
+        if (S_ISLNK(sb.st_mode)) return scan_entry(worker, dir_fd, name, DT_LNK, full_path, rel_path);
+        if (S_ISDIR(sb.st_mode)) return scan_entry(worker, dir_fd, name, DT_DIR, full_path, rel_path);
+    }
+    return 0;
+}
+
+// 扫描单个目录：用 getdents64 读取目录项，文件交给哈希工作池，子目录压入本线程队列
+static int scan_one_directory(ScanWorker *worker, ScanDir *dir) {
+    ScanState *scan = worker->scan;
+
+    // worker->path = 根目录 + 相对目录 + "/"，之后逐项追加名称
+    size_t rel_len = strlen(dir->rel_dir);
+    if (scan->root_len + rel_len + 1 >= MAX_PATH) {
+        log_msg(LOG_WARN, "路径过长，跳过: %s%s", scan->root, dir->rel_dir);
+        return 0;
+    }
+    memcpy(worker->path, scan->root, scan->root_len);
+    memcpy(worker->path + scan->root_len, dir->rel_dir, rel_len);
+    size_t base_len = scan->root_len + rel_len;
+    if (rel_len > 0) worker->path[base_len++] = '/';
+    worker->path[base_len] = '\0';
+    const char *rel_path = worker->path + scan->root_len;
+
+    int fd = dir->fd;
+    if (fd != -1) {
+        dir->fd = -1;
+        __atomic_sub_fetch(&scan->held_fds, 1, __ATOMIC_RELAXED);
+    } else {
+        fd = openat(scan->root_fd, rel_len > 0 ? dir->rel_dir : ".",
+                    O_RDONLY | O_DIRECTORY | (dir->follow ? 0 : O_NOFOLLOW) | O_CLOEXEC);
+    }
+    if (fd == -1) {
+        log_msg(LOG_WARN, "无法打开目录 '%s': %s", worker->path, strerror(errno));
+        return -1;
+    }
+
+    // 登记真实目录，指向它们的目录链接不再重复进入 (经链接进入的目录在跟随前已登记)
+    if (scan->dirs && !dir->follow) {
+        struct stat dir_sb;
+        if (fstat(fd, &dir_sb) == 0) inode_set_add_dir(scan->dirs, dir_sb.st_dev, dir_sb.st_ino);
+    }
+
+    // 本目录的忽略文件叠加在继承的规则之上，子目录入队时共享引用
+    worker->ignore = config.ignore_files ? ignore_rules_load(dir->ignore, fd, dir->rel_dir) : NULL;
+
+    int result = 0;
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, worker->dirents, sizeof(worker->dirents));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            log_msg(LOG_WARN, "读取目录 '%s' 失败: %s", worker->path, strerror(errno));
+            result = -1;
+            break;
         }
+        if (n == 0) break;
 
-        // 处理符号链接
-        if (S_ISLNK(sb.st_mode)) {
-            if (!config.follow_symlinks) {
-                free(norm_path);  // 释放内存
+        for (long off = 0; off < n; ) {
+            const LinuxDirent64 *entry = (const LinuxDirent64 *)(worker->dirents + off);
+            off += entry->d_reclen;
+
+            // 跳过 . 和 ..
+            const char *name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
                 continue;
             }
 
-            // 跟随符号链接 (防止循环)
-            char target[MAX_PATH];
-            ssize_t len = readlink(norm_path, target, sizeof(target) - 1);
-            if (len != -1) {
-                target[len] = '\0';
-                char resolved[MAX_PATH];
-                if (realpath(target, resolved)) {
-                    struct stat resolved_sb;
-                    if (stat(resolved, &resolved_sb) == 0 && S_ISREG(resolved_sb.st_mode)) {
-                        // 计算哈希并添加到列表
-                        char hash_str[SHA256_DIGEST_LENGTH * 2 + 1];
-                        if (compute_sha256(resolved, hash_str) == 0) {
-                            add_file_to_list(list, resolved, hash_str, resolved_sb.st_size, resolved_sb.st_mtime);
-                        }
-                    }
-                }
+            size_t name_len = strlen(name);
+            if (base_len + name_len >= MAX_PATH) {
+                worker->path[base_len] = '\0';
+                log_msg(LOG_WARN, "路径过长，跳过: %s%s", worker->path, name);
+                continue;
             }
-            free(norm_path);  // 释放内存
-            continue;
-        }
+            memcpy(worker->path + base_len, name, name_len + 1);
 
-        // 递归处理目录
-        if (S_ISDIR(sb.st_mode)) {
-            free(norm_path);  // 释放当前路径内存
-            if (config.recursive) {
-                if (scan_directory(full_path, list) != 0) {  // 使用原始路径
-                    closedir(dir);
-                    free(norm_dir_path);  // 释放内存
-                    return -1;
-                }
+            if (scan_entry(worker, fd, name, entry->d_type, worker->path, rel_path) != 0) {
+                result = -1;
+                break;
             }
-            continue;
         }
 
-        // 仅处理普通文件
-        if (S_ISREG(sb.st_mode)) {
-            // 计算哈希并添加到列表
-            char hash_str[SHA256_DIGEST_LENGTH * 2 + 1];
-            if (compute_sha256(norm_path, hash_str) == 0) {
-                add_file_to_list(list, norm_path, hash_str, sb.st_size, sb.st_mtime);
-            }
+        // 检查中断或其他线程已失败
+        if (result != 0 || g_interrupted || scan->failed) {
+            result = -1;
+            break;
+        }
+    }
+
+    ignore_rules_release(worker->ignore);
+    worker->ignore = NULL;
+    close(fd);
+    return result;
+}
+
+// 遍历线程主循环
+static void* scan_worker_run(void *arg) {
+    ScanWorker *worker = (ScanWorker *)arg;
+    ScanDir *dir;
+
+    while ((dir = scan_next_dir(worker)) != NULL) {
+        if (scan_one_directory(worker, dir) != 0) {
+            scan_fail(worker->scan);
+        }
+        scan_dir_done(worker->scan);
+        scan_dir_free(worker->scan, dir);
+    }
+
+    flush_small_batch(worker);
+    return NULL;
+}
+
+// 运行一轮遍历：调用线程作为 0 号遍历线程，队列清空后其余线程退出
+static void scan_run_workers(ScanState *scan) {
+    int started = 1;
+    for (int i = 1; i < scan->worker_count; i++) {
+        if (pthread_create(&scan->workers[i].thread, NULL, scan_worker_run, &scan->workers[i]) != 0) {
+            log_msg(LOG_WARN, "无法创建遍历线程 %d，使用 %d 个线程", i + 1, i);
+            break;
         }
+        started++;
+    }
+    scan_worker_run(&scan->workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(scan->workers[i].thread, NULL);
+    }
+}
 
-        free(norm_path);  // 释放内存
+// 一次遍历；metadata_only 时只记录路径与元数据
+static int scan_run(const char *dir_path, FileList *list, int source, int metadata_only) {
+    if (!dir_path || !list) {
+        log_msg(LOG_ERROR, "扫描目录参数错误");
+        return -1;
     }
 
-    closedir(dir);
-    free(norm_dir_path);  // 释放内存
+    // 仅对根目录规范化一次，子路径由目录项名拼接
+    char *norm_dir_path = normalize_path(dir_path);
+    if (!norm_dir_path) {
+        log_msg(LOG_ERROR, "路径规范化失败: %s", dir_path);
+        return -1;
+    }
+
+    ScanState *scan = calloc(1, sizeof(ScanState));
+    if (!scan) {
+        free(norm_dir_path);
+        log_msg(LOG_ERROR, "内存分配失败: 遍历状态");
+        return -1;
+    }
+    scan->list = list;
+    scan->source = source;
+    scan->metadata_only = metadata_only;
+    if (strcmp(norm_dir_path, ".") != 0) {
+        size_t len = strlen(norm_dir_path);
+        if (len > 0 && norm_dir_path[len - 1] == '/') len--;
+        memcpy(scan->root, norm_dir_path, len);
+        scan->root[len++] = '/';
+        scan->root_len = len;
+    }
+
+    scan->root_fd = open(norm_dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (scan->root_fd == -1) {
+        log_msg(LOG_WARN, "无法打开目录 '%s': %s", norm_dir_path, strerror(errno));
+        free(norm_dir_path);
+        free(scan);
+        return -1;
+    }
+    free(norm_dir_path);
+
+    scan->worker_count = config.recursive ? config.scan_threads : 1;
+    if (scan->worker_count < 1) scan->worker_count = config.threads;
+    scan->workers = calloc(scan->worker_count, sizeof(ScanWorker));
+    if (!scan->workers) {
+        log_msg(LOG_ERROR, "内存分配失败: 遍历线程");
+        close(scan->root_fd);
+        free(scan);
+        return -1;
+    }
+    pthread_mutex_init(&scan->idle_lock, NULL);
+    pthread_cond_init(&scan->work_available, NULL);
+    pthread_mutex_init(&scan->deferred_lock, NULL);
+    if (config.follow_symlinks && config.recursive) {
+        scan->dirs = inode_set_create();
+        if (!scan->dirs) log_msg(LOG_WARN, "内存分配失败: 目录 inode 表，不跟随目录符号链接");
+    }
+    // inode 表在所有扫描间共享 (如比较模式的两侧)，scan_wait 时释放；内存不足时不去重
+    if (!g_inodes && !metadata_only) g_inodes = inode_set_create();
+    for (int i = 0; i < scan->worker_count; i++) {
+        scan->workers[i].scan = scan;
+        scan->workers[i].seed = (unsigned int)i * 2654435761u + 1;
+        pthread_mutex_init(&scan->workers[i].deque.lock, NULL);
+    }
+
+    int result = scan_enqueue(&scan->workers[0], -1, NULL, "");
+
+    // 每轮结束后跟随新发现的目录符号链接，直到没有未遍历的目标
+    while (result == 0) {
+        scan_run_workers(scan);
+        if (scan->failed || g_interrupted || scan_follow_deferred(scan) == 0) break;
+    }
+
+    // 失败或中断时队列中可能还有未遍历的目录
+    for (int i = 0; i < scan->worker_count; i++) {
+        ScanDir *dir;
+        while ((dir = scan_deque_pop(&scan->workers[i].deque)) != NULL) {
+            scan_dir_free(scan, dir);
+        }
+        free(scan->workers[i].deque.items);
+        pthread_mutex_destroy(&scan->workers[i].deque.lock);
+    }
+    for (size_t i = 0; i < scan->deferred_count; i++) {
+        scan_dir_free(scan, scan->deferred[i]);
+    }
+    free(scan->deferred);
+    pthread_mutex_destroy(&scan->deferred_lock);
+    inode_set_free(scan->dirs);
+    int failed = scan->failed || result != 0;
+    close(scan->root_fd);
+    pthread_mutex_destroy(&scan->idle_lock);
+    pthread_cond_destroy(&scan->work_available);
+    free(scan->workers);
+    free(scan);
+
+    if (g_interrupted || failed) {
+        return -1;
+    }
     return 0;
 }
+
+// 扫描目录：多个遍历线程以目录为单位并行遍历 (工作窃取)，文件提交给哈希工作池后即继续遍历，
+// 元数据读取与数据读取重叠进行；返回时遍历已结束，哈希可能尚未完成，需调用 scan_wait()
+// 目录按描述符相对打开，条目用 fstatat 获取状态，内核不必逐项重新解析完整路径
+// 列表中记录的是相对 dir_path 的路径，与清单格式一致；列表顺序不确定，由调用方排序
+// source 为 dir_path 在多个源目录中的序号，用作续传日志的键 (同一相对路径可出现在多个源目录中)
+int scan_directory(const char *dir_path, FileList *list, int source) {
+    return scan_run(dir_path, list, source, 0);
+}
+
+// 只遍历元数据：列表条目不含摘要，不读取文件内容也不使用工作池，返回时即已完成，
+// 无需调用 scan_wait() (用于验证时检测额外文件)
+int scan_directory_metadata(const char *dir_path, FileList *list) {
+    return scan_run(dir_path, list, 0, 1);
+}
+
+// 所有目录遍历结束后调用：此时文件总数与总大小已确定 (哈希通常仍在进行)，
+// 先报告总量，再等待哈希全部完成；失败路径上也必须调用，列表在此之后才能释放
+int scan_wait(void) {
+    __atomic_store_n(&stats.scan_complete, 1, __ATOMIC_RELAXED);
+    size_t files = __atomic_load_n(&stats.scanned_files, __ATOMIC_RELAXED);
+    size_t bytes = __atomic_load_n(&stats.scanned_bytes, __ATOMIC_RELAXED);
+    size_t done = __atomic_load_n(&stats.hashed_files, __ATOMIC_RELAXED);
+    log_msg(LOG_INFO, "遍历完成: %zu 个文件，共 %.2f MB (已完成 %zu 个)",
+            files, bytes / 1024.0 / 1024.0, done);
+    if (config.progress) update_scan_progress(0);
+
+    dispatch_wait();
+    thread_pool_wait(g_hash_pool);
+
+    if (shared_files > 0) {
+        log_msg(LOG_INFO, "同一 inode 的 %zu 个路径复用已有摘要，少读取 %.2f MB",
+                shared_files, shared_bytes / 1024.0 / 1024.0);
+    }
+    inode_set_free(g_inodes);
+    g_inodes = NULL;
+    shared_files = 0;
+    shared_bytes = 0;
+
+    if (config.progress) update_scan_progress(0);
+    return g_interrupted ? -1 : 0;
+}
@@ -0,0 +1,795 @@
+#include "dispatch.h"
+#include "config.h"
+#include "logging.h"
+#include "file_utils.h"
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+extern Config config;
+extern Statistics stats;
+extern volatile sig_atomic_t g_interrupted;
+
+#define DISPATCH_HELLO "HELLO mirrorguard-worker"
+
+// 队列中的一个文件：未分配时在待处理队列中，分配后挂在持有租约的连接上
+typedef struct DispatchItem {
+    size_t id;
+    char *path;                    // 绝对路径 (worker 的工作目录与协调器不同)
+    off_t size;
+    DispatchDone done;
+    void *arg;
+    struct DispatchItem *next;
+} DispatchItem;
+
+// 一个 worker 连接，只由协调器线程访问
+typedef struct {
+    int fd;
+    char name[64];
+    char *in;                      // 未处理完的输入 (不足一行)
+    size_t in_len;
+    DispatchItem *leased;          // 已分配 (可跨多个批次) 但尚未返回结果的文件
+    size_t leased_count;
+    double deadline;               // 租约到期时间，收到任何消息时续期
+    int ready;                     // 已完成握手
+    int waiting;                   // 已请求下一批，等待分配 (上一批可能仍在哈希)
+} DispatchConn;
+
+typedef struct {
+    int listen_fd;
+    int wake[2];                   // 提交新文件或遍历结束时唤醒协调器线程
+    char unix_path[MAX_PATH];      // 监听的 Unix 套接字文件，退出时删除
+    char cwd[MAX_PATH];
+    pthread_t thread;
+
+    pthread_mutex_t lock;          // 保护以下字段
+    DispatchItem *pending;         // 待分配队列 (重新排队的文件放在队首)
+    DispatchItem *pending_tail;
+    size_t next_id;
+    size_t outstanding;            // 已提交但尚未得到结果的文件数
+    int closed;                    // 遍历已结束，不再提交
+
+    DispatchConn conns[DISPATCH_MAX_WORKERS];
+    int conn_count;
+    int worker_total;              // 累计连接过的 worker 数
+    size_t requeued;               // 因断开或租约到期重新排队的文件数
+} Dispatcher;
+
+static Dispatcher *g_dispatch = NULL;
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 写出全部内容；对端已关闭时不触发 SIGPIPE
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// 打开地址对应的套接字：listening 时绑定并监听，否则连接；地址格式见 dispatch.h
+static int dispatch_socket(const char *addr, int listening, char *unix_path, size_t unix_path_size) {
+    const char *path = NULL;
+    if (strncmp(addr, "unix:", 5) == 0) path = addr + 5;
+    else if (addr[0] == '/' || addr[0] == '.') path = addr;
+
+    if (path) {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(sa.sun_path)) {
+            log_msg(LOG_ERROR, "套接字路径过长: %s", path);
+            return -1;
+        }
+        strcpy(sa.sun_path, path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listening) {
+            // 上次异常退出留下的套接字文件
+            struct stat sb;
+            if (stat(path, &sb) == 0 && S_ISSOCK(sb.st_mode)) unlink(path);
+            if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 64) != 0) {
+                log_msg(LOG_ERROR, "无法监听 '%s': %s", path, strerror(errno));
+                close(fd);
+                return -1;
+            }
+            if (unix_path) snprintf(unix_path, unix_path_size, "%s", path);
+        } else if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // <主机>:<端口>，IPv6 地址写在方括号内；监听时主机可为空或 * 表示所有地址
+    char host[256];
+    const char *colon = strrchr(addr, ':');
+    if (!colon || colon[1] == '\0' || (size_t)(colon - addr) >= sizeof(host)) {
+        log_msg(LOG_ERROR, "无效的地址 '%s' (格式: unix:<路径> 或 <主机>:<端口>)", addr);
+        return -1;
+    }
+    const char *start = addr;
+    size_t host_len = (size_t)(colon - addr);
+    if (host_len >= 2 && addr[0] == '[' && colon[-1] == ']') {
+        start++;
+        host_len -= 2;
+    }
+    memcpy(host, start, host_len);
+    host[host_len] = '\0';
+    int any = host_len == 0 || strcmp(host, "*") == 0;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    struct addrinfo *res;
+    int gai = getaddrinfo(any ? NULL : host, colon + 1, &hints, &res);
+    if (gai != 0) {
+        log_msg(LOG_ERROR, "无法解析地址 '%s': %s", addr, gai_strerror(gai));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        int ok;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0;
+        } else {
+            ok = connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+            // 结果行很短，关闭 Nagle 避免与延迟确认叠加
+            if (ok) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (!ok) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0 && listening) log_msg(LOG_ERROR, "无法监听 '%s': %s", addr, strerror(errno));
+    return fd;
+}
+
+// ---- 协调器 ----
+
+static void dispatch_wake(Dispatcher *d) {
+    char c = 0;
+    ssize_t n = write(d->wake[1], &c, 1);
+    (void)n;  // 管道已满时协调器必定会被唤醒
+}
+
+// 连接断开、协议错误或租约到期：未完成的文件放回队首，由其他 worker 处理
+static void conn_drop(Dispatcher *d, int i, const char *reason) {
+    DispatchConn *conn = &d->conns[i];
+    if (conn->leased_count > 0) {
+        log_msg(LOG_WARN, "worker %s %s，%zu 个文件重新分配", conn->name, reason, conn->leased_count);
+        DispatchItem *tail = conn->leased;
+        while (tail->next) tail = tail->next;
+        pthread_mutex_lock(&d->lock);
+        tail->next = d->pending;
+        d->pending = conn->leased;
+        if (!d->pending_tail) d->pending_tail = tail;
+        d->requeued += conn->leased_count;
+        pthread_mutex_unlock(&d->lock);
+    }
+    close(conn->fd);
+    free(conn->in);
+    d->conns[i] = d->conns[--d->conn_count];
+}
+
+// 取出一个文件的结果 (digest 为 NULL 表示失败)
+static void conn_complete(Dispatcher *d, DispatchConn *conn, size_t id, const Digest *digest) {
+    DispatchItem **link = &conn->leased;
+    while (*link && (*link)->id != id) link = &(*link)->next;
+    DispatchItem *item = *link;
+    if (!item) return;  // 未分配给该 worker 的编号，忽略
+    *link = item->next;
+    conn->leased_count--;
+
+    if (!digest) log_msg(LOG_WARN, "worker %s 无法读取文件: %s", conn->name, item->path);
+    item->done(item->arg, digest);
+    free(item->path);
+    free(item);
+
+    pthread_mutex_lock(&d->lock);
+    d->outstanding--;
+    pthread_mutex_unlock(&d->lock);
+}
+
+// 处理 worker 的一行消息；协议错误时返回 -1
+static int conn_handle_line(Dispatcher *d, DispatchConn *conn, char *line) {
+    if (!conn->ready) {
+        int version;
+        char name[64];
+        if (sscanf(line, DISPATCH_HELLO " %d %63s", &version, name) != 2 || version != DISPATCH_PROTOCOL) {
+            log_msg(LOG_WARN, "拒绝不兼容的 worker 连接: %.80s", line);
+            return -1;
+        }
+        snprintf(conn->name, sizeof(conn->name), "%s", name);
+        char reply[128];
+        int len = snprintf(reply, sizeof(reply), "CONFIG %s %d\n", digest_engine_get(config.digest_algo)->name,
+                           config.lease_timeout);
+        if (send_all(conn->fd, reply, (size_t)len) != 0) return -1;
+        conn->ready = 1;
+        d->worker_total++;
+        log_msg(LOG_INFO, "worker %s 已连接", conn->name);
+        return 0;
+    }
+
+    if (strcmp(line, "GET") == 0) {
+        conn->waiting = 1;
+    } else if (strcmp(line, "PING") == 0) {
+        // 只用于续租
+    } else if (strncmp(line, "OK ", 3) == 0) {
+        char *end;
+        size_t id = strtoull(line + 3, &end, 10);
+        Digest digest;
+        if (*end != ' ' || digest_parse(end + 1, strlen(end + 1), config.digest_algo, &digest) != 0) return -1;
+        conn_complete(d, conn, id, &digest);
+    } else if (strncmp(line, "FAIL ", 5) == 0) {
+        conn_complete(d, conn, strtoull(line + 5, NULL, 10), NULL);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// 读取并处理连接上已到达的数据；连接应关闭时返回 -1
+static int conn_read(Dispatcher *d, DispatchConn *conn) {
+    char buf[65536];
+    ssize_t n = read(conn->fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) return 0;
+    if (n <= 0) return -1;
+
+    char *grown = realloc(conn->in, conn->in_len + (size_t)n + 1);
+    if (!grown) return -1;
+    conn->in = grown;
+    memcpy(conn->in + conn->in_len, buf, (size_t)n);
+    conn->in_len += (size_t)n;
+    conn->in[conn->in_len] = '\0';
+    conn->deadline = monotonic_now() + config.lease_timeout;
+
+    char *line = conn->in;
+    char *newline;
+    while ((newline = memchr(line, '\n', conn->in_len - (size_t)(line - conn->in))) != NULL) {
+        *newline = '\0';
+        if (conn_handle_line(d, conn, line) != 0) return -1;
+        line = newline + 1;
+    }
+    size_t rest = conn->in_len - (size_t)(line - conn->in);
+    if (rest > DISPATCH_LINE_MAX) return -1;
+    memmove(conn->in, line, rest);
+    conn->in_len = rest;
+    return 0;
+}
+
+// 给等待中的 worker 分配下一批：按文件数与累计大小截断，大文件单独成批；
+// worker 在上一批结束前就会请求，新批次并入它尚未完成的文件
+static int conn_assign(Dispatcher *d, DispatchConn *conn) {
+    pthread_mutex_lock(&d->lock);
+    DispatchItem *batch = d->pending;
+    DispatchItem *last = NULL;
+    size_t count = 0;
+    long long bytes = 0;
+    for (DispatchItem *item = d->pending; item && count < DISPATCH_BATCH_FILES; item = item->next) {
+        if (count > 0 && bytes + item->size > DISPATCH_BATCH_BYTES) break;
+        bytes += item->size;
+        last = item;
+        count++;
+    }
+    if (count > 0) {
+        d->pending = last->next;
+        if (!d->pending) d->pending_tail = NULL;
+        last->next = NULL;
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (count == 0) return 0;
+
+    last->next = conn->leased;
+    conn->leased = batch;
+    conn->leased_count += count;
+    conn->waiting = 0;
+    conn->deadline = monotonic_now() + config.lease_timeout;
+
+    char line[DISPATCH_LINE_MAX];
+    int len = snprintf(line, sizeof(line), "BATCH %zu\n", count);
+    if (send_all(conn->fd, line, (size_t)len) != 0) return -1;
+    for (DispatchItem *item = batch; item != last->next; item = item->next) {
+        len = snprintf(line, sizeof(line), "%zu %s\n", item->id, item->path);
+        if (len >= (int)sizeof(line) || send_all(conn->fd, line, (size_t)len) != 0) return -1;
+    }
+    return 0;
+}
+
+// 中断时结束所有未完成的文件 (回调收到 NULL)
+static void dispatch_abort(Dispatcher *d) {
+    for (int i = 0; i < d->conn_count; i++) {
+        DispatchItem *item = d->conns[i].leased;
+        d->conns[i].leased = NULL;
+        d->conns[i].leased_count = 0;
+        while (item) {
+            DispatchItem *next = item->next;
+            item->done(item->arg, NULL);
+            free(item->path);
+            free(item);
+            item = next;
+        }
+    }
+    pthread_mutex_lock(&d->lock);
+    DispatchItem *item = d->pending;
+    d->pending = d->pending_tail = NULL;
+    d->outstanding = 0;
+    pthread_mutex_unlock(&d->lock);
+    while (item) {
+        DispatchItem *next = item->next;
+        item->done(item->arg, NULL);
+        free(item->path);
+        free(item);
+        item = next;
+    }
+}
+
+// 协调器线程：单线程 poll 循环，接受连接、分配批次、收取结果、检查租约
+static void* dispatch_run(void *arg) {
+    Dispatcher *d = (Dispatcher *)arg;
+    struct pollfd fds[DISPATCH_MAX_WORKERS + 2];
+
+    for (;;) {
+        if (g_interrupted) {
+            dispatch_abort(d);
+            break;
+        }
+
+        pthread_mutex_lock(&d->lock);
+        int finished = d->closed && d->outstanding == 0;
+        pthread_mutex_unlock(&d->lock);
+
+        // 全部完成：通知所有 worker 退出 (最后一个 GET 可能尚未到达)
+        if (finished) {
+            for (int i = 0; i < d->conn_count; i++) {
+                if (d->conns[i].ready) send_all(d->conns[i].fd, "DONE\n", 5);
+            }
+            break;
+        }
+
+        double now = monotonic_now();
+        for (int i = d->conn_count; i-- > 0; ) {
+            DispatchConn *conn = &d->conns[i];
+            if (conn->leased_count > 0 && now > conn->deadline) {
+                conn_drop(d, i, "租约到期");
+            } else if (conn->waiting && conn_assign(d, conn) != 0) {
+                conn_drop(d, i, "连接中断");
+            }
+        }
+
+        fds[0].fd = d->wake[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = d->listen_fd;
+        fds[1].events = POLLIN;
+        for (int i = 0; i < d->conn_count; i++) {
+            fds[i + 2].fd = d->conns[i].fd;
+            fds[i + 2].events = POLLIN;
+        }
+        int conn_count = d->conn_count;
+        int ready = poll(fds, (nfds_t)conn_count + 2, 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            log_msg(LOG_ERROR, "协调器等待失败: %s", strerror(errno));
+            dispatch_abort(d);
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char buf[256];
+            ssize_t n = read(d->wake[0], buf, sizeof(buf));
+            (void)n;
+        }
+
+        // 从后往前处理，断开的连接由末尾的连接填补，不影响尚未处理的下标
+        for (int i = conn_count; i-- > 0; ) {
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (conn_read(d, &d->conns[i]) != 0) conn_drop(d, i, "连接中断");
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept(d->listen_fd, NULL, NULL);
+            if (fd >= 0 && d->conn_count >= DISPATCH_MAX_WORKERS) {
+                log_msg(LOG_WARN, "worker 连接数已达上限 %d，拒绝新连接", DISPATCH_MAX_WORKERS);
+                close(fd);
+            } else if (fd >= 0) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Unix 套接字上无效，忽略失败
+                DispatchConn *conn = &d->conns[d->conn_count++];
+                memset(conn, 0, sizeof(DispatchConn));
+                conn->fd = fd;
+                snprintf(conn->name, sizeof(conn->name), "#%d", d->worker_total + 1);
+                conn->deadline = monotonic_now() + config.lease_timeout;
+            }
+        }
+    }
+
+    for (int i = 0; i < d->conn_count; i++) {
+        close(d->conns[i].fd);
+        free(d->conns[i].in);
+    }
+    d->conn_count = 0;
+    return NULL;
+}
+
+// 开始监听并启动协调器线程；此后 submit_hash_job 把待哈希的文件交给协调器
+int dispatch_start(const char *addr) {
+    Dispatcher *d = calloc(1, sizeof(Dispatcher));
+    if (!d) return MIRRORGUARD_ERROR_MEMORY;
+
+    if (!getcwd(d->cwd, sizeof(d->cwd))) d->cwd[0] = '\0';
+    d->listen_fd = dispatch_socket(addr, 1, d->unix_path, sizeof(d->unix_path));
+    if (d->listen_fd < 0) {
+        free(d);
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    if (pipe(d->wake) != 0) {
+        close(d->listen_fd);
+        free(d);
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    fcntl(d->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(d->wake[1], F_SETFL, O_NONBLOCK);
+    pthread_mutex_init(&d->lock, NULL);
+
+    if (pthread_create(&d->thread, NULL, dispatch_run, d) != 0) {
+        log_msg(LOG_ERROR, "无法创建协调器线程");
+        close(d->listen_fd);
+        close(d->wake[0]);
+        close(d->wake[1]);
+        if (d->unix_path[0]) unlink(d->unix_path);
+        pthread_mutex_destroy(&d->lock);
+        free(d);
+        return MIRRORGUARD_ERROR_GENERAL;
+    }
+    g_dispatch = d;
+    log_msg(LOG_INFO, "协调器监听 %s，等待 worker 连接 (租约 %d 秒)", addr, config.lease_timeout);
+    return MIRRORGUARD_OK;
+}
+
+int dispatch_active(void) {
+    return g_dispatch != NULL;
+}
+
+// 文件加入待分配队列 (遍历线程调用)；失败时返回 -1，由调用方在本地计算
+int dispatch_submit(const char *path, off_t size, DispatchDone done, void *arg) {
+    Dispatcher *d = g_dispatch;
+    DispatchItem *item = malloc(sizeof(DispatchItem));
+    if (!d || !item) {
+        free(item);
+        return -1;
+    }
+
+    size_t len = strlen(path);
+    int relative = path[0] != '/' && d->cwd[0];
+    size_t prefix = relative ? strlen(d->cwd) + 1 : 0;
+    item->path = malloc(prefix + len + 1);
+    if (!item->path) {
+        free(item);
+        return -1;
+    }
+    if (relative) {
+        memcpy(item->path, d->cwd, prefix - 1);
+        item->path[prefix - 1] = '/';
+    }
+    memcpy(item->path + prefix, path, len + 1);
+    item->size = size;
+    item->done = done;
+    item->arg = arg;
+    item->next = NULL;
+
+    pthread_mutex_lock(&d->lock);
+    item->id = d->next_id++;
+    if (d->pending_tail) d->pending_tail->next = item;
+    else d->pending = item;
+    d->pending_tail = item;
+    d->outstanding++;
+    pthread_mutex_unlock(&d->lock);
+    dispatch_wake(d);
+    return 0;
+}
+
+// 遍历结束后调用：等待所有文件的结果返回 (中断时未完成的文件以失败结束)，然后关闭监听
+int dispatch_wait(void) {
+    Dispatcher *d = g_dispatch;
+    if (!d) return 0;
+
+    pthread_mutex_lock(&d->lock);
+    d->closed = 1;
+    pthread_mutex_unlock(&d->lock);
+    dispatch_wake(d);
+    pthread_join(d->thread, NULL);
+
+    if (!g_interrupted) {
+        log_msg(LOG_INFO, "分布式哈希完成: %d 个 worker 参与，%zu 个文件重新分配", d->worker_total, d->requeued);
+    }
+    close(d->listen_fd);
+    close(d->wake[0]);
+    close(d->wake[1]);
+    if (d->unix_path[0]) unlink(d->unix_path);
+    pthread_mutex_destroy(&d->lock);
+    free(d);
+    g_dispatch = NULL;
+    return g_interrupted ? -1 : 0;
+}
+
+// ---- worker ----
+
+typedef struct {
+    int fd;
+    pthread_mutex_t write_lock;    // 结果行与心跳来自不同线程
+    int failed;
+    pthread_mutex_t jobs_lock;
+    pthread_cond_t jobs_done;
+    size_t inflight;               // 已交给工作池但尚未送回结果的文件数
+    char buf[65536];
+    size_t len;
+    size_t pos;
+    char line[DISPATCH_LINE_MAX];
+} WorkerConn;
+
+typedef struct {
+    WorkerConn *conn;
+    size_t id;
+    char *path;
+} WorkerJob;
+
+static int worker_send(WorkerConn *conn, const char *data, size_t len) {
+    pthread_mutex_lock(&conn->write_lock);
+    int result = conn->failed ? -1 : send_all(conn->fd, data, len);
+    if (result != 0) conn->failed = 1;
+    pthread_mutex_unlock(&conn->write_lock);
+    return result;
+}
+
+// 读取一行 (去掉换行)；连接关闭、出错或被中断时返回 NULL
+static char* worker_read_line(WorkerConn *conn) {
+    size_t out = 0;
+    for (;;) {
+        while (conn->pos < conn->len) {
+            char c = conn->buf[conn->pos++];
+            if (c == '\n') {
+                conn->line[out] = '\0';
+                return conn->line;
+            }
+            if (out + 1 >= sizeof(conn->line)) return NULL;
+            conn->line[out++] = c;
+        }
+
+        // 每秒检查一次中断标志 (信号不会打断阻塞的读取)
+        struct pollfd pfd = { conn->fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, 1000);
+        if (g_interrupted) return NULL;
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) {
+            if (ready < 0) return NULL;
+            continue;
+        }
+        ssize_t n = read(conn->fd, conn->buf, sizeof(conn->buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return NULL;
+        conn->len = (size_t)n;
+        conn->pos = 0;
+    }
+}
+
+// 哈希一个文件并立即送回结果
+static void worker_job_run(void *arg) {
+    WorkerJob *job = (WorkerJob *)arg;
+    Digest digest;
+    char line[HASH_STR_MAX + 64];
+    char hex[HASH_STR_MAX];
+    int len;
+    if (!g_interrupted && compute_file_hash(job->path, config.digest_algo, &digest) == 0 &&
+        digest_format(&digest, config.digest_algo, hex, sizeof(hex)) == 0) {
+        len = snprintf(line, sizeof(line), "OK %zu %s\n", job->id, hex);
+        __atomic_add_fetch(&stats.hashed_files, 1, __ATOMIC_RELAXED);
+    } else {
+        len = snprintf(line, sizeof(line), "FAIL %zu\n", job->id);
+        __atomic_add_fetch(&stats.error_files, 1, __ATOMIC_RELAXED);
+    }
+    // 中断时不回报失败，连接断开后协调器把这些文件交给其他 worker
+    WorkerConn *conn = job->conn;
+    if (!g_interrupted) worker_send(conn, line, (size_t)len);
+    free(job->path);
+    free(job);
+
+    pthread_mutex_lock(&conn->jobs_lock);
+    conn->inflight--;
+    pthread_cond_signal(&conn->jobs_done);
+    pthread_mutex_unlock(&conn->jobs_lock);
+}
+
+// 等待在途文件数降到 limit 以下 (每秒检查一次中断标志)
+static void worker_wait_inflight(WorkerConn *conn, size_t limit) {
+    pthread_mutex_lock(&conn->jobs_lock);
+    while (conn->inflight > limit && !g_interrupted) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 1;
+        pthread_cond_timedwait(&conn->jobs_done, &conn->jobs_lock, &ts);
+    }
+    pthread_mutex_unlock(&conn->jobs_lock);
+}
+
+typedef struct {
+    WorkerConn *conn;
+    pthread_t thread;
+    int interval;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Heartbeat;
+
+// 心跳线程：批次中的大文件可能需要很久，期间按间隔发送 PING 续租
+static void* heartbeat_run(void *arg) {
+    Heartbeat *hb = (Heartbeat *)arg;
+    pthread_mutex_lock(&hb->lock);
+    while (!hb->stop) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += hb->interval;
+        pthread_cond_timedwait(&hb->cond, &hb->lock, &ts);
+        if (!hb->stop && worker_send(hb->conn, "PING\n", 5) != 0) break;
+    }
+    pthread_mutex_unlock(&hb->lock);
+    return NULL;
+}
+
+// worker 主循环：连接协调器，逐批拉取文件，在本地工作池中并行哈希，直到收到 DONE；
+// 在途文件降到不多于工作线程数 (队列已空) 时就请求下一批，批次的传输与最后几个文件的哈希重叠，
+// 慢文件不会让其余线程空等整批结束
+int dispatch_worker_run(const char *addr) {
+    WorkerConn *conn = calloc(1, sizeof(WorkerConn));
+    if (!conn) return MIRRORGUARD_ERROR_MEMORY;
+
+    // 协调器可能稍后才启动，等待一段时间
+    conn->fd = -1;
+    for (int attempt = 0; attempt <= DISPATCH_CONNECT_RETRY && !g_interrupted; attempt++) {
+        conn->fd = dispatch_socket(addr, 0, NULL, 0);
+        if (conn->fd >= 0) break;
+        if (attempt == 0) log_msg(LOG_INFO, "等待协调器 %s ...", addr);
+        sleep(1);
+    }
+    if (conn->fd < 0) {
+        log_msg(LOG_ERROR, "无法连接协调器 '%s'", addr);
+        free(conn);
+        return g_interrupted ? MIRRORGUARD_ERROR_INTERRUPTED : MIRRORGUARD_ERROR_FILE_IO;
+    }
+    pthread_mutex_init(&conn->write_lock, NULL);
+    pthread_mutex_init(&conn->jobs_lock, NULL);
+    pthread_cond_init(&conn->jobs_done, NULL);
+
+    char host[64];
+    if (gethostname(host, sizeof(host)) != 0) snprintf(host, sizeof(host), "localhost");
+    host[sizeof(host) - 1] = '\0';
+    char hello[160];
+    int len = snprintf(hello, sizeof(hello), "%s %d %.40s:%d\n", DISPATCH_HELLO, DISPATCH_PROTOCOL, host,
+                       (int)getpid());
+
+    int result = MIRRORGUARD_OK;
+    char algo[32];
+    int lease = 0;
+    const char *line = NULL;
+    if (worker_send(conn, hello, (size_t)len) != 0 || !(line = worker_read_line(conn)) ||
+        sscanf(line, "CONFIG %31s %d", algo, &lease) != 2 || !digest_engine_by_name(algo) || lease < 1) {
+        log_msg(LOG_ERROR, "与协调器握手失败: %s", addr);
+        result = g_interrupted ? MIRRORGUARD_ERROR_INTERRUPTED : MIRRORGUARD_ERROR_INVALID_FORMAT;
+    }
+
+    Heartbeat hb;
+    hb.conn = conn;
+    hb.interval = lease / 3 > 0 ? lease / 3 : 1;
+    hb.stop = 0;
+    pthread_mutex_init(&hb.lock, NULL);
+    pthread_cond_init(&hb.cond, NULL);
+    int heartbeat = 0;
+    if (result == MIRRORGUARD_OK) {
+        config.digest_algo = digest_engine_by_name(algo)->algo;
+        log_msg(LOG_INFO, "已连接协调器 %s (算法: %s)", addr, algo);
+        heartbeat = pthread_create(&hb.thread, NULL, heartbeat_run, &hb) == 0;
+    }
+
+    size_t batches = 0;
+    size_t low_water = g_hash_pool ? (size_t)g_hash_pool->thread_count : 0;
+    while (result == MIRRORGUARD_OK) {
+        worker_wait_inflight(conn, low_water);
+        if (conn->failed) result = MIRRORGUARD_ERROR_FILE_IO;
+        if (g_interrupted) result = MIRRORGUARD_ERROR_INTERRUPTED;
+        if (result != MIRRORGUARD_OK) break;
+
+        // 协调器完成时可能已先发出 DONE 并关闭连接，请求发送失败时仍读取缓冲中的回复
+        int sent = worker_send(conn, "GET\n", 4) == 0;
+        if (!(line = worker_read_line(conn))) {
+            result = g_interrupted ? MIRRORGUARD_ERROR_INTERRUPTED : MIRRORGUARD_ERROR_FILE_IO;
+            break;
+        }
+        if (strcmp(line, "DONE") == 0) break;
+        if (!sent) {
+            result = MIRRORGUARD_ERROR_FILE_IO;
+            break;
+        }
+
+        size_t count;
+        if (sscanf(line, "BATCH %zu", &count) != 1) {
+            log_msg(LOG_ERROR, "协调器消息无效: %.80s", line);
+            result = MIRRORGUARD_ERROR_INVALID_FORMAT;
+            break;
+        }
+        batches++;
+        for (size_t i = 0; i < count && result == MIRRORGUARD_OK; i++) {
+            char *end;
+            if (!(line = worker_read_line(conn))) {
+                result = g_interrupted ? MIRRORGUARD_ERROR_INTERRUPTED : MIRRORGUARD_ERROR_FILE_IO;
+                break;
+            }
+            size_t id = strtoull(line, &end, 10);
+            WorkerJob *job = malloc(sizeof(WorkerJob));
+            if (*end != ' ' || !job || !(job->path = strdup(end + 1))) {
+                free(job);
+                result = MIRRORGUARD_ERROR_MEMORY;
+                break;
+            }
+            job->conn = conn;
+            job->id = id;
+            pthread_mutex_lock(&conn->jobs_lock);
+            conn->inflight++;
+            pthread_mutex_unlock(&conn->jobs_lock);
+            if (!g_hash_pool || thread_pool_submit(g_hash_pool, worker_job_run, job) != 0) {
+                worker_job_run(job);
+            }
+        }
+    }
+    thread_pool_wait(g_hash_pool);
+
+    if (heartbeat) {
+        pthread_mutex_lock(&hb.lock);
+        hb.stop = 1;
+        pthread_cond_signal(&hb.cond);
+        pthread_mutex_unlock(&hb.lock);
+        pthread_join(hb.thread, NULL);
+    }
+    pthread_mutex_destroy(&hb.lock);
+    pthread_cond_destroy(&hb.cond);
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->write_lock);
+    pthread_mutex_destroy(&conn->jobs_lock);
+    pthread_cond_destroy(&conn->jobs_done);
+    free(conn);
+
+    log_msg(LOG_INFO, "worker 结束: %zu 批，%zu 个文件，%.2f MB，%zu 个失败", batches, stats.hashed_files,
+            stats.bytes_processed / 1024.0 / 1024.0, stats.error_files);
+    return result;
+}
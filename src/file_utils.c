@@ -1,10 +1,15 @@
+#define _GNU_SOURCE // O_DIRECT
 #include "file_utils.h"
 #include "config.h"
 #include "logging.h"
 #include "path_utils.h"
 #include "data_structs.h"
+#include "thread_pool.h"
+#include "digest.h"
+#include "uring_io.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -16,67 +21,157 @@ extern Config config;
 extern Statistics stats;
 extern volatile sig_atomic_t g_interrupted;
 
-// 计算文件的SHA256 (使用EVP接口，OpenSSL 3.0兼容)
-int compute_sha256(const char *file_path, char *hash_str) {
-    if (!file_path || !hash_str) {
-        log_msg(LOG_ERROR, "计算SHA256参数错误");
+// O_DIRECT 读缓冲区：按页对齐，每个工作线程一块并重复使用
+static pthread_key_t direct_buffer_key;
+static pthread_once_t direct_buffer_once = PTHREAD_ONCE_INIT;
+
+static void direct_buffer_key_init(void) {
+    pthread_key_create(&direct_buffer_key, free);
+}
+
+static unsigned char* direct_buffer_get(void) {
+    pthread_once(&direct_buffer_once, direct_buffer_key_init);
+    unsigned char *buf = pthread_getspecific(direct_buffer_key);
+    if (!buf) {
+        if (posix_memalign((void **)&buf, DIRECT_IO_ALIGN, DIRECT_IO_BUFFER_SIZE) != 0) {
+            return NULL;
+        }
+        pthread_setspecific(direct_buffer_key, buf);
+    }
+    return buf;
+}
+
+// 丢弃读游标之后已读过的页缓存 (缓存中立模式)
+void drop_file_cache(int fd, off_t offset, off_t len) {
+    if (config.cache_mode == CACHE_MODE_NORMAL || fd < 0) return;
+    posix_fadvise(fd, offset, len, POSIX_FADV_DONTNEED);
+}
+
+// 块摘要记录文件 (生成树哈希清单时写入)
+static FILE *block_log_fp = NULL;
+static pthread_mutex_t block_log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 使用指定摘要引擎计算文件哈希，输出二进制摘要
+int compute_file_hash(const char *file_path, DigestAlgo algo, Digest *digest) {
+    if (!file_path || !digest) {
+        log_msg(LOG_ERROR, "计算哈希参数错误");
         return -1;
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
-    const EVP_MD *md = EVP_sha256();
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        log_msg(LOG_ERROR, "无法创建EVP上下文");
+    const DigestEngine *engine = digest_engine_get(algo);
+    unsigned char hash[MAX_DIGEST_LENGTH];
+    DigestCtx *mdctx = digest_ctx_new(algo);
+    if (!engine || !mdctx) {
+        log_msg(LOG_ERROR, "无法创建摘要上下文");
         return -1;
     }
 
+    // io_uring 引擎：open/statx/read 批量提交，不可用时继续走同步路径
+    if (config.io_engine == IO_ENGINE_URING) {
+        if (digest_init(mdctx) != 0) {
+            digest_ctx_free(mdctx);
+            return -1;
+        }
+        int ret = uring_hash_file(file_path, mdctx);
+        if (ret != URING_UNAVAILABLE) {
+            if (ret == 0 && digest_final(mdctx, hash) == 0) {
+                digest_ctx_free(mdctx);
+                digest_set(digest, hash, engine->digest_len, 0);
+                return 0;
+            }
+            digest_ctx_free(mdctx);
+            return -1;
+        }
+    }
+
     int fd = -1;
     ssize_t bytes_read;
-    unsigned char buffer[64 * 1024]; // 64KB
+    unsigned char stack_buffer[64 * 1024]; // 64KB
+    unsigned char *buffer = stack_buffer;
+    size_t buffer_size = sizeof(stack_buffer);
+    int direct = 0;
     struct stat sb;
 
     // 检查文件是否存在且可读
     if (stat(file_path, &sb) != 0) {
         log_msg(LOG_WARN, "无法访问文件 '%s': %s", file_path, strerror(errno));
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         return -1;
     }
 
     if (!S_ISREG(sb.st_mode)) {
         log_msg(LOG_WARN, "非普通文件: %s", file_path);
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         return -1;
     }
 
-    if ((fd = open(file_path, O_RDONLY)) == -1) {
+    // O_DIRECT 绕过页缓存；文件系统不支持 (EINVAL) 时退回 fadvise 模式
+    if (config.cache_mode == CACHE_MODE_DIRECT) {
+        unsigned char *aligned = direct_buffer_get();
+        if (aligned) {
+            fd = open(file_path, O_RDONLY | O_DIRECT);
+            if (fd != -1) {
+                buffer = aligned;
+                buffer_size = DIRECT_IO_BUFFER_SIZE;
+                direct = 1;
+            } else if (errno != EINVAL) {
+                log_msg(LOG_WARN, "无法打开文件 '%s': %s", file_path, strerror(errno));
+                digest_ctx_free(mdctx);
+                return -1;
+            }
+        }
+    }
+
+    if (fd == -1 && (fd = open(file_path, O_RDONLY)) == -1) {
         log_msg(LOG_WARN, "无法打开文件 '%s': %s", file_path, strerror(errno));
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         return -1;
     }
 
+    if (config.cache_mode != CACHE_MODE_NORMAL && !direct) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
     // 检查是否被中断
     if (g_interrupted) {
         close(fd);
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         return -1;
     }
 
-    if (EVP_DigestInit_ex(mdctx, md, NULL) != 1) {
-        log_msg(LOG_ERROR, "EVP_DigestInit_ex failed");
+    if (digest_init(mdctx) != 0) {
         close(fd);
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         return -1;
     }
 
-    while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
-        if (EVP_DigestUpdate(mdctx, buffer, bytes_read) != 1) {
-            log_msg(LOG_ERROR, "EVP_DigestUpdate failed");
+    off_t offset = 0;
+    off_t dropped = 0;
+    for (;;) {
+        bytes_read = read(fd, buffer, buffer_size);
+        if (bytes_read == -1 && errno == EINTR) continue;
+        if (bytes_read == -1 && direct && errno == EINVAL) {
+            // 非对齐尾部或设备拒绝直接 I/O：关闭 O_DIRECT，从当前位置继续缓冲读取
+            int flags = fcntl(fd, F_GETFL);
+            if (flags != -1 && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+                direct = 0;
+                continue;
+            }
+        }
+        if (bytes_read <= 0) break;
+
+        if (digest_update(mdctx, buffer, bytes_read) != 0) {
             close(fd);
-            EVP_MD_CTX_free(mdctx);
+            digest_ctx_free(mdctx);
             return -1;
         }
+        offset += bytes_read;
+
+        // 缓冲读取时，每读过 DONTNEED_WINDOW 就丢弃游标之后的页缓存
+        if (!direct && offset - dropped >= DONTNEED_WINDOW) {
+            drop_file_cache(fd, dropped, offset - dropped);
+            dropped = offset;
+        }
 
         // 更新统计
         pthread_mutex_lock(&stats.lock);
@@ -86,45 +181,45 @@ int compute_sha256(const char *file_path, char *hash_str) {
         // 检查是否被中断
         if (g_interrupted) {
             close(fd);
-            EVP_MD_CTX_free(mdctx);
+            digest_ctx_free(mdctx);
             return -1;
         }
     }
 
     if (bytes_read == -1) {
         close(fd);
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         log_msg(LOG_ERROR, "读取文件 '%s' 失败: %s", file_path, strerror(errno));
         return -1;
     }
 
-    if (EVP_DigestFinal_ex(mdctx, hash, &hash_len) != 1) {
-        log_msg(LOG_ERROR, "EVP_DigestFinal_ex failed");
+    if (digest_final(mdctx, hash) != 0) {
         close(fd);
-        EVP_MD_CTX_free(mdctx);
+        digest_ctx_free(mdctx);
         return -1;
     }
 
+    drop_file_cache(fd, 0, 0);
     close(fd);
-    EVP_MD_CTX_free(mdctx);
+    digest_ctx_free(mdctx);
 
-    // 转换为十六进制字符串
-    for (unsigned int i = 0; i < hash_len; i++) {
-        sprintf(hash_str + (i * 2), "%02x", hash[i]);
-    }
-    hash_str[hash_len * 2] = '\0';
+    digest_set(digest, hash, engine->digest_len, 0);
 
     return 0;
 }
 
-// 验证单个文件
-FileStatus verify_file(const char *mirror_dir, const char *rel_path, const char *expected_hash) {
-    if (!mirror_dir || !rel_path || !expected_hash) {
+static FileStatus verify_tree_file(const char *file_path, const char *rel_path,
+                                   const Digest *expected, DigestAlgo algo, off_t file_size);
+
+// 验证单个文件；expected_size >= 0 时先比较大小，不一致直接判为损坏而不读取内容
+FileStatus verify_file(const char *mirror_dir, const char *rel_path, const Digest *expected,
+                       long long expected_size) {
+    if (!mirror_dir || !rel_path || !expected) {
         return FILE_STATUS_ERROR;
     }
 
     char full_path[MAX_PATH];
-    char actual_hash[SHA256_DIGEST_LENGTH * 2 + 1] = {0};
+    Digest actual;
 
     // 构建完整路径
     if (mirror_dir[strlen(mirror_dir)-1] == '/') {
@@ -156,8 +251,22 @@ FileStatus verify_file(const char *mirror_dir, const char *rel_path, const char
         return FILE_STATUS_ERROR; // 非规文件
     }
 
-    // 计算实际哈希
-    int hash_result = compute_sha256(norm_path, actual_hash);
+    if (expected_size >= 0 && (long long)sb.st_size != expected_size) {
+        log_msg(LOG_ERROR, "  大小不符: %s 期望 %lld 字节，实际 %lld 字节",
+                rel_path, expected_size, (long long)sb.st_size);
+        free(norm_path);
+        return FILE_STATUS_CORRUPT;
+    }
+
+    // 树哈希条目：分块并行校验
+    if (expected->tree_block_size > 0) {
+        FileStatus status = verify_tree_file(norm_path, rel_path, expected, config.digest_algo, sb.st_size);
+        free(norm_path);
+        return status;
+    }
+
+    // 计算实际哈希 (算法由清单头决定)
+    int hash_result = compute_file_hash(norm_path, config.digest_algo, &actual);
     free(norm_path);  // 释放内存
 
     if (hash_result != 0) {
@@ -165,9 +274,382 @@ FileStatus verify_file(const char *mirror_dir, const char *rel_path, const char
     }
 
     // 比较哈希
-    if (strcmp(actual_hash, expected_hash) == 0) {
+    if (digest_equal(&actual, expected)) {
         return FILE_STATUS_VALID;
     } else {
         return FILE_STATUS_CORRUPT;
     }
 }
+
+// 树哈希上下文：各块由不同线程通过 pread 并行读取
+typedef struct {
+    int fd;
+    const char *path;
+    DigestAlgo algo;
+    size_t digest_len;
+    size_t block_size;
+    off_t file_size;
+    unsigned char *digests;        // block_count * digest_len
+    volatile int failed;
+} TreeHashCtx;
+
+static void tree_hash_block(void *arg, size_t index) {
+    TreeHashCtx *ctx = (TreeHashCtx *)arg;
+    if (ctx->failed || g_interrupted) {
+        ctx->failed = 1;
+        return;
+    }
+
+    DigestCtx *mdctx = digest_ctx_new(ctx->algo);
+    if (!mdctx || digest_init(mdctx) != 0) {
+        log_msg(LOG_ERROR, "无法创建摘要上下文");
+        digest_ctx_free(mdctx);
+        ctx->failed = 1;
+        return;
+    }
+
+    unsigned char buffer[64 * 1024];
+    off_t offset = (off_t)index * ctx->block_size;
+    off_t end = offset + (off_t)ctx->block_size;
+    if (end > ctx->file_size) end = ctx->file_size;
+
+    while (offset < end) {
+        size_t want = sizeof(buffer);
+        if ((off_t)want > end - offset) want = end - offset;
+
+        ssize_t n = pread(ctx->fd, buffer, want, offset);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            log_msg(LOG_ERROR, "读取文件 '%s' 失败: %s", ctx->path, n == 0 ? "文件被截断" : strerror(errno));
+            ctx->failed = 1;
+            break;
+        }
+        if (digest_update(mdctx, buffer, n) != 0) {
+            ctx->failed = 1;
+            break;
+        }
+        offset += n;
+
+        pthread_mutex_lock(&stats.lock);
+        stats.bytes_processed += n;
+        pthread_mutex_unlock(&stats.lock);
+
+        if (g_interrupted) {
+            ctx->failed = 1;
+            break;
+        }
+    }
+
+    if (!ctx->failed && digest_final(mdctx, ctx->digests + index * ctx->digest_len) != 0) {
+        ctx->failed = 1;
+    }
+    digest_ctx_free(mdctx);
+    drop_file_cache(ctx->fd, (off_t)index * ctx->block_size, (off_t)ctx->block_size);
+}
+
+// 计算树哈希：文件按 block_size 分块并行计算摘要，
+// 根摘要 = H(0x01 || 块摘要0 || 块摘要1 || ...)
+// 结果为根摘要，tree_block_size 记录块大小 (清单中写作 tree-<算法>:<块大小>:<hex>)
+// block_digests 非空时返回块摘要数组 (调用方释放)
+int compute_tree_hash(const char *file_path, DigestAlgo algo, size_t block_size, Digest *digest,
+                      unsigned char **block_digests, size_t *block_count) {
+    const DigestEngine *engine = digest_engine_get(algo);
+    if (!file_path || !digest || block_size == 0 || !engine) {
+        log_msg(LOG_ERROR, "计算树哈希参数错误");
+        return -1;
+    }
+
+    struct stat sb;
+    if (stat(file_path, &sb) != 0) {
+        log_msg(LOG_WARN, "无法访问文件 '%s': %s", file_path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISREG(sb.st_mode)) {
+        log_msg(LOG_WARN, "非普通文件: %s", file_path);
+        return -1;
+    }
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd == -1) {
+        log_msg(LOG_WARN, "无法打开文件 '%s': %s", file_path, strerror(errno));
+        return -1;
+    }
+
+    size_t count = sb.st_size > 0 ? (sb.st_size + block_size - 1) / block_size : 1;
+    TreeHashCtx ctx;
+    ctx.fd = fd;
+    ctx.path = file_path;
+    ctx.algo = algo;
+    ctx.digest_len = engine->digest_len;
+    ctx.block_size = block_size;
+    ctx.file_size = sb.st_size;
+    ctx.failed = 0;
+    ctx.digests = malloc(count * engine->digest_len);
+    if (!ctx.digests) {
+        log_msg(LOG_ERROR, "内存分配失败: 块摘要");
+        close(fd);
+        return -1;
+    }
+
+    thread_pool_parallel_for(g_hash_pool, count, tree_hash_block, &ctx);
+    close(fd);
+
+    if (ctx.failed) {
+        free(ctx.digests);
+        return -1;
+    }
+
+    // 合并块摘要得到根摘要
+    unsigned char root[MAX_DIGEST_LENGTH];
+    const unsigned char prefix = 0x01;
+    DigestCtx *mdctx = digest_ctx_new(algo);
+    if (!mdctx ||
+        digest_init(mdctx) != 0 ||
+        digest_update(mdctx, &prefix, 1) != 0 ||
+        digest_update(mdctx, ctx.digests, count * engine->digest_len) != 0 ||
+        digest_final(mdctx, root) != 0) {
+        log_msg(LOG_ERROR, "计算根摘要失败");
+        digest_ctx_free(mdctx);
+        free(ctx.digests);
+        return -1;
+    }
+    digest_ctx_free(mdctx);
+
+    digest_set(digest, root, engine->digest_len, block_size);
+
+    if (block_count) *block_count = count;
+    if (block_digests) {
+        *block_digests = ctx.digests;
+    } else {
+        free(ctx.digests);
+    }
+    return 0;
+}
+
+// 打开块摘要记录文件
+int block_log_open(const char *path) {
+    pthread_mutex_lock(&block_log_lock);
+    block_log_fp = fopen(path, "w");
+    pthread_mutex_unlock(&block_log_lock);
+    if (!block_log_fp) {
+        log_msg(LOG_ERROR, "无法创建块摘要文件 '%s': %s", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// 追加一个文件的块摘要，每行格式: <块序号> <块摘要hex> *<相对路径>
+void block_log_append(const char *rel_path, const unsigned char *digests, size_t count,
+                      size_t digest_len) {
+    char hex[MAX_DIGEST_LENGTH * 2 + 1];
+
+    pthread_mutex_lock(&block_log_lock);
+    if (block_log_fp) {
+        for (size_t i = 0; i < count; i++) {
+            digest_to_hex(digests + i * digest_len, digest_len, hex);
+            fprintf(block_log_fp, "%zu %s *%s\n", i, hex, rel_path);
+        }
+    }
+    pthread_mutex_unlock(&block_log_lock);
+}
+
+int block_log_close(void) {
+    int result = 0;
+    pthread_mutex_lock(&block_log_lock);
+    if (block_log_fp) {
+        result = fclose(block_log_fp) == 0 ? 0 : -1;
+        block_log_fp = NULL;
+    }
+    pthread_mutex_unlock(&block_log_lock);
+    return result;
+}
+
+// 验证时的块摘要文件：首个损坏文件触发加载，之后所有文件共用，验证结束时由 block_list_free 释放
+// 记录按 (路径, 块序号) 排序；同一文件的各行相邻写出，相邻记录共享一份路径字符串
+typedef struct {
+    const char *path;
+    size_t index;
+    unsigned char digest[MAX_DIGEST_LENGTH];
+} BlockRecord;
+
+static BlockRecord *block_records = NULL;
+static size_t block_record_count = 0;
+static char **block_paths = NULL;         // 记录引用的路径字符串
+static size_t block_path_count = 0;
+static int block_list_loaded = 0;
+static pthread_mutex_t block_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int compare_block_record(const void *a, const void *b) {
+    const BlockRecord *ra = (const BlockRecord *)a;
+    const BlockRecord *rb = (const BlockRecord *)b;
+    int cmp = strcmp(ra->path, rb->path);
+    if (cmp != 0) return cmp;
+    return ra->index < rb->index ? -1 : ra->index > rb->index;
+}
+
+// 读入整个块摘要文件 (调用方持有 block_list_lock)；格式不符的行跳过
+static void block_list_load_locked(size_t digest_len) {
+    block_list_loaded = 1;
+    FILE *fp = fopen(config.block_list_path, "r");
+    if (!fp) {
+        log_msg(LOG_WARN, "无法打开块摘要文件 '%s': %s", config.block_list_path, strerror(errno));
+        return;
+    }
+
+    char line[MAX_PATH + MAX_DIGEST_LENGTH * 2 + 32];
+    char hex[MAX_DIGEST_LENGTH * 2 + 1];
+    char path[MAX_PATH];
+    size_t index;
+    size_t capacity = 0;
+    size_t path_capacity = 0;
+    const char *last_path = NULL;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%zu %64s *%4095[^\n]", &index, hex, path) != 3) continue;
+        if (strlen(hex) != digest_len * 2) continue;
+
+        if (block_record_count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 1024;
+            BlockRecord *grown = realloc(block_records, new_capacity * sizeof(BlockRecord));
+            if (!grown) break;
+            block_records = grown;
+            capacity = new_capacity;
+        }
+        BlockRecord *rec = &block_records[block_record_count];
+        if (digest_from_hex(hex, digest_len, rec->digest) != 0) continue;
+        if (!last_path || strcmp(last_path, path) != 0) {
+            if (block_path_count == path_capacity) {
+                size_t new_capacity = path_capacity ? path_capacity * 2 : 256;
+                char **grown = realloc(block_paths, new_capacity * sizeof(char *));
+                if (!grown) break;
+                block_paths = grown;
+                path_capacity = new_capacity;
+            }
+            char *copy = strdup(path);
+            if (!copy) break;
+            block_paths[block_path_count++] = copy;
+            last_path = copy;
+        }
+        rec->path = last_path;
+        rec->index = index;
+        block_record_count++;
+    }
+    fclose(fp);
+    qsort(block_records, block_record_count, sizeof(BlockRecord), compare_block_record);
+}
+
+// 验证结束后释放块摘要记录
+void block_list_free(void) {
+    pthread_mutex_lock(&block_list_lock);
+    for (size_t i = 0; i < block_path_count; i++) free(block_paths[i]);
+    free(block_paths);
+    block_paths = NULL;
+    block_path_count = 0;
+    free(block_records);
+    block_records = NULL;
+    block_record_count = 0;
+    block_list_loaded = 0;
+    pthread_mutex_unlock(&block_list_lock);
+}
+
+// 与块摘要文件比对，报告损坏的字节区间
+static void report_corrupt_blocks(const char *rel_path, const unsigned char *digests,
+                                  size_t count, size_t digest_len, size_t block_size, off_t file_size) {
+    if (!config.block_list_path) {
+        log_msg(LOG_WARN, "未找到块摘要文件，无法定位损坏区间: %s", rel_path);
+        return;
+    }
+
+    pthread_mutex_lock(&block_list_lock);
+    if (!block_list_loaded) block_list_load_locked(digest_len);
+    pthread_mutex_unlock(&block_list_lock);
+
+    // 该文件的记录区间 [lo, hi)
+    size_t lo = 0;
+    size_t hi = block_record_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(block_records[mid].path, rel_path) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    hi = lo;
+    while (hi < block_record_count && strcmp(block_records[hi].path, rel_path) == 0) hi++;
+    if (lo == hi) {
+        log_msg(LOG_WARN, "块摘要文件中没有 %s 的记录", rel_path);
+        return;
+    }
+
+    // 期望块摘要按实际块数排列 (摘要字节 + 是否存在标记)；块序号来自块摘要文件，
+    // 不小于实际块数的记录只说明文件变短了，不据此分配
+    size_t stride = digest_len + 1;
+    unsigned char *expected = calloc(count ? count : 1, stride);
+    if (!expected) {
+        log_msg(LOG_ERROR, "内存分配失败: 块摘要比对");
+        return;
+    }
+    size_t expected_count = 0;
+    for (size_t r = lo; r < hi; r++) {
+        const BlockRecord *rec = &block_records[r];
+        size_t needed = rec->index < SIZE_MAX ? rec->index + 1 : SIZE_MAX;
+        if (needed > expected_count) expected_count = needed;
+        if (rec->index >= count) continue;
+        unsigned char *entry = expected + rec->index * stride;
+        memcpy(entry, rec->digest, digest_len);
+        entry[digest_len] = 1;
+    }
+
+    if (expected_count != count) {
+        log_msg(LOG_ERROR, "  块数不一致: %s 期望 %zu 块，实际 %zu 块", rel_path, expected_count, count);
+    }
+
+    // 合并连续的损坏块为区间 (块摘要文件中没有记录的块也算损坏)
+    size_t run_start = 0;
+    int in_run = 0;
+    for (size_t i = 0; i <= count; i++) {
+        int bad = 0;
+        if (i < count) {
+            const unsigned char *entry = expected + i * stride;
+            bad = !entry[digest_len] || memcmp(entry, digests + i * digest_len, digest_len) != 0;
+        }
+
+        if (bad && !in_run) {
+            run_start = i;
+            in_run = 1;
+        } else if (!bad && in_run) {
+            unsigned long long start = (unsigned long long)run_start * block_size;
+            unsigned long long end = (unsigned long long)i * block_size;
+            if (end > (unsigned long long)file_size) end = file_size;
+            log_msg(LOG_ERROR, "  损坏区间: %s 字节 [%llu, %llu) (块 %zu-%zu)",
+                    rel_path, start, end, run_start, i - 1);
+            in_run = 0;
+        }
+    }
+    if (expected_count > count) {
+        log_msg(LOG_ERROR, "  缺少块: %s 字节 %llu 之后 (块 %zu-%zu)", rel_path,
+                (unsigned long long)file_size, count, expected_count - 1);
+    }
+
+    free(expected);
+}
+
+// 按树哈希验证文件，失败时定位损坏的块
+static FileStatus verify_tree_file(const char *file_path, const char *rel_path,
+                                   const Digest *expected, DigestAlgo algo, off_t file_size) {
+    size_t block_size = expected->tree_block_size;
+    Digest actual;
+    unsigned char *digests = NULL;
+    size_t count = 0;
+
+    if (compute_tree_hash(file_path, algo, block_size, &actual, &digests, &count) != 0) {
+        return FILE_STATUS_ERROR;
+    }
+
+    FileStatus status = FILE_STATUS_VALID;
+    if (!digest_equal(&actual, expected)) {
+        status = FILE_STATUS_CORRUPT;
+        report_corrupt_blocks(rel_path, digests, count, digest_engine_get(algo)->digest_len,
+                              block_size, file_size);
+    }
+
+    free(digests);
+    return status;
+}
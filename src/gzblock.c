@@ -0,0 +1,472 @@
+#include "gzblock.h"
+#include "config.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+int gzblock_detect(const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+    return p && size >= 2 && p[0] == 0x1f && p[1] == 0x8b;
+}
+
+#ifdef HAVE_ZLIB
+
+int gzblock_available(void) {
+    return 1;
+}
+
+static void put_u16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint16_t get_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+// 不产生输出的 gzip 成员：头部带一个附加子字段，数据为空的 deflate 流，CRC 与长度均为 0
+static const unsigned char empty_member_head[10] = { 0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff };
+static const unsigned char empty_member_tail[10] = { 0x03, 0x00, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+static int write_empty_member(FILE *fp, char id2, const unsigned char *data, size_t len) {
+    unsigned char extra[6];
+    put_u16(extra, (uint16_t)(len + 4));
+    extra[2] = 'M';
+    extra[3] = (unsigned char)id2;
+    put_u16(extra + 4, (uint16_t)len);
+    return fwrite(empty_member_head, 1, sizeof(empty_member_head), fp) == sizeof(empty_member_head) &&
+           fwrite(extra, 1, sizeof(extra), fp) == sizeof(extra) &&
+           fwrite(data, 1, len, fp) == len &&
+           fwrite(empty_member_tail, 1, sizeof(empty_member_tail), fp) == sizeof(empty_member_tail) ? 0 : -1;
+}
+
+// 解析 *pos 处的空成员，返回子字段数据；格式不符时返回 NULL
+static const unsigned char* read_empty_member(const GzBlockIndex *index, size_t *pos, char id2, size_t *len) {
+    size_t p = *pos;
+    if (p > index->size || index->size - p < sizeof(empty_member_head) + 6) return NULL;
+    const unsigned char *head = index->data + p;
+    if (memcmp(head, empty_member_head, 4) != 0) return NULL;
+    size_t xlen = get_u16(head + 10);
+    size_t sub_len = get_u16(head + 14);
+    if (head[12] != 'M' || head[13] != (unsigned char)id2 || xlen != sub_len + 4) return NULL;
+    size_t total = sizeof(empty_member_head) + 6 + sub_len + sizeof(empty_member_tail);
+    if (index->size - p < total) return NULL;
+    *len = sub_len;
+    *pos = p + total;
+    return head + 16;
+}
+
+// 读取尾部与块索引；只检查结构，块内容在解压时由 gzip 的 CRC 校验
+int gzblock_open(GzBlockIndex *index, const void *data, size_t size) {
+    memset(index, 0, sizeof(GzBlockIndex));
+    index->data = (const unsigned char *)data;
+    index->size = size;
+
+    size_t pos = size >= GZBLOCK_FOOTER_SIZE ? size - GZBLOCK_FOOTER_SIZE : size;
+    size_t len = 0;
+    const unsigned char *footer = read_empty_member(index, &pos, 'F', &len);
+    if (!footer || len != GZBLOCK_FOOTER_DATA || pos != size) {
+        log_msg(LOG_ERROR, "不是分块压缩清单 (缺少块索引)，请先用 zcat 解压");
+        return -1;
+    }
+    uint64_t index_offset = get_u64(footer);
+    uint64_t block_count = get_u64(footer + 8);
+    index->entry_count = get_u64(footer + 16);
+    index->sorted = (get_u64(footer + 24) & GZBLOCK_FLAG_SORTED) != 0;
+
+    // 每个块索引项至少 18 字节
+    if (index_offset > size - GZBLOCK_FOOTER_SIZE || block_count > size / 18) {
+        log_msg(LOG_ERROR, "压缩清单的块索引损坏");
+        return -1;
+    }
+    index->blocks = calloc(block_count ? block_count : 1, sizeof(GzBlock));
+    if (!index->blocks) {
+        log_msg(LOG_ERROR, "内存分配失败: 压缩清单块索引");
+        return -1;
+    }
+
+    pos = (size_t)index_offset;
+    size_t end = size - GZBLOCK_FOOTER_SIZE;
+    while (pos < end && index->block_count < block_count) {
+        const unsigned char *p = read_empty_member(index, &pos, 'I', &len);
+        if (!p || pos > end) break;
+        const unsigned char *q = p + len;
+        while (p + 18 <= q && index->block_count < block_count) {
+            GzBlock *block = &index->blocks[index->block_count];
+            block->offset = get_u64(p);
+            block->csize = get_u32(p + 8);
+            block->usize = get_u32(p + 12);
+            block->first_path_len = get_u16(p + 16);
+            block->first_path = (const char *)p + 18;
+            p += 18 + block->first_path_len;
+            // 写出时每块不超过 GZBLOCK_SIZE，读取缓冲区按 max_usize 分配，超出的一律视为损坏
+            if (p > q || block->offset > index_offset || block->csize > index_offset - block->offset ||
+                block->usize > GZBLOCK_SIZE) {
+                p = NULL;
+                break;
+            }
+            if (block->usize > index->max_usize) index->max_usize = block->usize;
+            index->block_count++;
+        }
+        if (!p) break;
+    }
+    if (index->block_count != block_count) {
+        log_msg(LOG_ERROR, "压缩清单的块索引损坏");
+        gzblock_close(index);
+        return -1;
+    }
+    return 0;
+}
+
+// 解压第 block 块到 out (至少 usize 字节)；各块独立，可在多个线程中同时调用
+int gzblock_inflate(const GzBlockIndex *index, size_t block, char *out) {
+    const GzBlock *b = &index->blocks[block];
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) return -1;
+
+    zs.next_in = (Bytef *)(index->data + b->offset);
+    zs.avail_in = b->csize;
+    zs.next_out = (Bytef *)out;
+    zs.avail_out = b->usize;
+    int ret = inflate(&zs, Z_FINISH);
+    int ok = ret == Z_STREAM_END && zs.total_out == b->usize;
+    inflateEnd(&zs);
+    if (!ok) {
+        log_msg(LOG_ERROR, "压缩清单第 %zu 块损坏", block);
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_path(const char *a, size_t a_len, const char *b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) return cmp;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+// 可能包含 path 的块：最后一个首路径不大于 path 的块 (仅对有序清单有意义)
+size_t gzblock_find(const GzBlockIndex *index, const char *path, size_t len) {
+    size_t lo = 0;
+    size_t hi = index->block_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const GzBlock *b = &index->blocks[mid];
+        if (compare_path(b->first_path, b->first_path_len, path, len) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
+
+void gzblock_close(GzBlockIndex *index) {
+    if (!index) return;
+    free(index->blocks);
+    index->blocks = NULL;
+    index->block_count = 0;
+}
+
+// 写出时的块索引项 (首路径单独分配)
+typedef struct {
+    uint64_t offset;
+    uint32_t csize;
+    uint32_t usize;
+    char *first_path;
+    uint16_t first_path_len;
+} GzBlockEntry;
+
+// 主线程填充 fill 缓冲区，写满后与 busy 交换，由后台线程压缩并写出
+struct GzBlockWriter {
+    FILE *fp;
+    char *fill;
+    size_t fill_len;
+    char first_path[MAX_PATH];     // fill 中首个条目的路径
+    size_t first_path_len;
+    int has_path;
+    char prev_path[MAX_PATH];
+    size_t prev_path_len;
+    int sorted;
+    uint64_t entries;
+    uint64_t total;
+
+    char *busy;
+    size_t busy_len;
+    size_t busy_block;
+    int pending;                   // busy 待压缩
+    int stop;
+    int error;
+    uint64_t offset;               // 已写出的字节数
+    GzBlockEntry *blocks;
+    size_t block_count;
+    size_t block_capacity;
+
+    z_stream zs;
+    unsigned char *out;
+    size_t out_size;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+// 压缩一块为独立的 gzip 成员
+static int compress_block(GzBlockWriter *writer, const char *data, size_t len, size_t *csize) {
+    if (deflateReset(&writer->zs) != Z_OK) return -1;
+    writer->zs.next_in = (Bytef *)data;
+    writer->zs.avail_in = (uInt)len;
+    writer->zs.next_out = writer->out;
+    writer->zs.avail_out = (uInt)writer->out_size;
+    if (deflate(&writer->zs, Z_FINISH) != Z_STREAM_END) return -1;
+    *csize = writer->out_size - writer->zs.avail_out;
+    return 0;
+}
+
+static void* compress_thread(void *arg) {
+    GzBlockWriter *writer = (GzBlockWriter *)arg;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (!writer->pending && !writer->stop) pthread_cond_wait(&writer->cond, &writer->lock);
+        if (!writer->pending) break;
+        const char *data = writer->busy;
+        size_t len = writer->busy_len;
+        size_t block = writer->busy_block;
+        pthread_mutex_unlock(&writer->lock);
+
+        size_t csize = 0;
+        int failed = compress_block(writer, data, len, &csize) != 0 ||
+                     fwrite(writer->out, 1, csize, writer->fp) != csize;
+
+        pthread_mutex_lock(&writer->lock);
+        writer->blocks[block].offset = writer->offset;
+        writer->blocks[block].csize = (uint32_t)csize;
+        writer->blocks[block].usize = (uint32_t)len;
+        writer->offset += csize;
+        if (failed) writer->error = 1;
+        writer->pending = 0;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+GzBlockWriter* gzblock_writer_open(FILE *fp) {
+    GzBlockWriter *writer = calloc(1, sizeof(GzBlockWriter));
+    if (!writer) return NULL;
+    writer->fp = fp;
+    writer->sorted = 1;
+
+    if (deflateInit2(&writer->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(writer);
+        return NULL;
+    }
+    writer->out_size = deflateBound(&writer->zs, GZBLOCK_SIZE);
+    writer->fill = malloc(GZBLOCK_SIZE);
+    writer->busy = malloc(GZBLOCK_SIZE);
+    writer->out = malloc(writer->out_size);
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    if (!writer->fill || !writer->busy || !writer->out ||
+        pthread_create(&writer->thread, NULL, compress_thread, writer) != 0) {
+        deflateEnd(&writer->zs);
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->cond);
+        free(writer->fill);
+        free(writer->busy);
+        free(writer->out);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+// 把写满的 fill 交给后台线程 (等待上一块压缩完成)
+static int submit_block(GzBlockWriter *writer) {
+    if (writer->fill_len == 0) return 0;
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->pending) pthread_cond_wait(&writer->cond, &writer->lock);
+    if (!writer->error && writer->block_count == writer->block_capacity) {
+        size_t capacity = writer->block_capacity ? writer->block_capacity * 2 : 64;
+        GzBlockEntry *blocks = realloc(writer->blocks, capacity * sizeof(GzBlockEntry));
+        if (blocks) {
+            writer->blocks = blocks;
+            writer->block_capacity = capacity;
+        } else {
+            writer->error = 1;
+        }
+    }
+    char *path = writer->error ? NULL : malloc(writer->first_path_len + 1);
+    if (!path) writer->error = 1;
+    if (writer->error) {
+        pthread_mutex_unlock(&writer->lock);
+        return -1;
+    }
+    memcpy(path, writer->first_path, writer->first_path_len);
+    GzBlockEntry *entry = &writer->blocks[writer->block_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->first_path = path;
+    entry->first_path_len = (uint16_t)writer->first_path_len;
+
+    char *swap = writer->busy;
+    writer->busy = writer->fill;
+    writer->busy_len = writer->fill_len;
+    writer->busy_block = writer->block_count++;
+    writer->fill = swap;
+    writer->fill_len = 0;
+    writer->has_path = 0;
+    writer->first_path_len = 0;
+    writer->pending = 1;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    return 0;
+}
+
+// 追加一行 (含换行符)；path 为该行条目的路径，清单头等非条目行传 NULL
+int gzblock_writer_add(GzBlockWriter *writer, const char *line, size_t len, const char *path, size_t path_len) {
+    if (len > GZBLOCK_SIZE || path_len >= MAX_PATH) return -1;
+    if (writer->fill_len + len > GZBLOCK_SIZE && submit_block(writer) != 0) return -1;
+
+    if (path) {
+        if (!writer->has_path) {
+            memcpy(writer->first_path, path, path_len);
+            writer->first_path_len = path_len;
+            writer->has_path = 1;
+        }
+        if (writer->entries > 0 &&
+            compare_path(path, path_len, writer->prev_path, writer->prev_path_len) < 0) {
+            writer->sorted = 0;
+        }
+        memcpy(writer->prev_path, path, path_len);
+        writer->prev_path_len = path_len;
+        writer->entries++;
+    }
+    memcpy(writer->fill + writer->fill_len, line, len);
+    writer->fill_len += len;
+    writer->total += len;
+    return 0;
+}
+
+// 写出剩余的块、块索引与尾部，释放写出器 (不关闭文件)
+int gzblock_writer_close(GzBlockWriter *writer) {
+    if (!writer) return -1;
+
+    int failed = submit_block(writer) != 0;
+    pthread_mutex_lock(&writer->lock);
+    writer->stop = 1;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    failed = failed || writer->error;
+
+    // 块索引按 GZBLOCK_INDEX_CHUNK 分成多个空成员
+    uint64_t index_offset = writer->offset;
+    unsigned char *chunk = failed ? NULL : malloc(GZBLOCK_INDEX_CHUNK);
+    size_t chunk_len = 0;
+    failed = failed || !chunk;
+    for (size_t i = 0; i < writer->block_count && !failed; i++) {
+        const GzBlockEntry *b = &writer->blocks[i];
+        if (chunk_len + 18 + b->first_path_len > GZBLOCK_INDEX_CHUNK) {
+            failed = write_empty_member(writer->fp, 'I', chunk, chunk_len) != 0;
+            chunk_len = 0;
+        }
+        put_u64(chunk + chunk_len, b->offset);
+        put_u32(chunk + chunk_len + 8, b->csize);
+        put_u32(chunk + chunk_len + 12, b->usize);
+        put_u16(chunk + chunk_len + 16, b->first_path_len);
+        memcpy(chunk + chunk_len + 18, b->first_path, b->first_path_len);
+        chunk_len += 18 + b->first_path_len;
+    }
+    if (!failed && chunk_len > 0) failed = write_empty_member(writer->fp, 'I', chunk, chunk_len) != 0;
+    free(chunk);
+
+    unsigned char footer[GZBLOCK_FOOTER_DATA];
+    put_u64(footer, index_offset);
+    put_u64(footer + 8, writer->block_count);
+    put_u64(footer + 16, writer->entries);
+    put_u64(footer + 24, writer->sorted ? GZBLOCK_FLAG_SORTED : 0);
+    put_u64(footer + 32, writer->total);
+    if (!failed) failed = write_empty_member(writer->fp, 'F', footer, sizeof(footer)) != 0;
+
+    for (size_t i = 0; i < writer->block_count; i++) free(writer->blocks[i].first_path);
+    free(writer->blocks);
+    deflateEnd(&writer->zs);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer->fill);
+    free(writer->busy);
+    free(writer->out);
+    free(writer);
+    return failed ? -1 : 0;
+}
+
+#else // !HAVE_ZLIB
+
+int gzblock_available(void) {
+    return 0;
+}
+
+int gzblock_open(GzBlockIndex *index, const void *data, size_t size) {
+    memset(index, 0, sizeof(GzBlockIndex));
+    (void)data;
+    (void)size;
+    log_msg(LOG_ERROR, "当前构建不支持压缩清单 (编译时未找到 zlib)");
+    return -1;
+}
+
+int gzblock_inflate(const GzBlockIndex *index, size_t block, char *out) {
+    (void)index;
+    (void)block;
+    (void)out;
+    return -1;
+}
+
+size_t gzblock_find(const GzBlockIndex *index, const char *path, size_t len) {
+    (void)index;
+    (void)path;
+    (void)len;
+    return 0;
+}
+
+void gzblock_close(GzBlockIndex *index) {
+    (void)index;
+}
+
+GzBlockWriter* gzblock_writer_open(FILE *fp) {
+    (void)fp;
+    return NULL;
+}
+
+int gzblock_writer_add(GzBlockWriter *writer, const char *line, size_t len, const char *path, size_t path_len) {
+    (void)writer;
+    (void)line;
+    (void)len;
+    (void)path;
+    (void)path_len;
+    return -1;
+}
+
+int gzblock_writer_close(GzBlockWriter *writer) {
+    (void)writer;
+    return -1;
+}
+
+#endif // HAVE_ZLIB
@@ -0,0 +1,261 @@
+#include "hash_cache.h"
+#include "config.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+extern Config config;
+
+// 上次运行留下的缓存 (只读映射)
+static const char *cache_path = NULL;
+static void *cache_map = NULL;
+static size_t cache_map_size = 0;
+static const HashCacheRecord *old_records = NULL;
+static size_t old_count = 0;
+static unsigned char *old_seen = NULL;  // 本次命中的旧记录位图
+
+// 本次新计算的条目
+static HashCacheRecord *fresh_records = NULL;
+static size_t fresh_count = 0;
+static size_t fresh_capacity = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t session_start = 0;
+static size_t cache_hits = 0;
+static size_t cache_misses = 0;
+
+static int64_t timespec_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static int compare_record_key(const void *a, const void *b) {
+    const HashCacheRecord *ra = (const HashCacheRecord *)a;
+    const HashCacheRecord *rb = (const HashCacheRecord *)b;
+    if (ra->dev != rb->dev) return ra->dev < rb->dev ? -1 : 1;
+    if (ra->ino != rb->ino) return ra->ino < rb->ino ? -1 : 1;
+    return 0;
+}
+
+// 打开缓存文件；文件不存在或格式不符时从空缓存开始
+int hash_cache_open(const char *path) {
+    if (!path) return -1;
+
+    cache_path = path;
+    session_start = time(NULL);
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            log_msg(LOG_WARN, "无法打开哈希缓存 '%s': %s，将重建", path, strerror(errno));
+        }
+        return 0;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(HashCacheHeader)) {
+        close(fd);
+        log_msg(LOG_WARN, "哈希缓存 '%s' 无效，将重建", path);
+        return 0;
+    }
+
+    void *map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_msg(LOG_WARN, "无法映射哈希缓存 '%s': %s，将重建", path, strerror(errno));
+        return 0;
+    }
+
+    const HashCacheHeader *header = (const HashCacheHeader *)map;
+    if (memcmp(header->magic, HASH_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != HASH_CACHE_VERSION ||
+        header->record_size != sizeof(HashCacheRecord) ||
+        header->count != ((size_t)sb.st_size - sizeof(HashCacheHeader)) / sizeof(HashCacheRecord)) {
+        munmap(map, sb.st_size);
+        log_msg(LOG_WARN, "哈希缓存 '%s' 格式不符，将重建", path);
+        return 0;
+    }
+
+    cache_map = map;
+    cache_map_size = sb.st_size;
+    old_records = (const HashCacheRecord *)((const char *)map + sizeof(HashCacheHeader));
+    old_count = header->count;
+    old_seen = calloc((old_count + 7) / 8, 1);
+    if (!old_seen && old_count > 0) {
+        munmap(map, sb.st_size);
+        cache_map = NULL;
+        old_records = NULL;
+        old_count = 0;
+        return -1;
+    }
+
+    posix_madvise(map, sb.st_size, POSIX_MADV_RANDOM);
+    log_msg(LOG_INFO, "已加载哈希缓存: %s (%zu 条)", path, old_count);
+    return 0;
+}
+
+// 按 (dev, ino) 查找，大小/mtime/ctime/算法全部一致才算命中
+int hash_cache_lookup(const struct stat *sb, DigestAlgo algo, Digest *digest) {
+    if (!cache_path || !sb || !digest) return 0;
+
+    HashCacheRecord key;
+    key.dev = sb->st_dev;
+    key.ino = sb->st_ino;
+
+    const HashCacheRecord *rec = NULL;
+    if (!config.rehash && old_count > 0) {
+        rec = bsearch(&key, old_records, old_count, sizeof(HashCacheRecord), compare_record_key);
+    }
+
+    if (!rec ||
+        rec->size != (uint64_t)sb->st_size ||
+        rec->mtime_ns != timespec_ns(&sb->st_mtim) ||
+        rec->ctime_ns != timespec_ns(&sb->st_ctim) ||
+        rec->algo != (uint8_t)algo ||
+        rec->len != digest_engine_get(algo)->digest_len) {
+        pthread_mutex_lock(&cache_lock);
+        cache_misses++;
+        pthread_mutex_unlock(&cache_lock);
+        return 0;
+    }
+
+    size_t index = rec - old_records;
+    __atomic_fetch_or(&old_seen[index / 8], (unsigned char)(1u << (index % 8)), __ATOMIC_RELAXED);
+    digest_set(digest, rec->digest, rec->len, 0);
+
+    pthread_mutex_lock(&cache_lock);
+    cache_hits++;
+    pthread_mutex_unlock(&cache_lock);
+    return 1;
+}
+
+// 记录新计算的摘要；本次运行期间刚修改的文件可能仍在变化，不写入缓存
+void hash_cache_store(const struct stat *sb, DigestAlgo algo, const Digest *digest) {
+    if (!cache_path || !sb || !digest || digest->tree_block_size != 0) return;
+    if (sb->st_mtim.tv_sec >= session_start - 1 || sb->st_ctim.tv_sec >= session_start - 1) return;
+
+    HashCacheRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.dev = sb->st_dev;
+    rec.ino = sb->st_ino;
+    rec.size = sb->st_size;
+    rec.mtime_ns = timespec_ns(&sb->st_mtim);
+    rec.ctime_ns = timespec_ns(&sb->st_ctim);
+    rec.last_seen = session_start;
+    rec.algo = (uint8_t)algo;
+    rec.len = digest->len;
+    memcpy(rec.digest, digest->bytes, digest->len);
+
+    pthread_mutex_lock(&cache_lock);
+    if (fresh_count == fresh_capacity) {
+        size_t new_capacity = fresh_capacity ? fresh_capacity * 2 : 1024;
+        HashCacheRecord *grown = realloc(fresh_records, new_capacity * sizeof(HashCacheRecord));
+        if (!grown) {
+            pthread_mutex_unlock(&cache_lock);
+            return;
+        }
+        fresh_records = grown;
+        fresh_capacity = new_capacity;
+    }
+    fresh_records[fresh_count++] = rec;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+// 合并旧记录与新记录写入临时文件后原子替换；
+// 旧记录本次命中则刷新 last_seen，未命中且超过 --cache-max-age 的被淘汰
+static int hash_cache_save(void) {
+    char temp_path[MAX_PATH];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp.%d", cache_path, getpid());
+
+    FILE *fp = fopen(temp_path, "wb");
+    if (!fp) {
+        log_msg(LOG_ERROR, "无法写入哈希缓存 '%s': %s", temp_path, strerror(errno));
+        return -1;
+    }
+
+    HashCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HASH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = HASH_CACHE_VERSION;
+    header.record_size = sizeof(HashCacheRecord);
+    fwrite(&header, sizeof(header), 1, fp);
+
+    qsort(fresh_records, fresh_count, sizeof(HashCacheRecord), compare_record_key);
+
+    size_t i = 0, j = 0, written = 0, expired = 0;
+    HashCacheRecord touched;
+    HashCacheRecord last = { 0 };
+    int have_last = 0;
+    while (i < old_count || j < fresh_count) {
+        const HashCacheRecord *rec;
+        int from_old;
+        if (j >= fresh_count || (i < old_count && compare_record_key(&old_records[i], &fresh_records[j]) < 0)) {
+            rec = &old_records[i];
+            from_old = 1;
+        } else {
+            // 键相同时新记录优先
+            if (i < old_count && compare_record_key(&old_records[i], &fresh_records[j]) == 0) i++;
+            rec = &fresh_records[j++];
+            from_old = 0;
+        }
+
+        if (from_old) {
+            size_t index = i++;
+            if (old_seen[index / 8] & (1u << (index % 8))) {
+                touched = *rec;
+                touched.last_seen = session_start;
+                rec = &touched;
+            } else if (config.cache_max_age >= 0 && session_start - rec->last_seen > config.cache_max_age) {
+                expired++;
+                continue;
+            }
+        }
+
+        if (have_last && compare_record_key(&last, rec) == 0) continue; // 同一 inode 多次写入 (硬链接)
+        if (fwrite(rec, sizeof(HashCacheRecord), 1, fp) != 1) break;
+        written++;
+        last.dev = rec->dev;
+        last.ino = rec->ino;
+        have_last = 1;
+    }
+
+    header.count = written;
+    int failed = ferror(fp) || fseek(fp, 0, SEEK_SET) != 0 ||
+                 fwrite(&header, sizeof(header), 1, fp) != 1 ||
+                 fflush(fp) != 0 || fsync(fileno(fp)) != 0;
+    failed |= fclose(fp) != 0;
+    if (failed || rename(temp_path, cache_path) != 0) {
+        log_msg(LOG_ERROR, "无法保存哈希缓存 '%s': %s", cache_path, strerror(errno));
+        unlink(temp_path);
+        return -1;
+    }
+
+    log_msg(LOG_INFO, "哈希缓存: 命中 %zu，重新计算 %zu，保存 %zu 条 (淘汰 %zu 条)",
+            cache_hits, cache_misses, written, expired);
+    return 0;
+}
+
+int hash_cache_close(int save) {
+    if (!cache_path) return 0;
+
+    int result = save ? hash_cache_save() : 0;
+
+    if (cache_map) munmap(cache_map, cache_map_size);
+    free(old_seen);
+    free(fresh_records);
+    cache_map = NULL;
+    cache_map_size = 0;
+    old_records = NULL;
+    old_count = 0;
+    old_seen = NULL;
+    fresh_records = NULL;
+    fresh_count = fresh_capacity = 0;
+    cache_path = NULL;
+    return result;
+}
@@ -0,0 +1,157 @@
+#include "ignore.h"
+#include "config.h"
+#include "logging.h"
+#include "pattern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+extern Config config;
+
+// 单条规则
+typedef struct {
+    char *pattern;                 // 通配模式 (已去掉 !、开头和结尾的 /)
+    size_t len;
+    int negate;                    // ! 开头：重新包含
+    int dir_only;                  // / 结尾：只匹配目录
+    int anchored;                  // 含 '/'：相对忽略文件所在目录匹配；否则匹配任一层级的名称
+} IgnoreRule;
+
+struct IgnoreRules {
+    IgnoreRules *parent;
+    int refcount;
+    char *base;                    // 忽略文件所在目录 (相对扫描根目录，根目录为空串)
+    size_t base_len;
+    IgnoreRule *rules;
+    size_t count;
+};
+
+IgnoreRules* ignore_rules_ref(IgnoreRules *rules) {
+    if (rules) __atomic_add_fetch(&rules->refcount, 1, __ATOMIC_RELAXED);
+    return rules;
+}
+
+void ignore_rules_release(IgnoreRules *rules) {
+    while (rules && __atomic_sub_fetch(&rules->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        IgnoreRules *parent = rules->parent;
+        for (size_t i = 0; i < rules->count; i++) {
+            free(rules->rules[i].pattern);
+        }
+        free(rules->rules);
+        free(rules->base);
+        free(rules);
+        rules = parent;
+    }
+}
+
+// 解析一行规则；空行、注释与无效行返回 0
+static int parse_rule(char *line, IgnoreRule *rule) {
+    size_t len = strcspn(line, "\r\n");
+    // 行尾空格忽略，除非以 \ 转义
+    while (len > 0 && line[len - 1] == ' ' && !(len >= 2 && line[len - 2] == '\\')) len--;
+    line[len] = '\0';
+    if (len == 0 || line[0] == '#') return 0;
+
+    char *p = line;
+    rule->negate = 0;
+    if (*p == '!') {
+        rule->negate = 1;
+        p++;
+    } else if (p[0] == '\\' && (p[1] == '!' || p[1] == '#')) {
+        p++;
+    }
+
+    size_t n = strlen(p);
+    rule->dir_only = n > 0 && p[n - 1] == '/';
+    if (rule->dir_only) p[--n] = '\0';
+    rule->anchored = strchr(p, '/') != NULL;
+    if (*p == '/') {
+        p++;
+        n--;
+    }
+    if (n == 0) return 0;
+
+    rule->pattern = strdup(p);
+    rule->len = n;
+    return rule->pattern != NULL;
+}
+
+// 读取 dir_fd 下的忽略文件，返回该目录生效的规则 (无忽略文件时即为上级规则的新引用)
+IgnoreRules* ignore_rules_load(IgnoreRules *parent, int dir_fd, const char *rel_dir) {
+    int fd = openat(dir_fd, IGNORE_FILE_NAME, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            log_msg(LOG_WARN, "无法读取忽略文件 '%s%s%s': %s", rel_dir, *rel_dir ? "/" : "",
+                    IGNORE_FILE_NAME, strerror(errno));
+        }
+        return ignore_rules_ref(parent);
+    }
+    FILE *fp = fdopen(fd, "r");
+    IgnoreRules *rules = fp ? calloc(1, sizeof(IgnoreRules)) : NULL;
+    if (!rules) {
+        if (fp) fclose(fp);
+        else close(fd);
+        log_msg(LOG_WARN, "内存分配失败: 忽略规则 (%s)", rel_dir);
+        return ignore_rules_ref(parent);
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    size_t capacity = 0;
+    while (getline(&line, &line_size, fp) != -1) {
+        IgnoreRule rule;
+        if (!parse_rule(line, &rule)) continue;
+        if (rules->count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 8;
+            IgnoreRule *grown = realloc(rules->rules, new_capacity * sizeof(IgnoreRule));
+            if (!grown) {
+                free(rule.pattern);
+                break;
+            }
+            rules->rules = grown;
+            capacity = new_capacity;
+        }
+        rules->rules[rules->count++] = rule;
+    }
+    free(line);
+    fclose(fp);
+
+    rules->base = strdup(rel_dir);
+    if (rules->count == 0 || !rules->base) {
+        rules->refcount = 1;
+        ignore_rules_release(rules);
+        return ignore_rules_ref(parent);
+    }
+    rules->base_len = strlen(rel_dir);
+    rules->parent = ignore_rules_ref(parent);
+    rules->refcount = 1;
+    return rules;
+}
+
+// 条目是否被忽略：由深到浅逐级查找，每级中靠后的规则优先，第一条命中的规则决定结果
+int ignore_rules_match(const IgnoreRules *rules, const char *rel_path, int is_dir) {
+    if (!rules) return 0;
+
+    int case_insensitive = !config.case_sensitive;
+    size_t path_len = strlen(rel_path);
+    const char *name = strrchr(rel_path, '/');
+    name = name ? name + 1 : rel_path;
+    size_t name_len = path_len - (size_t)(name - rel_path);
+
+    for (; rules; rules = rules->parent) {
+        const char *sub = rel_path + (rules->base_len ? rules->base_len + 1 : 0);
+        size_t sub_len = path_len - (size_t)(sub - rel_path);
+        for (size_t i = rules->count; i-- > 0; ) {
+            const IgnoreRule *rule = &rules->rules[i];
+            if (rule->dir_only && !is_dir) continue;
+            int matched = rule->anchored
+                ? pattern_glob_match(rule->pattern, rule->len, sub, sub_len, case_insensitive)
+                : pattern_glob_match(rule->pattern, rule->len, name, name_len, case_insensitive);
+            if (matched) return !rule->negate;
+        }
+    }
+    return 0;
+}
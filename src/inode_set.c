@@ -0,0 +1,172 @@
+#include "inode_set.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// 每段一个链式哈希表，负载超过 1 时翻倍
+typedef struct {
+    pthread_mutex_t lock;
+    InodeEntry **buckets;
+    size_t capacity;               // 2 的幂
+    size_t count;
+} InodeShard;
+
+struct InodeSet {
+    InodeShard shards[INODE_SET_SHARDS];
+};
+
+static uint64_t inode_hash(uint64_t dev, uint64_t ino) {
+    uint64_t h = (ino ^ (dev * 0xff51afd7ed558ccdULL)) * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+}
+
+// 高位选段，低位选桶，两者互不相关
+static InodeShard* shard_of(InodeSet *set, uint64_t h) {
+    return &set->shards[h >> 58];
+}
+
+InodeSet* inode_set_create(void) {
+    InodeSet *set = calloc(1, sizeof(InodeSet));
+    if (!set) return NULL;
+    for (int i = 0; i < INODE_SET_SHARDS; i++) {
+        pthread_mutex_init(&set->shards[i].lock, NULL);
+    }
+    return set;
+}
+
+void inode_set_free(InodeSet *set) {
+    if (!set) return;
+    for (int i = 0; i < INODE_SET_SHARDS; i++) {
+        InodeShard *shard = &set->shards[i];
+        for (size_t b = 0; b < shard->capacity; b++) {
+            InodeEntry *entry = shard->buckets[b];
+            while (entry) {
+                InodeEntry *next = entry->next;
+                while (entry->waiters) {
+                    InodeWaiter *waiter = entry->waiters;
+                    entry->waiters = waiter->next;
+                    free(waiter);
+                }
+                free(entry->blocks);
+                free(entry);
+                entry = next;
+            }
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(set);
+}
+
+static InodeEntry* shard_find(const InodeShard *shard, uint64_t h, uint64_t dev, uint64_t ino) {
+    if (shard->capacity == 0) return NULL;
+    for (InodeEntry *entry = shard->buckets[h & (shard->capacity - 1)]; entry; entry = entry->next) {
+        if (entry->ino == ino && entry->dev == dev) return entry;
+    }
+    return NULL;
+}
+
+// 新建条目并挂入桶中；内存不足时返回 NULL
+static InodeEntry* shard_insert(InodeShard *shard, uint64_t h, uint64_t dev, uint64_t ino,
+                                InodeState state) {
+    if (shard->count >= shard->capacity) {
+        size_t new_capacity = shard->capacity ? shard->capacity * 2 : 64;
+        InodeEntry **buckets = calloc(new_capacity, sizeof(InodeEntry *));
+        if (!buckets) return NULL;
+        for (size_t b = 0; b < shard->capacity; b++) {
+            InodeEntry *entry = shard->buckets[b];
+            while (entry) {
+                InodeEntry *next = entry->next;
+                size_t slot = inode_hash(entry->dev, entry->ino) & (new_capacity - 1);
+                entry->next = buckets[slot];
+                buckets[slot] = entry;
+                entry = next;
+            }
+        }
+        free(shard->buckets);
+        shard->buckets = buckets;
+        shard->capacity = new_capacity;
+    }
+
+    InodeEntry *entry = calloc(1, sizeof(InodeEntry));
+    if (!entry) return NULL;
+    entry->dev = dev;
+    entry->ino = ino;
+    entry->state = state;
+    size_t slot = h & (shard->capacity - 1);
+    entry->next = shard->buckets[slot];
+    shard->buckets[slot] = entry;
+    shard->count++;
+    return entry;
+}
+
+// 按 inode 登记一个文件路径：首次出现且 insert 非 0 时登记为待哈希，由调用方计算；
+// 正在哈希时把路径挂到等待队列；已有结果时直接返回条目
+InodeClaim inode_set_claim(InodeSet *set, const struct stat *sb, FileList *list, int source,
+                           const char *rel_path, int insert, InodeEntry **entry) {
+    uint64_t dev = (uint64_t)sb->st_dev;
+    uint64_t ino = (uint64_t)sb->st_ino;
+    uint64_t h = inode_hash(dev, ino);
+    InodeShard *shard = shard_of(set, h);
+    InodeClaim claim = INODE_CLAIM_ABSENT;
+
+    pthread_mutex_lock(&shard->lock);
+    InodeEntry *found = shard_find(shard, h, dev, ino);
+    if (found && found->state == INODE_PENDING) {
+        size_t len = strlen(rel_path);
+        InodeWaiter *waiter = malloc(sizeof(InodeWaiter) + len + 1);
+        if (waiter) {
+            waiter->list = list;
+            waiter->source = source;
+            memcpy(waiter->rel_path, rel_path, len + 1);
+            waiter->next = found->waiters;
+            found->waiters = waiter;
+            claim = INODE_CLAIM_PENDING;
+        }
+    } else if (found && found->state != INODE_DIRECTORY) {
+        claim = INODE_CLAIM_DONE;
+    } else if (!found && insert) {
+        found = shard_insert(shard, h, dev, ino, INODE_PENDING);
+        if (found) claim = INODE_CLAIM_NEW;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    *entry = claim == INODE_CLAIM_ABSENT ? NULL : found;
+    return claim;
+}
+
+// 发布首个路径的结果 (digest 为 NULL 表示失败)，接管 blocks；
+// 返回等待中的路径链表，由调用方在锁外加入列表并释放
+InodeWaiter* inode_set_publish(InodeSet *set, InodeEntry *entry, const Digest *digest,
+                               unsigned char *blocks, size_t block_count) {
+    InodeShard *shard = shard_of(set, inode_hash(entry->dev, entry->ino));
+
+    pthread_mutex_lock(&shard->lock);
+    if (digest) {
+        entry->digest = *digest;
+        entry->blocks = blocks;
+        entry->block_count = blocks ? block_count : 0;
+        entry->state = INODE_READY;
+    } else {
+        free(blocks);
+        entry->state = INODE_FAILED;
+    }
+    InodeWaiter *waiters = entry->waiters;
+    entry->waiters = NULL;
+    pthread_mutex_unlock(&shard->lock);
+    return waiters;
+}
+
+// 记录已遍历的目录；首次出现返回 1，已遍历返回 0，内存不足返回 -1
+int inode_set_add_dir(InodeSet *set, uint64_t dev, uint64_t ino) {
+    uint64_t h = inode_hash(dev, ino);
+    InodeShard *shard = shard_of(set, h);
+
+    pthread_mutex_lock(&shard->lock);
+    int result = 0;
+    if (!shard_find(shard, h, dev, ino)) {
+        result = shard_insert(shard, h, dev, ino, INODE_DIRECTORY) ? 1 : -1;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return result;
+}
@@ -0,0 +1,504 @@
+#include "journal.h"
+#include "config.h"
+#include "logging.h"
+#include "shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+extern Config config;
+
+// 当前追加写入的日志 (同一时间只有一个：生成或验证)
+static FILE *journal_fp = NULL;
+static char journal_file[MAX_PATH];
+static time_t last_sync = 0;
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 生成日志恢复的已完成文件，按 (源目录序号, 路径) 散列 (开放寻址，存下标 + 1)；加载后只读，查找无需加锁
+typedef struct {
+    char *path;
+    int source;                    // 所属源目录在 -g 参数中的序号 (多个源目录可有相同的相对路径)
+    uint64_t size;
+    int64_t mtime_ns;
+    Digest digest;
+    unsigned char *blocks;         // 树哈希的块摘要
+    size_t block_count;
+} JournalRecord;
+
+static JournalRecord *records = NULL;
+static size_t record_count = 0;
+static size_t *record_slots = NULL;
+static size_t record_slot_count = 0;
+static size_t journal_hits = 0;
+
+static int64_t timespec_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static size_t record_hash(int source, const char *path) {
+    uint64_t h = 1469598103934665603ULL ^ (uint64_t)source;  // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+// 写入失败 (如磁盘已满) 时停止记录，本次运行继续，只是不再可续传
+static void journal_fail_locked(void) {
+    log_msg(LOG_WARN, "写入续传日志 '%s' 失败: %s，停止记录", journal_file, strerror(errno));
+    fclose(journal_fp);
+    journal_fp = NULL;
+}
+
+// 距上次刷盘超过 JOURNAL_SYNC_INTERVAL 秒 (或 force) 时 fflush + fsync
+static void journal_sync_locked(int force) {
+    if (!journal_fp) return;
+    time_t now = time(NULL);
+    if (!force && now - last_sync < JOURNAL_SYNC_INTERVAL) return;
+    if (ferror(journal_fp) || fflush(journal_fp) != 0 || fsync(fileno(journal_fp)) != 0) {
+        journal_fail_locked();
+        return;
+    }
+    last_sync = now;
+}
+
+// 开始记录：valid > 0 时截掉旧日志末尾不完整的部分后追加，否则新建并写入头行；
+// 无法创建日志不影响本次运行
+static void journal_start(const char *path, const char *header, off_t valid) {
+    FILE *fp = NULL;
+    if (valid > 0) {
+        if (truncate(path, valid) == 0) fp = fopen(path, "a");
+    } else {
+        fp = fopen(path, "w");
+        if (fp && fputs(header, fp) == EOF) {
+            fclose(fp);
+            fp = NULL;
+        }
+    }
+    if (!fp) {
+        log_msg(LOG_WARN, "无法写入续传日志 '%s': %s，本次运行中断后不可续传", path, strerror(errno));
+        return;
+    }
+
+    pthread_mutex_lock(&journal_lock);
+    journal_fp = fp;
+    snprintf(journal_file, sizeof(journal_file), "%s", path);
+    journal_sync_locked(1);
+    pthread_mutex_unlock(&journal_lock);
+}
+
+// 打开待恢复的日志并核对头行；不存在或为空时返回 1 (从头开始)，头行不符返回 -1
+static int journal_read_header(const char *path, const char *header, FILE **fp, char **line, size_t *cap,
+                               off_t *valid) {
+    *fp = fopen(path, "r");
+    if (!*fp) {
+        if (errno == ENOENT) {
+            log_msg(LOG_WARN, "未找到续传日志 '%s'，从头开始", path);
+            return 1;
+        }
+        log_msg(LOG_ERROR, "无法读取续传日志 '%s': %s", path, strerror(errno));
+        return -1;
+    }
+
+    // 空日志：创建后尚未写入头行就崩溃
+    ssize_t n = getline(line, cap, *fp);
+    if (n <= 0) {
+        log_msg(LOG_WARN, "续传日志 '%s' 为空，从头开始", path);
+        fclose(*fp);
+        *fp = NULL;
+        return 1;
+    }
+    if (strcmp(*line, header) != 0) {
+        log_msg(LOG_ERROR, "续传日志 '%s' 与本次运行的参数不符，请去掉 --resume 重新开始", path);
+        fclose(*fp);
+        *fp = NULL;
+        return -1;
+    }
+    *valid = n;
+    return 0;
+}
+
+// 解析生成日志的条目行 (不含换行)：<摘要> <大小> <mtime 纳秒> <块数> <源目录序号> *<路径>
+static int parse_record(const char *line, size_t len, JournalRecord *rec) {
+    const char *end = line + len;
+    const char *space = memchr(line, ' ', len);
+    if (!space || digest_parse(line, (size_t)(space - line), config.digest_algo, &rec->digest) != 0) {
+        return -1;
+    }
+
+    char *next;
+    errno = 0;
+    rec->size = strtoull(space + 1, &next, 10);
+    if (errno || *next != ' ') return -1;
+    rec->mtime_ns = strtoll(next + 1, &next, 10);
+    if (errno || *next != ' ') return -1;
+    rec->block_count = strtoull(next + 1, &next, 10);
+    if (errno || *next != ' ') return -1;
+    long source = strtol(next + 1, &next, 10);
+    if (errno || source < 0 || source >= config.source_count) return -1;
+    rec->source = (int)source;
+    if (next + 2 > end || next[0] != ' ' || next[1] != '*' || next + 2 == end) return -1;
+    if ((rec->digest.tree_block_size == 0) != (rec->block_count == 0)) return -1;
+
+    rec->path = strndup(next + 2, (size_t)(end - next - 2));
+    rec->blocks = NULL;
+    return rec->path ? 0 : -1;
+}
+
+// 读取一个条目的块摘要行，全部完整时返回 0
+static int read_record_blocks(FILE *fp, JournalRecord *rec, char **line, size_t *cap, off_t *bytes) {
+    if (rec->block_count == 0) return 0;
+
+    size_t digest_len = rec->digest.len;
+    if (rec->block_count > SIZE_MAX / digest_len) return -1;
+    rec->blocks = malloc(rec->block_count * digest_len);
+    if (!rec->blocks) return -1;
+
+    for (size_t i = 0; i < rec->block_count; i++) {
+        ssize_t n = getline(line, cap, fp);
+        if (n != (ssize_t)(digest_len * 2 + 1) || (*line)[n - 1] != '\n' ||
+            digest_from_hex(*line, digest_len, rec->blocks + i * digest_len) != 0) {
+            return -1;
+        }
+        *bytes += n;
+    }
+    return 0;
+}
+
+static void free_records(void) {
+    for (size_t i = 0; i < record_count; i++) {
+        free(records[i].path);
+        free(records[i].blocks);
+    }
+    free(records);
+    free(record_slots);
+    records = NULL;
+    record_count = 0;
+    record_slots = NULL;
+    record_slot_count = 0;
+}
+
+// 建立索引：同一源目录下的同一路径出现多次时 (上次续传后文件又有变化) 以后写入的为准
+static int build_record_index(void) {
+    size_t slot_count = 16;
+    while (slot_count < record_count * 2) slot_count *= 2;
+    record_slots = calloc(slot_count, sizeof(size_t));
+    if (!record_slots) return -1;
+    record_slot_count = slot_count;
+
+    size_t mask = slot_count - 1;
+    for (size_t index = 0; index < record_count; index++) {
+        const JournalRecord *rec = &records[index];
+        size_t i = record_hash(rec->source, rec->path) & mask;
+        while (record_slots[i] && (records[record_slots[i] - 1].source != rec->source ||
+                                   strcmp(records[record_slots[i] - 1].path, rec->path) != 0)) {
+            i = (i + 1) & mask;
+        }
+        record_slots[i] = index + 1;
+    }
+    return 0;
+}
+
+// 读取生成日志中完整的条目，valid 返回完整部分的长度
+static int load_generate(const char *path, const char *header, off_t *valid) {
+    FILE *fp;
+    char *line = NULL;
+    size_t cap = 0;
+    int result = journal_read_header(path, header, &fp, &line, &cap, valid);
+    if (result != 0) {
+        free(line);
+        return result;
+    }
+
+    size_t capacity = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, fp)) > 0 && line[n - 1] == '\n') {
+        if (record_count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 1024;
+            JournalRecord *grown = realloc(records, new_capacity * sizeof(JournalRecord));
+            if (!grown) {
+                result = -2;
+                break;
+            }
+            records = grown;
+            capacity = new_capacity;
+        }
+
+        // 写了一半的条目 (含块摘要不全) 及其后的内容一律丢弃
+        JournalRecord *rec = &records[record_count];
+        off_t bytes = n;
+        if (parse_record(line, (size_t)n - 1, rec) != 0) break;
+        if (read_record_blocks(fp, rec, &line, &cap, &bytes) != 0) {
+            free(rec->path);
+            free(rec->blocks);
+            break;
+        }
+        record_count++;
+        *valid += bytes;
+    }
+    free(line);
+    fclose(fp);
+
+    if (result == 0 && build_record_index() != 0) result = -2;
+    if (result != 0) {
+        log_msg(LOG_ERROR, "内存分配失败: 续传日志");
+        free_records();
+        return result;
+    }
+    log_msg(LOG_INFO, "已加载续传日志: %s (%zu 个已完成文件)", path, record_count);
+    return 0;
+}
+
+// 打开生成日志；resume 时先加载上次运行已完成的文件
+// 头行按顺序记录各源目录的绝对路径：记录以源目录序号为键，源目录列表不同的日志不能复用
+int journal_open_generate(const char *path, int resume) {
+    if (!path) return MIRRORGUARD_ERROR_INVALID_ARGS;
+
+    size_t header_size = 256 + (size_t)config.source_count * (MAX_PATH + 8);
+    char *header = malloc(header_size);
+    if (!header) {
+        log_msg(LOG_ERROR, "内存分配失败: 续传日志");
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
+    size_t len = (size_t)snprintf(header, header_size, "%s algo=%s block-size=%zu", JOURNAL_GENERATE_TAG,
+                                  digest_engine_get(config.digest_algo)->name,
+                                  config.tree_hash ? config.tree_block_size : 0);
+    for (int i = 0; i < config.source_count; i++) {
+        char *root = realpath(config.source_dirs[i], NULL);
+        len += (size_t)snprintf(header + len, header_size - len, " source=%s", root ? root : config.source_dirs[i]);
+        free(root);
+    }
+    snprintf(header + len, header_size - len, "\n");
+
+    off_t valid = 0;
+    int result = MIRRORGUARD_OK;
+    if (resume) {
+        int loaded = load_generate(path, header, &valid);
+        if (loaded == -1) result = MIRRORGUARD_ERROR_CONFLICT;
+        if (loaded == -2) result = MIRRORGUARD_ERROR_MEMORY;
+        if (loaded == 1) valid = 0;
+    }
+
+    if (result == MIRRORGUARD_OK) journal_start(path, header, valid);
+    free(header);
+    return result;
+}
+
+// 按源目录序号与相对路径查找上次运行已完成的文件，大小与 mtime 都未变化才算命中；
+// 命中时 blocks 返回块摘要的副本 (由调用方释放)
+int journal_lookup(int source, const char *rel_path, const struct stat *sb, Digest *digest,
+                   unsigned char **blocks, size_t *block_count) {
+    if (!record_slots || !rel_path || !sb) return 0;
+
+    size_t mask = record_slot_count - 1;
+    const JournalRecord *rec = NULL;
+    for (size_t i = record_hash(source, rel_path) & mask; record_slots[i]; i = (i + 1) & mask) {
+        const JournalRecord *candidate = &records[record_slots[i] - 1];
+        if (candidate->source == source && strcmp(candidate->path, rel_path) == 0) {
+            rec = candidate;
+            break;
+        }
+    }
+    if (!rec || rec->size != (uint64_t)sb->st_size || rec->mtime_ns != timespec_ns(&sb->st_mtim)) return 0;
+
+    *blocks = NULL;
+    if (rec->block_count) {
+        size_t bytes = rec->block_count * rec->digest.len;
+        *blocks = malloc(bytes);
+        if (!*blocks) return 0;
+        memcpy(*blocks, rec->blocks, bytes);
+    }
+    *block_count = rec->block_count;
+    *digest = rec->digest;
+    __atomic_add_fetch(&journal_hits, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// 记录一个已完成的文件 (工作线程调用)，source 为所属源目录的序号
+void journal_record_file(int source, const char *rel_path, const Digest *digest, const unsigned char *blocks,
+                         size_t block_count, const struct stat *sb) {
+    char hash[HASH_STR_MAX];
+    char hex[MAX_DIGEST_LENGTH * 2 + 1];
+    if (!rel_path || !digest || digest_format(digest, config.digest_algo, hash, sizeof(hash)) != 0) return;
+
+    pthread_mutex_lock(&journal_lock);
+    if (journal_fp) {
+        fprintf(journal_fp, "%s %llu %lld %zu %d *%s\n", hash, (unsigned long long)sb->st_size,
+                (long long)timespec_ns(&sb->st_mtim), blocks ? block_count : 0, source, rel_path);
+        for (size_t i = 0; blocks && i < block_count; i++) {
+            digest_to_hex(blocks + i * digest->len, digest->len, hex);
+            fprintf(journal_fp, "%s\n", hex);
+        }
+        journal_sync_locked(0);
+    }
+    pthread_mutex_unlock(&journal_lock);
+}
+
+static FileStatus status_from_code(char code) {
+    switch (code) {
+        case 'M': return FILE_STATUS_MISSING;
+        case 'C': return FILE_STATUS_CORRUPT;
+        case 'E': return FILE_STATUS_ERROR;
+        default: return FILE_STATUS_VALID;
+    }
+}
+
+void journal_free_resume(JournalResume *state) {
+    if (!state) return;
+    for (size_t i = 0; i < state->result_count; i++) free(state->results[i].path);
+    free(state->results);
+    memset(state, 0, sizeof(JournalResume));
+}
+
+// 读取验证日志：只保留最后一个检查点之前的结果，valid 返回截至该检查点的长度
+static int load_verify(const char *path, const char *header, JournalResume *state, off_t *valid) {
+    FILE *fp;
+    char *line = NULL;
+    size_t cap = 0;
+    int result = journal_read_header(path, header, &fp, &line, &cap, valid);
+    if (result != 0) {
+        free(line);
+        return result;
+    }
+
+    size_t capacity = 0;
+    size_t committed = 0;          // 最后一个检查点之前的结果数
+    off_t offset = *valid;
+    ssize_t n;
+    while ((n = getline(&line, &cap, fp)) > 0 && line[n - 1] == '\n') {
+        line[n - 1] = '\0';
+        char *next;
+        errno = 0;
+        if (line[0] == '@' && line[1] == ' ') {
+            size_t cursor = strtoull(line + 2, &next, 10);
+            if (errno || *next != ' ') break;
+            size_t processed = strtoull(next + 1, &next, 10);
+            if (errno || *next != '\0') break;
+            offset += n;
+            *valid = offset;
+            state->cursor = cursor;
+            state->processed = processed;
+            committed = state->result_count;
+            continue;
+        }
+
+        FileStatus status = status_from_code(line[0]);
+        if (status == FILE_STATUS_VALID || line[1] != ' ') break;
+        strtoull(line + 2, &next, 10);
+        if (errno || next[0] != ' ' || next[1] != '*' || next[2] == '\0') break;
+
+        if (state->result_count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 256;
+            JournalResult *grown = realloc(state->results, new_capacity * sizeof(JournalResult));
+            if (!grown) {
+                result = -2;
+                break;
+            }
+            state->results = grown;
+            capacity = new_capacity;
+        }
+        char *rel_path = strdup(next + 2);
+        if (!rel_path) {
+            result = -2;
+            break;
+        }
+        state->results[state->result_count].status = status;
+        state->results[state->result_count].path = rel_path;
+        state->result_count++;
+        offset += n;
+    }
+    free(line);
+    fclose(fp);
+
+    // 最后一个检查点之后的结果将重新验证
+    while (state->result_count > committed) free(state->results[--state->result_count].path);
+
+    if (result != 0) {
+        log_msg(LOG_ERROR, "内存分配失败: 续传日志");
+        journal_free_resume(state);
+        return result;
+    }
+    log_msg(LOG_INFO, "已加载续传日志: %s (已验证 %zu 个条目)", path, state->cursor);
+    return 0;
+}
+
+// 打开验证日志：头行记录清单的大小、mtime、分片与镜像目录，续传时须与本次一致
+int journal_open_verify(const char *path, const char *manifest_path, const char *mirror_dir, int resume,
+                        JournalResume *state) {
+    if (!path || !manifest_path || !mirror_dir || !state) return MIRRORGUARD_ERROR_INVALID_ARGS;
+    memset(state, 0, sizeof(JournalResume));
+
+    struct stat sb;
+    if (stat(manifest_path, &sb) != 0) {
+        log_msg(LOG_ERROR, "无法读取清单文件 '%s': %s", manifest_path, strerror(errno));
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    char shard[SHARD_HEADER_MAX];
+    shard_format(shard, sizeof(shard), config.shard_index, config.shard_count, config.shard_by_dir);
+    char header[MAX_PATH + 256];
+    snprintf(header, sizeof(header), "%s size=%lld mtime=%lld%s mirror=%s\n", JOURNAL_VERIFY_TAG,
+             (long long)sb.st_size, (long long)timespec_ns(&sb.st_mtim), shard, mirror_dir);
+
+    off_t valid = 0;
+    if (resume) {
+        int result = load_verify(path, header, state, &valid);
+        if (result == -1) return MIRRORGUARD_ERROR_CONFLICT;
+        if (result == -2) return MIRRORGUARD_ERROR_MEMORY;
+        if (result == 1) valid = 0;
+    }
+
+    journal_start(path, header, valid);
+    return MIRRORGUARD_OK;
+}
+
+// 记录一个失败的验证结果 (按清单顺序，在其所在的检查点之前写入)
+void journal_record_result(FileStatus status, size_t ordinal, const char *rel_path) {
+    char code = status == FILE_STATUS_MISSING ? 'M' : status == FILE_STATUS_CORRUPT ? 'C' : 'E';
+    pthread_mutex_lock(&journal_lock);
+    if (journal_fp) fprintf(journal_fp, "%c %zu *%s\n", code, ordinal, rel_path);
+    pthread_mutex_unlock(&journal_lock);
+}
+
+// 检查点：序号小于 cursor 的条目均已报告；随刷盘写入，force 时立即写入
+void journal_checkpoint(size_t cursor, size_t processed, int force) {
+    pthread_mutex_lock(&journal_lock);
+    if (journal_fp && (force || time(NULL) - last_sync >= JOURNAL_SYNC_INTERVAL)) {
+        fprintf(journal_fp, "@ %zu %zu\n", cursor, processed);
+        journal_sync_locked(1);
+    }
+    pthread_mutex_unlock(&journal_lock);
+}
+
+// 当前日志路径，未在记录时返回 NULL
+const char* journal_path(void) {
+    return journal_fp ? journal_file : NULL;
+}
+
+// 结束记录：keep 时刷盘保留 (可续传)，否则删除日志
+int journal_close(int keep) {
+    int result = 0;
+    pthread_mutex_lock(&journal_lock);
+    if (journal_fp && keep) journal_sync_locked(1);  // 失败时已关闭
+    if (journal_fp) {
+        if (fclose(journal_fp) != 0) result = -1;
+        journal_fp = NULL;
+    } else if (keep && journal_file[0]) {
+        result = -1;
+    }
+    if (!keep && journal_file[0]) unlink(journal_file);
+    journal_file[0] = '\0';
+    pthread_mutex_unlock(&journal_lock);
+
+    if (journal_hits > 0) {
+        log_msg(LOG_INFO, "续传日志: 复用 %zu 个已完成文件", journal_hits);
+    }
+    journal_hits = 0;
+    free_records();
+    return result;
+}
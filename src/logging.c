@@ -14,7 +14,8 @@ void log_msg(LogLevel level, const char *fmt, ...) {
     // 获取时间戳
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    struct tm *tm_info = localtime(&tv.tv_sec);
+    struct tm tm_buf;
+    struct tm *tm_info = localtime_r(&tv.tv_sec, &tm_buf);
     
     const char *prefix = "";
     switch(level) {
@@ -37,6 +38,8 @@ void log_msg(LogLevel level, const char *fmt, ...) {
         output = config.log_fp;
     }
     
+    // 多个工作线程同时写日志时保持单行完整
+    flockfile(output);
     fprintf(output, "%s%s", timestamp, prefix);
     
     va_list args;
@@ -45,6 +48,7 @@ void log_msg(LogLevel level, const char *fmt, ...) {
     fprintf(output, "\n");
     va_end(args);
     fflush(output);
+    funlockfile(output);
 }
 
 void log_set_quiet(int quiet) {
@@ -4,6 +4,13 @@
 #include "comparison.h"
 #include "progress.h"
 #include "tui.h"
+#include "thread_pool.h"
+#include "sha256_mb.h"
+#include "hash_cache.h"
+#include "gzblock.h"
+#include "journal.h"
+#include "shard.h"
+#include "dispatch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -83,6 +90,17 @@ int main(int argc, char **argv) {
     log_set_logfile(config.log_file);
     log_set_quiet(config.quiet);
 
+    // 创建哈希工作池
+    g_hash_pool = thread_pool_create(config.threads, (size_t)config.threads * 64);
+    if (!g_hash_pool) {
+        log_msg(LOG_WARN, "无法创建工作池，回退到单线程处理");
+    }
+
+    // 加载哈希缓存 (生成与目录比较时跳过元数据未变化的文件)
+    if (config.hash_cache_path && hash_cache_open(config.hash_cache_path) != 0) {
+        log_msg(LOG_WARN, "哈希缓存不可用，将完整计算");
+    }
+
     // 根据操作模式执行相应功能
     if (config.generate_mode) {
         if (!config.manifest_path || config.source_count == 0) {
@@ -138,6 +156,17 @@ int main(int argc, char **argv) {
         log_msg(LOG_INFO, "目录2: %s", config.source_dir2);
 
         result = compare_directories(config.source_dir1, config.source_dir2);
+    } else if (config.convert_mode) {
+        log_msg(LOG_INFO, "开始转换清单: %s -> %s (%s)", config.manifest_files[0], config.manifest_files[1],
+                config.output_format);
+        result = convert_manifest(config.manifest_files[0], config.manifest_files[1]);
+    } else if (config.lookup_mode) {
+        result = lookup_manifest(config.manifest_path, config.lookup_paths, config.lookup_count);
+    } else if (config.merge_mode) {
+        log_msg(LOG_INFO, "开始合并 %d 个分片 -> %s", config.merge_count, config.manifest_path);
+        result = merge_shards(config.manifest_path, config.merge_inputs, config.merge_count);
+    } else if (config.worker_mode) {
+        result = dispatch_worker_run(config.worker_addr);
     } else {
         // 如果没有指定任何模式，显示帮助
         show_help(argv[0]);
@@ -173,23 +202,49 @@ void show_help(const char *prog_name) {
     printf("  -g, --generate <源目录1> [源目录2]... <清单文件>  生成多源校验清单\n");
     printf("  -v, --verify <镜像目录> <清单文件>               验证镜像完整性\n");
     printf("  -c, --compare <清单1> <清单2>                   比较两个清单文件\n");
-    printf("  -d, --diff <源目录1> <源目录2>                  直接比较两个目录\n\n");
+    printf("  -d, --diff <源目录1> <源目录2>                  直接比较两个目录\n");
+    printf("  --convert <输入清单> <输出清单>                 转换清单格式 (输出格式由 -o 指定)\n");
+    printf("  --lookup <清单文件> <路径>...                   按路径查询清单条目\n");
+    printf("  --merge <输出文件> <分片1> <分片2>...           合并分片清单 (按路径归并) 或分片验证报告 (汇总结果)\n");
+    printf("  --worker <协调器地址>                           作为 worker 为协调器哈希文件 (直到协调器完成)\n\n");
 
     printf("通用选项:\n");
     printf("  -f, --follow-symlinks        跟随符号链接 (默认: 不跟随)\n");
     printf("  -H, --no-hidden              忽略隐藏文件 (默认: 包含)\n");
-    printf("  -x, --exclude <模式>         排除匹配模式的文件\n");
-    printf("  -i, --include <模式>         仅包含匹配模式的文件\n");
+    printf("  -x, --exclude <模式>         排除匹配模式的文件或目录 (子串；*.tmp、a/**/b 等通配；/前缀 锚定到根；可多次使用)\n");
+    printf("  -i, --include <模式>         仅包含匹配模式的文件 (语法同 -x，只作用于文件)\n");
+    printf("  --no-ignore-files            不读取各目录的 .mirrorguardignore (默认: 读取，gitignore 语法，逐级继承)\n");
     printf("  -e, --no-extra-check         禁用额外文件检查 (默认: 启用)\n");
     printf("  -r, --no-recursive           禁用递归扫描 (默认: 启用)\n");
     printf("  -p, --progress               显示处理进度 (默认: 静默)\n");
     printf("  --tui=<0-5>                  TUI 模式: 0=无, 1=简单, 2=高级, 3=极简, 4=富文本, 5=调试\n");
+    printf("  --threads <N>                哈希工作线程数 (默认: CPU核心数，最多32；环境变量 MIRRORGUARD_THREADS)\n");
+    printf("  --scan-threads <N>           目录遍历线程数 (默认: 与 --threads 相同；网络文件系统可适当调大)\n");
+    printf("  --memory-limit <大小>        文件列表内存上限，如 4G；超出部分排序写入临时文件 (TMPDIR) 后归并 (默认: 不限制)\n");
+    printf("  --algo <算法>                摘要算法: sha256/blake3/xxh3 (默认: sha256，写入清单头)\n");
+    printf("  --tree-hash                  大文件分块并行计算树哈希，块摘要写入 <清单>.blocks\n");
+    printf("  --block-size <大小>          树哈希块大小，如 16M (默认: 16M，最小 64K)\n");
+    printf("  --io-engine <引擎>           哈希读取引擎: sync/uring (默认: sync，io_uring 不可用时自动回退)\n");
+    printf("  --hash-cache <文件>          持久哈希缓存，按 inode/大小/mtime/ctime 跳过未变化的文件\n");
+    printf("  --rehash                     忽略哈希缓存，全部重新计算 (结果仍写回缓存)\n");
+    printf("  --cache-max-age <天>         未再出现的缓存条目保留天数 (默认: 30，-1 表示永久)\n");
+    printf("  --cache-mode <模式>          页缓存策略: normal/dontneed/direct (默认: normal；direct 不支持时退回 dontneed)\n");
     printf("  -V, --verbose                详细输出 (可多次使用)\n");
     printf("  -q, --quiet                  安静模式 (仅显示错误)\n");
     printf("  -n, --dry-run                模拟运行 (不实际写入)\n");
     printf("  -F, --force                  强制覆盖现有清单 (默认: 询问)\n");
     printf("  -C, --case-insensitive       不区分大小写匹配 (默认: 区分)\n");
-    printf("  -o, --output-format <fmt>    输出格式: sha256sum/json/csv (默认: sha256sum)\n");
+    printf("  -o, --output-format <fmt>    清单格式: mirrorguard (记录大小，验证时快速发现截断)/sha256sum/mgidx (二进制，可直接映射查找) (默认: mirrorguard)\n");
+    printf("  --record-mtime               清单中同时记录修改时间\n");
+    printf("  --resume                     记录续传日志，并从上次被中断的生成/验证继续 (日志不存在时从头开始)\n");
+    printf("  --journal <文件>             记录续传日志到指定文件 (默认: <清单>.journal，验证为 <清单>.verify-journal；每 %d 秒刷盘)\n",
+           JOURNAL_SYNC_INTERVAL);
+    printf("  --shard <i/N>                只处理第 i 个分片 (共 N 个，按相对路径哈希选取，各节点结果互不重叠)\n");
+    printf("  --shard-by <依据>            分片依据: path/dir (dir 按首级目录整棵选取；默认: path)\n");
+    printf("  --report <文件>              验证结果写入报告 (计数与失败条目)，供 --merge 汇总\n");
+    printf("  --coordinator <地址>         生成时作为协调器，文件交给 --worker 进程哈希 (unix:<路径> 或 <主机>:<端口>)\n");
+    printf("  --lease-timeout <秒>         worker 租约秒数，超时未响应的批次重新分配 (默认: %d)\n", DISPATCH_LEASE_DEFAULT);
+    printf("  -z, --compress               文本清单写成分块 gzip 压缩格式 (可直接 zcat；读取时自动识别)\n");
     printf("  -l, --log-file <文件>        日志输出到文件\n");
     printf("  -h, --help                   显示此帮助\n");
     printf("  -V, --version                显示版本信息\n\n");
@@ -207,6 +262,20 @@ void show_help(const char *prog_name) {
     printf("  # 直接比较两个目录\n");
     printf("  %s -d /data/source1 /data/source2\n\n", prog_name);
 
+    printf("  # 文本清单转为二进制清单\n");
+    printf("  %s -o mgidx --convert manifest.sha256 manifest.mgidx\n\n", prog_name);
+
+    printf("  # 中断后继续生成 (已完成的文件不再重新哈希)\n");
+    printf("  %s --resume -g /data/source1 manifest.sha256\n\n", prog_name);
+
+    printf("  # 分 4 个节点生成清单后合并\n");
+    printf("  %s --shard=1/4 -g /data/source1 manifest.1  (各节点 1/4 ... 4/4)\n", prog_name);
+    printf("  %s --merge manifest.sha256 manifest.1 manifest.2 manifest.3 manifest.4\n\n", prog_name);
+
+    printf("  # 协调器遍历并写清单，多个 worker 进程拉取文件哈希 (可在挂载同一存储的其他主机上)\n");
+    printf("  %s --coordinator unix:/tmp/mg.sock -g /data/source1 manifest.sha256\n", prog_name);
+    printf("  %s --worker unix:/tmp/mg.sock\n\n", prog_name);
+
     printf("  # 启用 TUI 模式\n");
     printf("  %s --tui=1 -g /data/source1 manifest.sha256\n\n", prog_name);
 
@@ -229,4 +298,9 @@ void show_version() {
     printf("编译时间: %s %s\n", __DATE__, __TIME__);
     printf("系统信息: Linux POSIX\n");
     printf("OpenSSL版本: OpenSSL 3.0+ (EVP接口)\n");
+    char engines[128];
+    digest_list_engines(engines, sizeof(engines));
+    printf("摘要算法: %s\n", engines);
+    printf("小文件 SHA-256 批量内核: %s\n", sha256_mb_kernel_name());
+    printf("分块压缩清单: %s\n", gzblock_available() ? "zlib" : "不支持");
 }
@@ -0,0 +1,560 @@
+#include "manifest.h"
+#include "logging.h"
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 解析清单头中的 fields=<字段,...>
+static int parse_fields(const char *line, int *fields) {
+    *fields = 0;
+    const char *p = strstr(line, "fields=");
+    if (!p) return 0;
+
+    char list[64];
+    if (sscanf(p + 7, "%63[^ \t\r\n]", list) != 1) return -1;
+
+    char *saveptr = NULL;
+    for (char *name = strtok_r(list, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)) {
+        if (strcmp(name, "size") == 0) {
+            *fields |= MANIFEST_FIELD_SIZE;
+        } else if (strcmp(name, "mtime") == 0) {
+            *fields |= MANIFEST_FIELD_MTIME;
+        } else {
+            log_msg(LOG_ERROR, "清单使用了不支持的字段: %s", name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 解析清单头中的 algo=<算法>、fields=<字段> 与 count=<条目数>
+static int parse_header(const char *line, DigestAlgo *algo, int *fields, size_t *count) {
+    if (parse_fields(line, fields) != 0) return -1;
+
+    const char *c = strstr(line, "count=");
+    if (c) *count = (size_t)strtoull(c + 6, NULL, 10);
+
+    const char *p = strstr(line, "algo=");
+    if (!p) {
+        *algo = DIGEST_ALGO_SHA256;
+        return 0;
+    }
+
+    char name[32];
+    if (sscanf(p + 5, "%31[^ \t\r\n]", name) != 1) {
+        return -1;
+    }
+
+    const DigestEngine *engine = digest_engine_by_name(name);
+    if (!engine) {
+        log_msg(LOG_ERROR, "清单使用了未知的摘要算法: %s", name);
+        return -1;
+    }
+    if (!engine->available) {
+        log_msg(LOG_ERROR, "当前构建不支持清单的摘要算法: %s", name);
+        return -1;
+    }
+
+    *algo = engine->algo;
+    return 0;
+}
+
+// 解压第 block 块作为当前内容
+static int load_block(ManifestReader *reader, size_t block) {
+    if (block >= reader->blocks->block_count) return -1;
+    if (gzblock_inflate(reader->blocks, block, reader->block_buf) != 0) {
+        reader->failed = 1;
+        return -1;
+    }
+    reader->block = block;
+    reader->data = reader->block_buf;
+    reader->size = reader->blocks->blocks[block].usize;
+    reader->pos = 0;
+    return 0;
+}
+
+// 分块压缩清单：读取块索引，解压第 0 块 (含清单头)
+static int open_blocks(ManifestReader *reader) {
+    GzBlockIndex *blocks = malloc(sizeof(GzBlockIndex));
+    if (!blocks) {
+        log_msg(LOG_ERROR, "内存分配失败: 清单读取器");
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
+    if (gzblock_open(blocks, reader->data, reader->size) != 0) {
+        free(blocks);
+        return MIRRORGUARD_ERROR_INVALID_FORMAT;
+    }
+    reader->blocks = blocks;
+    reader->block_buf = malloc(blocks->max_usize ? blocks->max_usize : 1);
+    if (!reader->block_buf) {
+        log_msg(LOG_ERROR, "内存分配失败: 清单读取器");
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
+    reader->data = NULL;
+    reader->size = 0;
+    reader->count = blocks->entry_count;
+    if (blocks->block_count > 0 && load_block(reader, 0) != 0) {
+        return MIRRORGUARD_ERROR_INVALID_FORMAT;
+    }
+    return MIRRORGUARD_OK;
+}
+
+// 打开清单：只读映射整个文件并解析清单头
+int manifest_open(ManifestReader *reader, const char *path) {
+    if (!reader || !path) return MIRRORGUARD_ERROR_INVALID_ARGS;
+
+    memset(reader, 0, sizeof(ManifestReader));
+    reader->algo = DIGEST_ALGO_SHA256;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat sb;
+    if (fd == -1 || fstat(fd, &sb) != 0) {
+        log_msg(LOG_ERROR, "无法打开清单 '%s': %s", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    if (sb.st_size > 0) {
+        void *map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            log_msg(LOG_ERROR, "无法映射清单 '%s': %s", path, strerror(errno));
+            close(fd);
+            return MIRRORGUARD_ERROR_FILE_IO;
+        }
+        posix_madvise(map, sb.st_size, POSIX_MADV_SEQUENTIAL);
+        reader->data = map;
+        reader->size = sb.st_size;
+    }
+    close(fd);
+
+    // 二进制清单：校验结构后按记录读取
+    if (mgidx_detect(reader->data, reader->size)) {
+        reader->cursor = malloc(sizeof(MgIndexCursor));
+        if (!reader->cursor) {
+            log_msg(LOG_ERROR, "内存分配失败: 清单读取器");
+            manifest_close(reader);
+            return MIRRORGUARD_ERROR_MEMORY;
+        }
+        if (mgidx_attach(&reader->index, reader->data, reader->size) != 0) {
+            manifest_close(reader);
+            return MIRRORGUARD_ERROR_INVALID_FORMAT;
+        }
+        mgidx_cursor_init(reader->cursor, &reader->index);
+        reader->algo = (DigestAlgo)reader->index.header->algo;
+        reader->fields = reader->index.header->fields;
+        reader->count = reader->index.header->count;
+        reader->start = reader->pos = reader->size;
+        return MIRRORGUARD_OK;
+    }
+
+    if (gzblock_detect(reader->data, reader->size)) {
+        int result = open_blocks(reader);
+        if (result != MIRRORGUARD_OK) {
+            manifest_close(reader);
+            return result;
+        }
+    }
+
+    // 清单头只有一行且很短，复制出来按字符串解析
+    size_t header_prefix = strlen(MANIFEST_HEADER_PREFIX);
+    if (reader->size >= header_prefix && memcmp(reader->data, MANIFEST_HEADER_PREFIX, header_prefix) == 0) {
+        const char *nl = memchr(reader->data, '\n', reader->size);
+        size_t len = nl ? (size_t)(nl - reader->data) : reader->size;
+        char header[512];
+        if (len >= sizeof(header)) len = sizeof(header) - 1;
+        memcpy(header, reader->data, len);
+        header[len] = '\0';
+        if (parse_header(header, &reader->algo, &reader->fields, &reader->count) != 0) {
+            manifest_close(reader);
+            return MIRRORGUARD_ERROR_INVALID_FORMAT;
+        }
+        shard_parse_header(header, &reader->shard_index, &reader->shard_count, &reader->shard_by_dir);
+        reader->start = nl ? (size_t)(nl - reader->data) + 1 : reader->size;
+    }
+    // 无头清单 (sha256sum 格式)，首行即条目
+    reader->pos = reader->start;
+    return MIRRORGUARD_OK;
+}
+
+// 条目总数：清单头声明时直接使用，否则按已读字节的平均行长与文件大小估算
+size_t manifest_estimate_total(ManifestReader *reader, size_t entries_read) {
+    if (!reader) return entries_read;
+    if (reader->count > 0) return reader->count;
+    size_t consumed = reader->pos - reader->start;
+    if (consumed == 0 || entries_read == 0 || reader->pos >= reader->size) return entries_read;
+    return (size_t)((double)entries_read * (reader->size - reader->start) / consumed);
+}
+
+static inline int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// 读取下一个数值字段，成功时 *p 指向字段之后 (须紧跟空白)
+static int parse_number(const char **p, const char *end, long long *out) {
+    const char *q = *p;
+    while (q < end && is_space(*q)) q++;
+    int negative = q < end && *q == '-';
+    if (q < end && (*q == '-' || *q == '+')) q++;
+    const char *digits = q;
+    long long value = 0;
+    while (q < end && *q >= '0' && *q <= '9') {
+        if (value > (LLONG_MAX - (*q - '0')) / 10) return -1;
+        value = value * 10 + (*q - '0');
+        q++;
+    }
+    if (q == digits || q >= end || (*q != ' ' && *q != '\t')) return -1;
+    *out = negative ? -value : value;
+    *p = q;
+    return 0;
+}
+
+// 解析一行 [line, end): <hash> [size] [mtime] *<path>，哈希字段在此解码为二进制摘要
+// 返回 1 表示得到条目；注释、空行与无效行返回 0
+static int parse_line(const ManifestReader *reader, const char *line, const char *end, ManifestEntry *entry) {
+    if (line == end || line[0] == '#') return 0;
+
+    const char *p = line;
+    while (p < end && is_space(*p)) p++;
+    const char *hash = p;
+    while (p < end && !is_space(*p)) p++;
+    size_t hash_len = (size_t)(p - hash);
+    if (hash_len == 0) return 0;
+
+    entry->size = -1;
+    entry->mtime = -1;
+    if (((reader->fields & MANIFEST_FIELD_SIZE) && parse_number(&p, end, &entry->size) != 0) ||
+        ((reader->fields & MANIFEST_FIELD_MTIME) && parse_number(&p, end, &entry->mtime) != 0)) {
+        return 0;
+    }
+    while (p < end && is_space(*p)) p++;
+    if (p + 1 >= end || *p != '*') return 0;
+    entry->path = p + 1;
+    entry->path_len = (size_t)(end - entry->path);
+
+    if (digest_parse(hash, hash_len, reader->algo, &entry->digest) != 0) {
+        log_msg(LOG_WARN, "清单中的摘要无效，已跳过: %.*s", (int)entry->path_len, entry->path);
+        return 0;
+    }
+    return 1;
+}
+
+// 顺序读取下一条目；换行由 memchr (glibc 按 SIMD 实现) 查找，路径不复制
+// 返回 1 表示读到条目，0 表示结束
+int manifest_next(ManifestReader *reader, ManifestEntry *entry) {
+    if (!reader || !entry) return 0;
+
+    if (reader->cursor) {
+        size_t i;
+        if (!mgidx_cursor_next(reader->cursor, &i)) return 0;
+        mgidx_record(&reader->index, i, &entry->digest, &entry->size, &entry->mtime);
+        entry->path = reader->cursor->path;
+        entry->path_len = reader->cursor->path_len;
+        return 1;
+    }
+
+    for (;;) {
+        while (reader->pos < reader->size) {
+            const char *line = reader->data + reader->pos;
+            const char *nl = memchr(line, '\n', reader->size - reader->pos);
+            const char *end = nl ? nl : reader->data + reader->size;
+            reader->pos = (size_t)(end - reader->data) + (nl ? 1 : 0);
+            if (parse_line(reader, line, end, entry)) return 1;
+        }
+        // 压缩清单的行不跨块，当前块读完即解压下一块
+        if (!reader->blocks || load_block(reader, reader->block + 1) != 0) return 0;
+    }
+}
+
+// 解析起始偏移落在 [begin, limit) 内的行 (最后一行可越过 limit，止于 size)
+static void parse_lines(const ManifestReader *reader, const char *data, size_t begin, size_t limit, size_t size,
+                        ManifestEntryFn fn, void *arg) {
+    ManifestEntry entry;
+    while (begin < limit) {
+        const char *line = data + begin;
+        const char *nl = memchr(line, '\n', size - begin);
+        const char *end = nl ? nl : data + size;
+        begin = (size_t)(end - data) + (nl ? 1 : 0);
+        if (parse_line(reader, line, end, &entry)) fn(arg, &entry);
+    }
+}
+
+// 并行解析的共享状态：第 i 块负责起始偏移落在 [start + i * 块大小, start + (i + 1) * 块大小) 的行
+typedef struct {
+    const ManifestReader *reader;
+    size_t start;
+    size_t chunk_count;
+    ManifestEntryFn fn;
+    void *arg;
+} ManifestChunks;
+
+static void parse_chunk(void *arg, size_t index) {
+    const ManifestChunks *chunks = (const ManifestChunks *)arg;
+    const ManifestReader *reader = chunks->reader;
+    size_t begin = chunks->start + index * MANIFEST_CHUNK_SIZE;
+    size_t limit = index + 1 == chunks->chunk_count ? reader->size : begin + MANIFEST_CHUNK_SIZE;
+
+    // 块起点落在行中间时，该行属于上一块
+    if (begin > chunks->start && reader->data[begin - 1] != '\n') {
+        const char *nl = memchr(reader->data + begin, '\n', reader->size - begin);
+        begin = nl ? (size_t)(nl - reader->data) + 1 : reader->size;
+    }
+
+    parse_lines(reader, reader->data, begin, limit, reader->size, chunks->fn, chunks->arg);
+}
+
+// 并行解压的共享状态：第 i 个任务负责第 first + i 块
+typedef struct {
+    const ManifestReader *reader;
+    size_t first;
+    ManifestEntryFn fn;
+    void *arg;
+    int failed;
+} ManifestBlockJob;
+
+static void parse_block(void *arg, size_t index) {
+    ManifestBlockJob *job = (ManifestBlockJob *)arg;
+    const GzBlockIndex *blocks = job->reader->blocks;
+    size_t block = job->first + index;
+    size_t usize = blocks->blocks[block].usize;
+
+    char *buf = malloc(usize ? usize : 1);
+    if (!buf || gzblock_inflate(blocks, block, buf) != 0) {
+        if (!buf) log_msg(LOG_ERROR, "内存分配失败: 压缩清单第 %zu 块", block);
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        free(buf);
+        return;
+    }
+    parse_lines(job->reader, buf, 0, usize, usize, job->fn, job->arg);
+    free(buf);
+}
+
+// 压缩清单：当前块剩余的行顺序解析，其余各块由工作池并行解压与解析
+static void for_each_block(ManifestReader *reader, ManifestEntryFn fn, void *arg) {
+    parse_lines(reader, reader->data, reader->pos, reader->size, reader->size, fn, arg);
+    reader->pos = reader->size;
+
+    ManifestBlockJob job;
+    job.reader = reader;
+    job.first = reader->block + 1;
+    job.fn = fn;
+    job.arg = arg;
+    job.failed = 0;
+    size_t count = reader->blocks->block_count;
+    if (job.first < count) {
+        if (g_hash_pool) {
+            thread_pool_parallel_for(g_hash_pool, count - job.first, parse_block, &job);
+        } else {
+            for (size_t i = 0; i < count - job.first; i++) parse_block(&job, i);
+        }
+    }
+    if (job.failed) reader->failed = 1;
+    reader->block = count;
+}
+
+// 解析剩余的全部条目，顺序不定：大清单按行边界切块，由工作池并行解析，fn 须线程安全
+void manifest_for_each(ManifestReader *reader, ManifestEntryFn fn, void *arg) {
+    if (!reader || !fn) return;
+    if (reader->blocks) {
+        for_each_block(reader, fn, arg);
+        return;
+    }
+
+    size_t remaining = reader->size - reader->pos;
+    if (reader->cursor || remaining < MANIFEST_PARALLEL_MIN || !g_hash_pool) {
+        ManifestEntry entry;
+        while (manifest_next(reader, &entry)) fn(arg, &entry);
+        return;
+    }
+
+    ManifestChunks chunks;
+    chunks.reader = reader;
+    chunks.start = reader->pos;
+    chunks.chunk_count = (remaining + MANIFEST_CHUNK_SIZE - 1) / MANIFEST_CHUNK_SIZE;
+    chunks.fn = fn;
+    chunks.arg = arg;
+    thread_pool_parallel_for(g_hash_pool, chunks.chunk_count, parse_chunk, &chunks);
+    reader->pos = reader->size;
+}
+
+// 按路径查找单个条目：二进制清单二分查找，文本清单从头顺序扫描；entry->path 即传入的 path
+int manifest_lookup(ManifestReader *reader, const char *path, ManifestEntry *entry) {
+    if (!reader || !path || !entry) return 0;
+    size_t len = strlen(path);
+
+    if (reader->cursor) {
+        size_t i;
+        if (!mgidx_find(&reader->index, path, len, &i)) return 0;
+        mgidx_record(&reader->index, i, &entry->digest, &entry->size, &entry->mtime);
+        entry->path = path;
+        entry->path_len = len;
+        return 1;
+    }
+
+    // 有序的压缩清单直接定位到可能包含该路径的块，遇到更大的路径即停止
+    int sorted = reader->blocks && reader->blocks->sorted;
+    if (reader->blocks) {
+        size_t block = sorted ? gzblock_find(reader->blocks, path, len) : 0;
+        if (load_block(reader, block) != 0) return 0;
+    }
+    if (!reader->blocks || reader->block == 0) reader->pos = reader->start;
+    while (manifest_next(reader, entry)) {
+        if (entry->path_len == len && memcmp(entry->path, path, len) == 0) return 1;
+        if (sorted) {
+            int cmp = memcmp(entry->path, path, entry->path_len < len ? entry->path_len : len);
+            if (cmp > 0 || (cmp == 0 && entry->path_len > len)) return 0;
+        }
+    }
+    return 0;
+}
+
+void manifest_close(ManifestReader *reader) {
+    if (!reader) return;
+    free(reader->cursor);
+    reader->cursor = NULL;
+    if (reader->blocks) {
+        // 压缩清单的映射由块索引持有，data 指向解压缓冲区
+        munmap((void *)reader->blocks->data, reader->blocks->size);
+        gzblock_close(reader->blocks);
+        free(reader->blocks);
+        reader->blocks = NULL;
+        free(reader->block_buf);
+        reader->block_buf = NULL;
+        reader->data = NULL;
+        reader->size = 0;
+    }
+    if (reader->data) {
+        munmap((void *)reader->data, reader->size);
+        reader->data = NULL;
+        reader->size = 0;
+    }
+}
+
+// 按 -o/--record-mtime 决定写出的附加字段；sha256sum 格式不带附加字段，二进制清单总是记录两者
+int manifest_output_fields(void) {
+    if (config.output_format && strcmp(config.output_format, "sha256sum") == 0) {
+        return 0;
+    }
+    if (manifest_output_binary()) {
+        return MANIFEST_FIELD_SIZE | MANIFEST_FIELD_MTIME;
+    }
+    return MANIFEST_FIELD_SIZE | (config.record_mtime ? MANIFEST_FIELD_MTIME : 0);
+}
+
+// -o mgidx：写出二进制清单
+int manifest_output_binary(void) {
+    return config.output_format && strcmp(config.output_format, "mgidx") == 0;
+}
+
+// 格式化清单头，返回长度；count 为 0 时不写条目数，shard 为分片字段 (可为空串)
+static int format_header(char *buf, size_t size, DigestAlgo algo, int fields, size_t count, const char *shard) {
+    const DigestEngine *engine = digest_engine_get(algo);
+    if (!engine) return -1;
+
+    const char *field_list = "";
+    if ((fields & MANIFEST_FIELD_SIZE) && (fields & MANIFEST_FIELD_MTIME)) field_list = " fields=size,mtime";
+    else if (fields & MANIFEST_FIELD_SIZE) field_list = " fields=size";
+    else if (fields & MANIFEST_FIELD_MTIME) field_list = " fields=mtime";
+
+    int len = count == 0
+        ? snprintf(buf, size, "%s algo=%s%s%s\n", MANIFEST_HEADER_PREFIX, engine->name, field_list, shard)
+        : snprintf(buf, size, "%s algo=%s%s count=%zu%s\n", MANIFEST_HEADER_PREFIX, engine->name, field_list,
+                   count, shard);
+    return len < 0 || (size_t)len >= size ? -1 : len;
+}
+
+// 格式化一行条目 <hash> [size] [mtime] *<path>，返回长度
+static int format_entry(char *buf, size_t size, const FileInfo *info, DigestAlgo algo, int fields) {
+    if (digest_format(&info->digest, algo, buf, size) != 0) return -1;
+    size_t len = strlen(buf);
+    if (fields & MANIFEST_FIELD_SIZE) len += snprintf(buf + len, size - len, " %zu", info->size);
+    if (fields & MANIFEST_FIELD_MTIME) len += snprintf(buf + len, size - len, " %lld", (long long)info->mtime);
+    size_t path_len = strlen(info->path);
+    if (len + path_len + 3 > size) return -1;
+    buf[len++] = ' ';
+    buf[len++] = '*';
+    memcpy(buf + len, info->path, path_len);
+    len += path_len;
+    buf[len++] = '\n';
+    return (int)len;
+}
+
+int manifest_write_header(FILE *fp, DigestAlgo algo, int fields, size_t count) {
+    char line[256];
+    int len = fp ? format_header(line, sizeof(line), algo, fields, count, "") : -1;
+    return len < 0 || fwrite(line, 1, (size_t)len, fp) != (size_t)len ? -1 : 0;
+}
+
+int manifest_write_entry(FILE *fp, const FileInfo *info, DigestAlgo algo, int fields) {
+    char line[MANIFEST_LINE_MAX];
+    int len = fp && info ? format_entry(line, sizeof(line), info, algo, fields) : -1;
+    return len < 0 || fwrite(line, 1, (size_t)len, fp) != (size_t)len ? -1 : 0;
+}
+
+// 打开文本清单写出器；compress 非 0 时写成分块压缩清单
+int manifest_writer_open(ManifestWriter *writer, const char *path, DigestAlgo algo, int fields, int compress) {
+    memset(writer, 0, sizeof(ManifestWriter));
+    writer->algo = algo;
+    writer->fields = fields;
+    shard_format(writer->shard, sizeof(writer->shard), config.shard_index, config.shard_count, config.shard_by_dir);
+
+    writer->fp = fopen(path, "wb");
+    if (!writer->fp) {
+        log_msg(LOG_ERROR, "无法创建清单 '%s': %s", path, strerror(errno));
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    writer->buffer = malloc(MANIFEST_WRITE_BUFFER);
+    if (writer->buffer) setvbuf(writer->fp, writer->buffer, _IOFBF, MANIFEST_WRITE_BUFFER);
+    if (compress) {
+        writer->gz = gzblock_writer_open(writer->fp);
+        if (!writer->gz) {
+            log_msg(LOG_ERROR, gzblock_available() ? "无法创建压缩清单写出器" : "当前构建不支持压缩清单 (编译时未找到 zlib)");
+            fclose(writer->fp);
+            free(writer->buffer);
+            writer->fp = NULL;
+            return MIRRORGUARD_ERROR_GENERAL;
+        }
+    }
+    return MIRRORGUARD_OK;
+}
+
+static void writer_put(ManifestWriter *writer, const char *line, int len, const char *path) {
+    if (len < 0) {
+        writer->failed = 1;
+    } else if (writer->gz) {
+        size_t path_len = path ? strlen(path) : 0;
+        if (gzblock_writer_add(writer->gz, line, (size_t)len, path, path_len) != 0) writer->failed = 1;
+    } else if (fwrite(line, 1, (size_t)len, writer->fp) != (size_t)len) {
+        writer->failed = 1;
+    }
+}
+
+int manifest_writer_header(ManifestWriter *writer, size_t count) {
+    char line[256];
+    writer_put(writer, line, format_header(line, sizeof(line), writer->algo, writer->fields, count, writer->shard),
+               NULL);
+    return writer->failed ? -1 : 0;
+}
+
+int manifest_writer_entry(ManifestWriter *writer, const FileInfo *info) {
+    char line[MANIFEST_LINE_MAX];
+    writer_put(writer, line, format_entry(line, sizeof(line), info, writer->algo, writer->fields), info->path);
+    return writer->failed ? -1 : 0;
+}
+
+// 结束写出 (压缩时写出块索引) 并关闭文件；任一步失败返回 -1
+int manifest_writer_close(ManifestWriter *writer) {
+    if (!writer->fp) return -1;
+    if (writer->gz && gzblock_writer_close(writer->gz) != 0) writer->failed = 1;
+    if (fclose(writer->fp) != 0) writer->failed = 1;
+    free(writer->buffer);
+    writer->gz = NULL;
+    writer->fp = NULL;
+    writer->buffer = NULL;
+    return writer->failed ? -1 : 0;
+}
@@ -0,0 +1,302 @@
+#include "mgidx.h"
+#include "manifest.h"
+#include "logging.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// 只看魔数：截断在文件头内的二进制清单也按二进制清单处理，由 mgidx_attach 报告损坏
+int mgidx_detect(const void *data, size_t size) {
+    return data && size >= 8 && memcmp(data, MGIDX_MAGIC, 8) == 0;
+}
+
+// 源目录区须含 root_count 个以 '\0' 结尾的字符串
+static int roots_valid(const MgIndexHeader *header, const unsigned char *data) {
+    const unsigned char *p = data + header->roots_offset;
+    const unsigned char *end = data + header->index_offset;
+    for (uint32_t n = 0; n < header->root_count; n++) {
+        const unsigned char *nul = memchr(p, '\0', (size_t)(end - p));
+        if (!nul) return 0;
+        p = nul + 1;
+    }
+    return 1;
+}
+
+// 检查文件头与各区的偏移，之后的读取只需检查路径表内的偏移
+int mgidx_attach(MgIndex *index, const void *data, size_t size) {
+    memset(index, 0, sizeof(MgIndex));
+    if (!mgidx_detect(data, size)) return -1;
+    if (size < sizeof(MgIndexHeader)) {
+        log_msg(LOG_ERROR, "二进制清单结构损坏");
+        return -1;
+    }
+
+    const MgIndexHeader *h = (const MgIndexHeader *)data;
+    if (h->version != MGIDX_VERSION) {
+        log_msg(LOG_ERROR, "不支持的二进制清单版本: %u", h->version);
+        return -1;
+    }
+    const DigestEngine *engine = digest_engine_get((DigestAlgo)h->algo);
+    if (!engine || !engine->available) {
+        log_msg(LOG_ERROR, "当前构建不支持二进制清单的摘要算法 (%u)", h->algo);
+        return -1;
+    }
+
+    size_t restart_count = 0;
+    int valid = h->digest_len == engine->digest_len &&
+                h->record_size == MGIDX_RECORD_SIZE(h->digest_len) &&
+                h->count <= size / h->record_size &&
+                h->roots_offset >= sizeof(MgIndexHeader) &&
+                h->index_offset >= h->roots_offset && h->index_offset % sizeof(uint64_t) == 0 &&
+                h->records_offset >= h->index_offset &&
+                h->paths_offset >= h->records_offset &&
+                h->paths_offset <= size && h->paths_size <= size - h->paths_offset;
+    if (valid) {
+        restart_count = (h->count + MGIDX_RESTART_INTERVAL - 1) / MGIDX_RESTART_INTERVAL;
+        valid = (h->records_offset - h->index_offset) / sizeof(uint64_t) >= restart_count &&
+                (h->paths_offset - h->records_offset) / h->record_size >= h->count &&
+                roots_valid(h, (const unsigned char *)data);
+    }
+    if (!valid) {
+        log_msg(LOG_ERROR, "二进制清单结构损坏");
+        return -1;
+    }
+
+    index->data = (const unsigned char *)data;
+    index->size = size;
+    index->header = h;
+    index->records = index->data + h->records_offset;
+    index->paths = index->data + h->paths_offset;
+    index->restart_count = restart_count;
+    return 0;
+}
+
+// 第 n 个源目录，不存在时返回 NULL
+const char* mgidx_root(const MgIndex *index, uint32_t n) {
+    if (n >= index->header->root_count) return NULL;
+    const char *p = (const char *)index->data + index->header->roots_offset;
+    while (n-- > 0) p += strlen(p) + 1;
+    return p;
+}
+
+// 第 i 条记录；清单未记录的大小/mtime 置为 -1
+void mgidx_record(const MgIndex *index, size_t i, Digest *digest, long long *size, long long *mtime) {
+    const unsigned char *p = index->records + i * index->header->record_size;
+    MgIndexRecord record;
+    memcpy(&record, p, sizeof(record));
+    digest_set(digest, p + sizeof(record), index->header->digest_len, (size_t)record.tree_block_size);
+    *size = (index->header->fields & MANIFEST_FIELD_SIZE) ? (long long)record.size : -1;
+    *mtime = (index->header->fields & MANIFEST_FIELD_MTIME) ? (long long)record.mtime : -1;
+}
+
+// 读取 offset 处的路径头；越界、共享前缀超过上一条或还原后过长时返回 -1
+static int read_path(const MgIndex *index, size_t offset, size_t prev_len, MgIndexPathHeader *path) {
+    size_t paths_size = index->header->paths_size;
+    if (offset > paths_size || paths_size - offset < sizeof(MgIndexPathHeader)) return -1;
+    memcpy(path, index->paths + offset, sizeof(MgIndexPathHeader));
+    if (path->shared > prev_len || (size_t)path->shared + path->suffix_len >= MAX_PATH ||
+        paths_size - offset - sizeof(MgIndexPathHeader) < path->suffix_len) {
+        return -1;
+    }
+    return 0;
+}
+
+void mgidx_cursor_init(MgIndexCursor *cursor, const MgIndex *index) {
+    cursor->index = index;
+    cursor->pos = 0;
+    cursor->offset = 0;
+    cursor->path_len = 0;
+    cursor->path[0] = '\0';
+}
+
+// 还原下一条路径，*i 为其记录序号；返回 1 表示读到条目，0 表示结束或路径表损坏
+int mgidx_cursor_next(MgIndexCursor *cursor, size_t *i) {
+    const MgIndex *index = cursor->index;
+    if (cursor->pos >= index->header->count) return 0;
+
+    // 重启点不与上一条共享前缀
+    size_t prev_len = cursor->pos % MGIDX_RESTART_INTERVAL == 0 ? 0 : cursor->path_len;
+    MgIndexPathHeader path;
+    if (read_path(index, cursor->offset, prev_len, &path) != 0) {
+        log_msg(LOG_ERROR, "二进制清单路径表损坏 (条目 %zu)", cursor->pos);
+        cursor->pos = index->header->count;
+        return 0;
+    }
+    memcpy(cursor->path + path.shared, index->paths + cursor->offset + sizeof(path), path.suffix_len);
+    cursor->path_len = (size_t)path.shared + path.suffix_len;
+    cursor->path[cursor->path_len] = '\0';
+    cursor->offset += sizeof(path) + path.suffix_len;
+    *i = cursor->pos++;
+    return 1;
+}
+
+static int compare_path(const char *a, size_t a_len, const char *b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp != 0) return cmp;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+// 按路径查找：在重启点上二分 (重启点存完整路径，直接比较)，再在组内顺序还原至多 16 条
+int mgidx_find(const MgIndex *index, const char *path, size_t len, size_t *i) {
+    const uint64_t *restarts = (const uint64_t *)(index->data + index->header->index_offset);
+
+    // 最后一个首条路径不大于 path 的组
+    size_t lo = 0;
+    size_t hi = index->restart_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        MgIndexPathHeader first;
+        if (read_path(index, restarts[mid], 0, &first) != 0) {
+            log_msg(LOG_ERROR, "二进制清单索引损坏 (重启点 %zu)", mid);
+            return 0;
+        }
+        const char *first_path = (const char *)index->paths + restarts[mid] + sizeof(first);
+        if (compare_path(first_path, first.suffix_len, path, len) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+
+    MgIndexCursor cursor;
+    mgidx_cursor_init(&cursor, index);
+    cursor.pos = (lo - 1) * MGIDX_RESTART_INTERVAL;
+    cursor.offset = restarts[lo - 1];
+    size_t end = cursor.pos + MGIDX_RESTART_INTERVAL;
+    size_t found;
+    while (cursor.pos < end && mgidx_cursor_next(&cursor, &found)) {
+        int cmp = compare_path(cursor.path, cursor.path_len, path, len);
+        if (cmp == 0) {
+            *i = found;
+            return 1;
+        }
+        if (cmp > 0) break;
+    }
+    return 0;
+}
+
+// 按路径有序写出记录与路径表；记录与路径表各用一个流，写在文件的两个区域
+static int write_entries(FILE *fp, FILE *paths_fp, FileList *list, const MgIndexHeader *header,
+                         uint64_t *restarts, uint64_t *paths_size) {
+    FileListIter it;
+    if (file_list_iter_begin(list, &it) != 0) return -1;
+
+    unsigned char record[MGIDX_RECORD_SIZE(MAX_DIGEST_LENGTH)];
+    char prev[MAX_PATH];
+    size_t prev_len = 0;
+    uint64_t offset = 0;
+    size_t n = 0;
+    int result = 0;
+    const FileInfo *info;
+    while (result == 0 && (info = file_list_iter_next(&it)) != NULL) {
+        if (info->digest.len != header->digest_len) {
+            log_msg(LOG_ERROR, "条目摘要长度与清单算法不符: %s", info->path);
+            result = -1;
+            break;
+        }
+
+        MgIndexRecord fixed;
+        fixed.size = info->size;
+        fixed.mtime = info->mtime;
+        fixed.tree_block_size = info->digest.tree_block_size;
+        memset(record, 0, header->record_size);
+        memcpy(record, &fixed, sizeof(fixed));
+        memcpy(record + sizeof(fixed), info->digest.bytes, info->digest.len);
+
+        // 路径与上一条共享前缀，重启点写完整路径并记入稀疏索引
+        size_t len = strlen(info->path);
+        size_t shared = 0;
+        if (n % MGIDX_RESTART_INTERVAL == 0) {
+            restarts[n / MGIDX_RESTART_INTERVAL] = offset;
+        } else {
+            size_t limit = len < prev_len ? len : prev_len;
+            while (shared < limit && info->path[shared] == prev[shared]) shared++;
+        }
+        MgIndexPathHeader path;
+        path.shared = (uint16_t)shared;
+        path.suffix_len = (uint16_t)(len - shared);
+
+        if (fwrite(record, header->record_size, 1, fp) != 1 ||
+            fwrite(&path, sizeof(path), 1, paths_fp) != 1 ||
+            fwrite(info->path + shared, 1, path.suffix_len, paths_fp) != path.suffix_len) {
+            result = -1;
+        }
+        offset += sizeof(path) + path.suffix_len;
+        memcpy(prev, info->path, len);
+        prev_len = len;
+        n++;
+    }
+    file_list_iter_end(&it);
+
+    if (result == 0 && n != header->count) {
+        log_msg(LOG_ERROR, "条目数与文件列表不符 (%zu/%zu)", n, (size_t)header->count);
+        result = -1;
+    }
+    *paths_size = offset;
+    return result;
+}
+
+// 把文件列表写成二进制清单 (path 通常为临时文件，由调用方原子重命名)
+int mgidx_write(const char *path, FileList *list, DigestAlgo algo, int fields, const char *const *roots,
+                int root_count) {
+    const DigestEngine *engine = digest_engine_get(algo);
+    if (!path || !list || !engine) return MIRRORGUARD_ERROR_INVALID_ARGS;
+
+    MgIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MGIDX_MAGIC, sizeof(header.magic));
+    header.version = MGIDX_VERSION;
+    header.record_size = MGIDX_RECORD_SIZE(engine->digest_len);
+    header.algo = (uint8_t)algo;
+    header.digest_len = (uint8_t)engine->digest_len;
+    header.fields = (uint8_t)fields;
+    header.root_count = (uint32_t)root_count;
+    header.count = file_list_total(list);
+
+    size_t roots_size = 0;
+    for (int i = 0; i < root_count; i++) roots_size += strlen(roots[i]) + 1;
+    size_t restart_count = (header.count + MGIDX_RESTART_INTERVAL - 1) / MGIDX_RESTART_INTERVAL;
+    header.roots_offset = sizeof(MgIndexHeader);
+    header.index_offset = header.roots_offset + ((roots_size + 7) & ~(size_t)7);
+    header.records_offset = header.index_offset + restart_count * sizeof(uint64_t);
+    header.paths_offset = header.records_offset + header.count * header.record_size;
+
+    uint64_t *restarts = calloc(restart_count ? restart_count : 1, sizeof(uint64_t));
+    FILE *fp = fopen(path, "wb");
+    FILE *paths_fp = fp ? fopen(path, "r+b") : NULL;
+    if (!restarts || !fp || !paths_fp) {
+        log_msg(LOG_ERROR, "无法创建二进制清单 '%s': %s", path, strerror(errno));
+        if (paths_fp) fclose(paths_fp);
+        if (fp) fclose(fp);
+        free(restarts);
+        return restarts ? MIRRORGUARD_ERROR_FILE_IO : MIRRORGUARD_ERROR_MEMORY;
+    }
+
+    // 文件头最后写入 (路径表长度此时才确定)
+    static const char zeros[8];
+    int failed = fwrite(&header, sizeof(header), 1, fp) != 1;
+    for (int i = 0; i < root_count && !failed; i++) {
+        failed = fwrite(roots[i], 1, strlen(roots[i]) + 1, fp) != strlen(roots[i]) + 1;
+    }
+    if (!failed && header.index_offset - header.roots_offset > roots_size) {
+        size_t pad = header.index_offset - header.roots_offset - roots_size;
+        failed = fwrite(zeros, 1, pad, fp) != pad;
+    }
+    failed = failed ||
+             fseeko(fp, (off_t)header.records_offset, SEEK_SET) != 0 ||
+             fseeko(paths_fp, (off_t)header.paths_offset, SEEK_SET) != 0 ||
+             write_entries(fp, paths_fp, list, &header, restarts, &header.paths_size) != 0;
+    failed = fclose(paths_fp) != 0 || failed;
+    failed = failed ||
+             fseeko(fp, (off_t)header.index_offset, SEEK_SET) != 0 ||
+             fwrite(restarts, sizeof(uint64_t), restart_count, fp) != restart_count ||
+             fseeko(fp, 0, SEEK_SET) != 0 ||
+             fwrite(&header, sizeof(header), 1, fp) != 1;
+    failed = fclose(fp) != 0 || failed;
+    free(restarts);
+
+    if (failed) {
+        log_msg(LOG_ERROR, "写入二进制清单 '%s' 失败: %s", path, strerror(errno));
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    return MIRRORGUARD_OK;
+}
@@ -1,10 +1,10 @@
 #include "path_utils.h"
 #include "config.h"
 #include "logging.h"
+#include "shard.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <unistd.h>
 
 extern Config config;
@@ -117,8 +117,8 @@ int is_safe_path(const char *path) {
     return 1;
 }
 
-// 检查是否应排除文件
-int should_exclude(const char *path) {
+// 检查是否应跳过目录项：隐藏文件与排除模式 (目录被跳过时其下条目不再遍历)
+int should_exclude_dir(const char *path) {
     if (!path) return 1;
 
     // 检查隐藏文件
@@ -132,59 +132,23 @@ int should_exclude(const char *path) {
         }
     }
 
-    // 检查包含模式
-    if (config.include_count > 0) {
-        int matched = 0;
-        for (int i = 0; i < config.include_count; i++) {
-            if (config.include_patterns[i]) {
-                if (config.case_sensitive) {
-                    if (strstr(path, config.include_patterns[i])) {
-                        matched = 1;
-                        break;
-                    }
-                } else {
-                    char *lower_path = strdup(path);
-                    char *lower_pattern = strdup(config.include_patterns[i]);
-                    if (lower_path && lower_pattern) {
-                        for (char *p = lower_path; *p; p++) *p = tolower(*p);
-                        for (char *p = lower_pattern; *p; p++) *p = tolower(*p);
-                        if (strstr(lower_path, lower_pattern)) {
-                            matched = 1;
-                        }
-                    }
-                    free(lower_path);
-                    free(lower_pattern);
-                    if (matched) break;
-                }
-            }
-        }
-        if (!matched) return 1;
-    }
+    // 按首级目录分片时，不属于本分片的首级目录整棵跳过
+    if (config.shard_count > 1 && config.shard_by_dir && !shard_selected(path)) return 1;
 
-    // 检查排除模式
-    for (int i = 0; i < config.exclude_count; i++) {
-        if (config.exclude_patterns[i]) {
-            if (config.case_sensitive) {
-                if (strstr(path, config.exclude_patterns[i])) {
-                    return 1;
-                }
-            } else {
-                char *lower_path = strdup(path);
-                char *lower_pattern = strdup(config.exclude_patterns[i]);
-                if (lower_path && lower_pattern) {
-                    for (char *p = lower_path; *p; p++) *p = tolower(*p);
-                    for (char *p = lower_pattern; *p; p++) *p = tolower(*p);
-                    if (strstr(lower_path, lower_pattern)) {
-                        free(lower_path);
-                        free(lower_pattern);
-                        return 1;
-                    }
-                }
-                free(lower_path);
-                free(lower_pattern);
-            }
-        }
+    // 检查排除模式 (编译后的自动机，一次扫描)
+    return pattern_set_match(config.exclude_patterns, path);
+}
+
+// 检查是否应排除文件：在目录项检查之外，设置了包含模式时还须匹配其一
+int should_exclude(const char *path) {
+    if (should_exclude_dir(path)) return 1;
+
+    if (pattern_set_count(config.include_patterns) > 0 && !pattern_set_match(config.include_patterns, path)) {
+        return 1;
     }
 
+    // 按路径分片只作用于文件，目录照常遍历
+    if (config.shard_count > 1 && !config.shard_by_dir && !shard_selected(path)) return 1;
+
     return 0;
 }
@@ -0,0 +1,341 @@
+#include "pattern.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+typedef enum {
+    PATTERN_SUBSTRING = 0,         // 普通字符串，自动机命中即匹配
+    PATTERN_GLOB                   // 通配/锚定模式，自动机命中其最长字面量后再精确匹配
+} PatternKind;
+
+typedef struct {
+    char *text;                    // 模式文本 (锚定模式已去掉开头的 '/')
+    size_t len;
+    PatternKind kind;
+    int anchored;
+    int32_t next_dup;              // 在同一状态结束的下一个模式 (-1 结束)
+} Pattern;
+
+struct PatternSet {
+    Pattern *patterns;
+    size_t count;
+    size_t capacity;
+    int compiled;
+    int match_all;                 // 含空的普通字符串 (匹配任意路径)
+    int case_insensitive;
+    uint8_t class_map[256];        // 输入字节 → 字符类 (已含大小写折叠)，0 为模式中未出现的字节
+    size_t class_count;
+    int32_t *next;                 // 完整转移表: 状态 * class_count + 字符类
+    int32_t *match;                // 在该状态结束的第一个模式 (-1 表示无)
+    int32_t *dict;                 // 失败链上最近的有输出状态 (0 表示无)
+    size_t state_count;
+    int32_t *always;               // 没有可用字面量的通配模式，每条路径都需检查
+    size_t always_count;
+};
+
+PatternSet* pattern_set_create(void) {
+    return calloc(1, sizeof(PatternSet));
+}
+
+int pattern_set_add(PatternSet *set, const char *pattern) {
+    if (!set || !pattern || set->compiled) return -1;
+
+    if (set->count == set->capacity) {
+        size_t new_capacity = set->capacity ? set->capacity * 2 : 16;
+        Pattern *patterns = realloc(set->patterns, new_capacity * sizeof(Pattern));
+        if (!patterns) return -1;
+        set->patterns = patterns;
+        set->capacity = new_capacity;
+    }
+
+    Pattern *pat = &set->patterns[set->count];
+    pat->anchored = pattern[0] == '/';
+    const char *text = pat->anchored ? pattern + 1 : pattern;
+    pat->text = strdup(text);
+    if (!pat->text) return -1;
+    pat->len = strlen(text);
+    pat->kind = (pat->anchored || strpbrk(text, "*?[")) ? PATTERN_GLOB : PATTERN_SUBSTRING;
+    pat->next_dup = -1;
+    set->count++;
+    return 0;
+}
+
+size_t pattern_set_count(const PatternSet *set) {
+    return set ? set->count : 0;
+}
+
+void pattern_set_free(PatternSet *set) {
+    if (!set) return;
+    for (size_t i = 0; i < set->count; i++) {
+        free(set->patterns[i].text);
+    }
+    free(set->patterns);
+    free(set->next);
+    free(set->match);
+    free(set->dict);
+    free(set->always);
+    free(set);
+}
+
+// 字符类 [...] 的结束位置 (']' 之后)，未闭合时返回 NULL 按普通字符处理
+static const char* class_end(const char *p, const char *pe) {
+    const char *q = p + 1;
+    if (q < pe && (*q == '!' || *q == '^')) q++;
+    if (q < pe && *q == ']') q++;
+    while (q < pe && *q != ']') {
+        if (*q == '\\' && q + 1 < pe) q++;
+        q++;
+    }
+    return q < pe ? q + 1 : NULL;
+}
+
+// 通配模式中最长的一段字面量 (不含字符类与转义)，作为自动机的预筛选键
+static void glob_literal(const Pattern *pat, size_t *start, size_t *len) {
+    const char *pe = pat->text + pat->len;
+    const char *run = pat->text;
+    *start = 0;
+    *len = 0;
+    for (const char *p = pat->text; ; ) {
+        const char *next = p + 1;
+        if (p < pe && *p == '[') {
+            const char *end = class_end(p, pe);
+            if (!end) {
+                p++;
+                continue;
+            }
+            next = end;
+        } else if (p < pe && *p == '\\') {
+            next = p + 2 < pe ? p + 2 : pe;
+        } else if (p + 2 < pe && p[0] == '*' && p[1] == '*' && p[2] == '/') {
+            // **/ 可以匹配零个目录，其后的 '/' 不是必需的字面量
+            next = p + 3;
+        } else if (p < pe && *p != '*' && *p != '?') {
+            p++;
+            continue;
+        }
+        if ((size_t)(p - run) > *len) {
+            *start = (size_t)(run - pat->text);
+            *len = (size_t)(p - run);
+        }
+        if (p >= pe) return;
+        p = run = next;
+    }
+}
+
+// 自动机的键：普通字符串为全文，通配模式为其最长字面量
+static void pattern_key(const Pattern *pat, const char **key, size_t *len) {
+    if (pat->kind == PATTERN_SUBSTRING) {
+        *key = pat->text;
+        *len = pat->len;
+        return;
+    }
+    size_t start;
+    glob_literal(pat, &start, len);
+    *key = pat->text + start;
+}
+
+// 编译全部模式：建立字符类、trie 与失败链，并补全为确定性转移表
+int pattern_set_compile(PatternSet *set, int case_insensitive) {
+    if (!set) return 0;
+    if (set->compiled) return 0;
+
+    // 大小写折叠表 (区分大小写时为恒等映射)
+    unsigned char fold[256];
+    set->case_insensitive = case_insensitive;
+    for (int c = 0; c < 256; c++) {
+        fold[c] = (unsigned char)(case_insensitive ? tolower(c) : c);
+    }
+
+    // 字符类：只为模式中出现过的 (折叠后) 字节分配，其余字节共用 0 类
+    uint8_t class_of[256] = {0};
+    size_t class_count = 1;
+    size_t max_states = 1;
+    set->always = malloc((set->count ? set->count : 1) * sizeof(int32_t));
+    if (!set->always) return -1;
+    for (size_t i = 0; i < set->count; i++) {
+        const char *key;
+        size_t len;
+        pattern_key(&set->patterns[i], &key, &len);
+        if (len == 0) {
+            if (set->patterns[i].kind == PATTERN_SUBSTRING) set->match_all = 1;
+            else set->always[set->always_count++] = (int32_t)i;
+            continue;
+        }
+        for (size_t j = 0; j < len; j++) {
+            unsigned char b = fold[(unsigned char)key[j]];
+            if (class_of[b] == 0) class_of[b] = (uint8_t)class_count++;
+        }
+        max_states += len;
+    }
+    for (int c = 0; c < 256; c++) {
+        set->class_map[c] = class_of[fold[c]];
+    }
+    set->class_count = class_count;
+
+    set->next = calloc(max_states * class_count, sizeof(int32_t));
+    set->match = malloc(max_states * sizeof(int32_t));
+    set->dict = calloc(max_states, sizeof(int32_t));
+    int32_t *fail = calloc(max_states, sizeof(int32_t));
+    int32_t *queue = malloc(max_states * sizeof(int32_t));
+    if (!set->next || !set->match || !set->dict || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return -1;
+    }
+    for (size_t s = 0; s < max_states; s++) {
+        set->match[s] = -1;
+    }
+
+    // trie：状态 0 为根，子状态编号恒大于 0
+    size_t state_count = 1;
+    for (size_t i = 0; i < set->count; i++) {
+        const char *key;
+        size_t len;
+        pattern_key(&set->patterns[i], &key, &len);
+        if (len == 0) continue;
+        size_t s = 0;
+        for (size_t j = 0; j < len; j++) {
+            int32_t *edge = &set->next[s * class_count + class_of[fold[(unsigned char)key[j]]]];
+            if (*edge == 0) *edge = (int32_t)state_count++;
+            s = (size_t)*edge;
+        }
+        set->patterns[i].next_dup = set->match[s];
+        set->match[s] = (int32_t)i;
+    }
+
+    // 按层遍历计算失败链；缺失的转移指向失败状态的转移，得到完整的确定性自动机
+    size_t head = 0, tail = 0;
+    for (size_t c = 0; c < class_count; c++) {
+        if (set->next[c]) queue[tail++] = set->next[c];
+    }
+    while (head < tail) {
+        size_t s = (size_t)queue[head++];
+        for (size_t c = 0; c < class_count; c++) {
+            int32_t *edge = &set->next[s * class_count + c];
+            int32_t fallback = set->next[(size_t)fail[s] * class_count + c];
+            if (*edge) {
+                int32_t child = *edge;
+                fail[child] = fallback;
+                set->dict[child] = set->match[fallback] >= 0 ? fallback : set->dict[fallback];
+                queue[tail++] = child;
+            } else {
+                *edge = fallback;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+
+    set->state_count = state_count;
+    int32_t *next = realloc(set->next, state_count * class_count * sizeof(int32_t));
+    if (next) set->next = next;
+    set->compiled = 1;
+    return 0;
+}
+
+static int class_contains(const char *p, const char *end, unsigned char c) {
+    const char *q = p + 1;
+    int negate = *q == '!' || *q == '^';
+    if (negate) q++;
+    int found = 0;
+    const char *last = end - 1;  // 结尾的 ']'
+    for (int first = 1; q < last; first = 0) {
+        if (*q == ']' && !first) break;
+        if (*q == '\\' && q + 1 < last) q++;
+        unsigned char lo = (unsigned char)*q++;
+        unsigned char hi = lo;
+        if (q + 1 < last && *q == '-') {
+            q++;
+            if (*q == '\\' && q + 1 < last) q++;
+            hi = (unsigned char)*q++;
+        }
+        if (c >= lo && c <= hi) found = 1;
+    }
+    return found != negate;
+}
+
+static int class_match(int case_insensitive, const char *p, const char *end, unsigned char c) {
+    if (class_contains(p, end, c)) return 1;
+    if (!case_insensitive) return 0;
+    // 不区分大小写时两种写法任一在类中即可
+    return class_contains(p, end, (unsigned char)tolower(c)) || class_contains(p, end, (unsigned char)toupper(c));
+}
+
+// 通配匹配: * 不跨越 '/'，** 可跨越 (a/**/b 也匹配 a/b)，? 匹配单个非 '/' 字符，\ 转义；
+// 模式只需匹配到某个路径分隔处为止 (匹配目录即匹配其下所有条目)
+static int glob_match(int case_insensitive, const char *p, const char *pe, const char *s, const char *se) {
+    while (p < pe) {
+        if (*p == '*') {
+            int any = p + 1 < pe && p[1] == '*';
+            p += any ? 2 : 1;
+            if (any && p < pe && *p == '/' && glob_match(case_insensitive, p + 1, pe, s, se)) return 1;
+            for (const char *t = s; ; t++) {
+                if (glob_match(case_insensitive, p, pe, t, se)) return 1;
+                if (t == se || (!any && *t == '/')) return 0;
+            }
+        }
+        if (s == se) return 0;
+        unsigned char c = (unsigned char)*s;
+        const char *end;
+        if (*p == '?') {
+            if (c == '/') return 0;
+            p++;
+        } else if (*p == '[' && (end = class_end(p, pe)) != NULL) {
+            if (c == '/' || !class_match(case_insensitive, p, end, c)) return 0;
+            p = end;
+        } else {
+            if (*p == '\\' && p + 1 < pe) p++;
+            unsigned char pc = (unsigned char)*p;
+            if (pc != c && (!case_insensitive || tolower(pc) != tolower(c))) return 0;
+            p++;
+        }
+        s++;
+    }
+    return s == se || *s == '/';
+}
+
+// 单个通配模式与整个路径匹配 (语法同上)，供忽略文件等按规则顺序求值的场合使用
+int pattern_glob_match(const char *pattern, size_t pattern_len, const char *path, size_t path_len,
+                       int case_insensitive) {
+    return glob_match(case_insensitive, pattern, pattern + pattern_len, path, path + path_len);
+}
+
+// 锚定模式从路径起始处匹配，其余模式可从任一路径分量开始
+static int glob_path_match(const PatternSet *set, const Pattern *pat, const char *path, size_t len) {
+    const char *pe = pat->text + pat->len;
+    const char *se = path + len;
+    if (pat->anchored) return glob_match(set->case_insensitive, pat->text, pe, path, se);
+    for (const char *s = path; ; s++) {
+        if (glob_match(set->case_insensitive, pat->text, pe, s, se)) return 1;
+        s = memchr(s, '/', (size_t)(se - s));
+        if (!s) return 0;
+    }
+}
+
+// 路径是否匹配集合中任一模式；集合为空或未编译时返回 0
+int pattern_set_match(const PatternSet *set, const char *path) {
+    if (!set || !set->compiled || set->count == 0 || !path) return 0;
+    if (set->match_all) return 1;
+
+    size_t len = strlen(path);
+    size_t class_count = set->class_count;
+    if (set->state_count > 1) {
+        size_t state = 0;
+        for (size_t i = 0; i < len; i++) {
+            state = (size_t)set->next[state * class_count + set->class_map[(unsigned char)path[i]]];
+            size_t out = set->match[state] >= 0 ? state : (size_t)set->dict[state];
+            for (; out != 0; out = (size_t)set->dict[out]) {
+                for (int32_t id = set->match[out]; id >= 0; id = set->patterns[id].next_dup) {
+                    const Pattern *pat = &set->patterns[id];
+                    if (pat->kind == PATTERN_SUBSTRING || glob_path_match(set, pat, path, len)) return 1;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < set->always_count; i++) {
+        if (glob_path_match(set, &set->patterns[set->always[i]], path, len)) return 1;
+    }
+    return 0;
+}
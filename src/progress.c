@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -17,6 +18,8 @@ void init_progress_bars() {
         config.progress_bars[i].current = 0;
         config.progress_bars[i].total = 0;
         config.progress_bars[i].speed = 0.0;
+        config.progress_bars[i].last_current = 0;
+        config.progress_bars[i].eta = -1.0;
         config.progress_bars[i].last_update = time(NULL);
         config.progress_bars[i].active = 0;
         config.progress_bars[i].finished = 0;
@@ -34,6 +37,9 @@ void create_progress_bar(const char *name, size_t total, int index) {
     config.progress_bars[index].name[MAX_PATH - 1] = '\0';
     config.progress_bars[index].total = total;
     config.progress_bars[index].current = 0;
+    config.progress_bars[index].last_current = 0;
+    config.progress_bars[index].last_update = time(NULL);
+    config.progress_bars[index].eta = -1.0;
     config.progress_bars[index].active = 1;
     config.progress_bars[index].finished = 0;
     config.progress_bars[index].style = config.progress_style;
@@ -49,16 +55,17 @@ void update_progress_bar(int index, size_t current) {
     if (index >= MAX_PROGRESS_BARS || config.no_progress_bar) return;
     
     pthread_mutex_lock(&config.progress_bars[index].lock);
-    config.progress_bars[index].current = current;
     time_t now = time(NULL);
     if (now != config.progress_bars[index].last_update) {
         double elapsed = now - config.progress_bars[index].last_update;
-        if (elapsed > 0) {
+        if (elapsed > 0 && current >= config.progress_bars[index].last_current) {
             config.progress_bars[index].speed = 
-                (current - config.progress_bars[index].current) / elapsed;
+                (current - config.progress_bars[index].last_current) / elapsed;
         }
         config.progress_bars[index].last_update = now;
+        config.progress_bars[index].last_current = current;
     }
+    config.progress_bars[index].current = current;
     pthread_mutex_unlock(&config.progress_bars[index].lock);
     
     if (config.progress) {
@@ -66,6 +73,15 @@ void update_progress_bar(int index, size_t current) {
     }
 }
 
+// 总数在运行中才能确定或修正时更新 (如按清单大小估算的条目数)
+void set_progress_total(int index, size_t total) {
+    if (index >= MAX_PROGRESS_BARS || config.no_progress_bar) return;
+
+    pthread_mutex_lock(&config.progress_bars[index].lock);
+    config.progress_bars[index].total = total;
+    pthread_mutex_unlock(&config.progress_bars[index].lock);
+}
+
 void finish_progress_bar(int index) {
     if (index >= MAX_PROGRESS_BARS || config.no_progress_bar) return;
     
@@ -79,6 +95,33 @@ void finish_progress_bar(int index) {
     }
 }
 
+// 扫描/哈希流水线进度：总数取遍历已发现的文件数，遍历结束后按字节速率估算剩余时间
+void update_scan_progress(int index) {
+    if (index >= MAX_PROGRESS_BARS || config.no_progress_bar) return;
+
+    size_t total = __atomic_load_n(&stats.scanned_files, __ATOMIC_RELAXED);
+    size_t done = __atomic_load_n(&stats.hashed_files, __ATOMIC_RELAXED);
+    double eta = -1.0;
+    if (__atomic_load_n(&stats.scan_complete, __ATOMIC_RELAXED)) {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        double elapsed = (now.tv_sec - stats.start_time.tv_sec) +
+                         (now.tv_usec - stats.start_time.tv_usec) / 1000000.0;
+        size_t total_bytes = __atomic_load_n(&stats.scanned_bytes, __ATOMIC_RELAXED);
+        size_t done_bytes = __atomic_load_n(&stats.hashed_bytes, __ATOMIC_RELAXED);
+        if (elapsed > 0 && done_bytes > 0 && total_bytes >= done_bytes) {
+            eta = (total_bytes - done_bytes) / (done_bytes / elapsed);
+        }
+    }
+
+    pthread_mutex_lock(&config.progress_bars[index].lock);
+    config.progress_bars[index].total = total;
+    config.progress_bars[index].eta = eta;
+    pthread_mutex_unlock(&config.progress_bars[index].lock);
+
+    update_progress_bar(index, done);
+}
+
 void print_progress_bar(const ProgressBar *bar) {
     if (!bar || !bar->active) return;
     
@@ -155,6 +198,11 @@ void print_progress_bar(const ProgressBar *bar) {
         printf(" (%.2f/s)", bar->speed);
     }
     
+    if (bar->eta >= 0 && !bar->finished) {
+        int eta = (int)bar->eta;
+        printf(" 剩余 %02d:%02d:%02d", eta / 3600, eta / 60 % 60, eta % 60);
+    }
+
     if (bar->finished) {
         printf(" ✅");
     }
@@ -0,0 +1,170 @@
+#include "sha256_mb.h"
+#include "logging.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// 通道状态：完整块直接引用原数据，尾部 (含填充与长度) 放在 tail 中
+typedef struct {
+    const Sha256MbJob *job;
+    size_t blocks;                 // 含填充的总块数
+    size_t full_blocks;            // 无需填充的完整块数
+    unsigned char tail[128];
+} MbLane;
+
+static inline uint32_t load_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void mb_lane_init(MbLane *lane, const Sha256MbJob *job) {
+    size_t rem = job->len % 64;
+    uint64_t bits = (uint64_t)job->len * 8;
+
+    lane->job = job;
+    lane->full_blocks = job->len / 64;
+    lane->blocks = lane->full_blocks + (rem + 9 > 64 ? 2 : 1);
+
+    memset(lane->tail, 0, sizeof(lane->tail));
+    memcpy(lane->tail, job->data + lane->full_blocks * 64, rem);
+    lane->tail[rem] = 0x80;
+    unsigned char *len_pos = lane->tail + (lane->blocks - lane->full_blocks) * 64 - 8;
+    for (int i = 0; i < 8; i++) {
+        len_pos[i] = (unsigned char)(bits >> (56 - i * 8));
+    }
+}
+
+static inline const unsigned char* mb_lane_block(const MbLane *lane, size_t b) {
+    if (b < lane->full_blocks) return lane->job->data + b * 64;
+    return lane->tail + (b - lane->full_blocks) * 64;
+}
+
+#define MB_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_MB_X86 1
+#include <cpuid.h>
+
+#define MB_LANES 8
+#define MB_FUNC sha256_mb_avx2
+#define MB_TARGET __attribute__((target("avx2")))
+#include "sha256_mb_kernel.h"
+#undef MB_LANES
+#undef MB_FUNC
+#undef MB_TARGET
+
+#define MB_LANES 16
+#define MB_FUNC sha256_mb_avx512
+#define MB_TARGET __attribute__((target("avx512f")))
+#include "sha256_mb_kernel.h"
+#undef MB_LANES
+#undef MB_FUNC
+#undef MB_TARGET
+#endif
+
+typedef enum {
+    MB_KERNEL_SCALAR = 0,
+    MB_KERNEL_AVX2,
+    MB_KERNEL_AVX512
+} MbKernel;
+
+static const char *kernel_names[] = { "scalar", "avx2", "avx512" };
+static MbKernel active_kernel = MB_KERNEL_SCALAR;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+#ifdef SHA256_MB_X86
+// CPU 是否有 SHA 扩展 (OpenSSL 会使用 SHA-NI 指令)
+static int cpu_has_sha_ni(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return 0;
+    return (ebx >> 29) & 1;
+}
+#endif
+
+// 运行时选择内核；MIRRORGUARD_SHA256_KERNEL=scalar|avx2|avx512 可强制指定
+// 有 SHA-NI 时单消息的 OpenSSL 快于 AVX2 8 路，只有 AVX-512 16 路仍占优
+static void select_kernel(void) {
+    MbKernel best = MB_KERNEL_SCALAR;
+    MbKernel supported = MB_KERNEL_SCALAR;
+#ifdef SHA256_MB_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) supported = MB_KERNEL_AVX512;
+    else if (__builtin_cpu_supports("avx2")) supported = MB_KERNEL_AVX2;
+    best = supported;
+    if (best == MB_KERNEL_AVX2 && cpu_has_sha_ni()) best = MB_KERNEL_SCALAR;
+#endif
+    active_kernel = best;
+
+    const char *env = getenv("MIRRORGUARD_SHA256_KERNEL");
+    if (env && *env) {
+        for (int i = 0; i <= (int)supported; i++) {
+            if (strcmp(env, kernel_names[i]) == 0) {
+                active_kernel = (MbKernel)i;
+                return;
+            }
+        }
+        log_msg(LOG_WARN, "忽略不支持的 MIRRORGUARD_SHA256_KERNEL=%s，使用 %s", env, kernel_names[best]);
+    }
+}
+
+const char* sha256_mb_kernel_name(void) {
+    pthread_once(&kernel_once, select_kernel);
+    return kernel_names[active_kernel];
+}
+
+static int compare_job_len(const void *a, const void *b) {
+    size_t la = ((const Sha256MbJob *)a)->len;
+    size_t lb = ((const Sha256MbJob *)b)->len;
+    return la < lb ? -1 : la > lb;
+}
+
+void sha256_mb_hash(Sha256MbJob *jobs, size_t count) {
+    if (!jobs || count == 0) return;
+    pthread_once(&kernel_once, select_kernel);
+
+    if (active_kernel == MB_KERNEL_SCALAR) {
+        const EVP_MD *md = EVP_sha256();
+        for (size_t i = 0; i < count; i++) {
+            EVP_Digest(jobs[i].data, jobs[i].len, jobs[i].out, NULL, md, NULL);
+        }
+        return;
+    }
+
+#ifdef SHA256_MB_X86
+    // 长度相近的消息放在同一组，减少被屏蔽的空转通道
+    qsort(jobs, count, sizeof(Sha256MbJob), compare_job_len);
+
+    size_t lanes_per_call = active_kernel == MB_KERNEL_AVX512 ? 16 : 8;
+    MbLane lanes[16];
+    for (size_t i = 0; i < count; i += lanes_per_call) {
+        size_t n = count - i < lanes_per_call ? count - i : lanes_per_call;
+        for (size_t l = 0; l < n; l++) mb_lane_init(&lanes[l], &jobs[i + l]);
+
+        if (active_kernel == MB_KERNEL_AVX512) sha256_mb_avx512(lanes, n);
+        else sha256_mb_avx2(lanes, n);
+    }
+#endif
+}
@@ -0,0 +1,89 @@
+// 多缓冲 SHA-256 内核模板
+// 由 sha256_mb.c 定义 MB_LANES / MB_FUNC / MB_TARGET 后包含，每次生成一个内核
+
+#define MB_CAT_(a, b) a##b
+#define MB_CAT(a, b) MB_CAT_(a, b)
+#define MB_VEC MB_CAT(MB_FUNC, _vec)
+
+typedef uint32_t MB_VEC __attribute__((vector_size(MB_LANES * 4)));
+
+// 一次处理 n (<= MB_LANES) 个消息，每个通道一个消息；
+// 块数较少的通道在结束后屏蔽，不再更新状态
+MB_TARGET static void MB_FUNC(MbLane *lanes, size_t n) {
+    MB_VEC state[8];
+    uint32_t words[16][MB_LANES] __attribute__((aligned(64)));
+    uint32_t active[MB_LANES] __attribute__((aligned(64)));
+    size_t max_blocks = 0;
+
+    for (int i = 0; i < 8; i++) {
+        for (int l = 0; l < MB_LANES; l++) {
+            state[i][l] = sha256_h0[i];
+        }
+    }
+    for (size_t l = 0; l < n; l++) {
+        if (lanes[l].blocks > max_blocks) max_blocks = lanes[l].blocks;
+    }
+
+    for (size_t b = 0; b < max_blocks; b++) {
+        // 转置：words[t][l] 为通道 l 当前块的第 t 个大端字
+        for (size_t l = 0; l < MB_LANES; l++) {
+            if (l < n && b < lanes[l].blocks) {
+                const unsigned char *p = mb_lane_block(&lanes[l], b);
+                for (int t = 0; t < 16; t++) words[t][l] = load_be32(p + t * 4);
+                active[l] = 0xffffffffu;
+            } else {
+                for (int t = 0; t < 16; t++) words[t][l] = 0;
+                active[l] = 0;
+            }
+        }
+
+        MB_VEC w[16];
+        MB_VEC mask;
+        for (int t = 0; t < 16; t++) memcpy(&w[t], words[t], sizeof(MB_VEC));
+        memcpy(&mask, active, sizeof(MB_VEC));
+
+        MB_VEC a = state[0], bb = state[1], c = state[2], d = state[3];
+        MB_VEC e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 64; t++) {
+            if (t >= 16) {
+                MB_VEC w15 = w[(t - 15) & 15];
+                MB_VEC w2 = w[(t - 2) & 15];
+                MB_VEC s0 = MB_ROTR(w15, 7) ^ MB_ROTR(w15, 18) ^ (w15 >> 3);
+                MB_VEC s1 = MB_ROTR(w2, 17) ^ MB_ROTR(w2, 19) ^ (w2 >> 10);
+                w[t & 15] = w[t & 15] + s0 + w[(t - 7) & 15] + s1;
+            }
+
+            MB_VEC t1 = h + (MB_ROTR(e, 6) ^ MB_ROTR(e, 11) ^ MB_ROTR(e, 25)) +
+                        ((e & f) ^ (~e & g)) + sha256_k[t] + w[t & 15];
+            MB_VEC t2 = (MB_ROTR(a, 2) ^ MB_ROTR(a, 13) ^ MB_ROTR(a, 22)) +
+                        ((a & bb) ^ (a & c) ^ (bb & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = bb;
+            bb = a;
+            a = t1 + t2;
+        }
+
+        // 已结束的通道 mask 为 0，状态保持不变
+        state[0] += a & mask;
+        state[1] += bb & mask;
+        state[2] += c & mask;
+        state[3] += d & mask;
+        state[4] += e & mask;
+        state[5] += f & mask;
+        state[6] += g & mask;
+        state[7] += h & mask;
+    }
+
+    for (size_t l = 0; l < n; l++) {
+        for (int i = 0; i < 8; i++) store_be32(lanes[l].job->out + i * 4, state[i][l]);
+    }
+}
+
+#undef MB_VEC
+#undef MB_CAT
+#undef MB_CAT_
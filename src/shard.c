@@ -0,0 +1,562 @@
+#include "shard.h"
+#include "config.h"
+#include "logging.h"
+#include "manifest.h"
+#include "mgidx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+extern Config config;
+extern Statistics stats;
+
+// 解析 "i/N"：1 <= i <= N <= SHARD_MAX
+int shard_parse(const char *spec, int *index, int *count) {
+    if (!spec || !index || !count) return -1;
+
+    char *end;
+    long i = strtol(spec, &end, 10);
+    if (end == spec || *end != '/') return -1;
+    const char *rest = end + 1;
+    long n = strtol(rest, &end, 10);
+    if (end == rest || *end != '\0' || n < 1 || n > SHARD_MAX || i < 1 || i > n) return -1;
+
+    *index = (int)i;
+    *count = (int)n;
+    return 0;
+}
+
+// 路径所属的分片 (0 起)：FNV-1a 64 位，高低位折叠后取余
+static int shard_of(const char *path, size_t len, int count) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 32;
+    return (int)(h % (uint64_t)count);
+}
+
+// 当前分片是否包含该相对路径；按首级目录分片时目录与文件都只看首级名字
+int shard_selected(const char *path) {
+    if (config.shard_count <= 1 || !path) return 1;
+    size_t len = config.shard_by_dir ? strcspn(path, "/") : strlen(path);
+    return shard_of(path, len, config.shard_count) == config.shard_index - 1;
+}
+
+// 清单/报告头中的分片字段 " shard=i/N [shard-by=dir]"，不分片时为空串
+void shard_format(char *buf, size_t size, int index, int count, int by_dir) {
+    if (count <= 1) {
+        buf[0] = '\0';
+        return;
+    }
+    snprintf(buf, size, " shard=%d/%d%s", index, count, by_dir ? " shard-by=dir" : "");
+}
+
+void shard_parse_header(const char *line, int *index, int *count, int *by_dir) {
+    *index = *count = *by_dir = 0;
+    const char *p = strstr(line, " shard=");
+    if (!p) return;
+
+    char spec[32];
+    if (sscanf(p + 7, "%31[^ \t\r\n]", spec) != 1 || shard_parse(spec, index, count) != 0) {
+        *index = *count = 0;
+        return;
+    }
+    *by_dir = strstr(line, " shard-by=dir") != NULL;
+}
+
+// ---- 验证结果报告 ----
+
+typedef struct {
+    FileStatus status;
+    char *path;
+} ReportEntry;
+
+static ReportEntry *report_entries = NULL;
+static size_t report_count = 0;
+static size_t report_capacity = 0;
+
+static char status_code(FileStatus status) {
+    switch (status) {
+        case FILE_STATUS_MISSING: return 'M';
+        case FILE_STATUS_CORRUPT: return 'C';
+        case FILE_STATUS_EXTRA: return 'X';
+        default: return 'E';
+    }
+}
+
+// 记录一个失败条目 (主线程调用)；未指定 --report 时不记录
+void report_add(FileStatus status, const char *path) {
+    if (!config.report_path || !path || status == FILE_STATUS_VALID) return;
+
+    if (report_count == report_capacity) {
+        size_t new_capacity = report_capacity ? report_capacity * 2 : 256;
+        ReportEntry *grown = realloc(report_entries, new_capacity * sizeof(ReportEntry));
+        if (!grown) {
+            log_msg(LOG_ERROR, "内存分配失败: 验证报告");
+            return;
+        }
+        report_entries = grown;
+        report_capacity = new_capacity;
+    }
+    char *copy = strdup(path);
+    if (!copy) {
+        log_msg(LOG_ERROR, "内存分配失败: 验证报告");
+        return;
+    }
+    report_entries[report_count].status = status;
+    report_entries[report_count].path = copy;
+    report_count++;
+}
+
+static int compare_report_entry(const void *a, const void *b) {
+    const ReportEntry *ra = (const ReportEntry *)a;
+    const ReportEntry *rb = (const ReportEntry *)b;
+    int cmp = strcmp(ra->path, rb->path);
+    if (cmp != 0) return cmp;
+    return status_code(ra->status) - status_code(rb->status);
+}
+
+static void report_free(void) {
+    for (size_t i = 0; i < report_count; i++) free(report_entries[i].path);
+    free(report_entries);
+    report_entries = NULL;
+    report_count = report_capacity = 0;
+}
+
+// 写出报告：失败条目按路径排序，计数取自本次验证的统计；写入临时文件后原子替换；
+// path 为 NULL 时只丢弃已记录的条目 (验证中断或模拟运行)
+int report_write(const char *path, size_t total) {
+    if (!path) {
+        report_free();
+        return MIRRORGUARD_OK;
+    }
+
+    char temp_path[MAX_PATH];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp.%d", path, getpid());
+    FILE *fp = fopen(temp_path, "w");
+    if (!fp) {
+        log_msg(LOG_ERROR, "无法创建验证报告 '%s': %s", temp_path, strerror(errno));
+        report_free();
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+
+    char shard[SHARD_HEADER_MAX];
+    shard_format(shard, sizeof(shard), config.shard_index, config.shard_count, config.shard_by_dir);
+    fprintf(fp, "%s total=%zu processed=%zu missing=%zu corrupt=%zu errors=%zu extra=%zu%s\n",
+            REPORT_HEADER_PREFIX, total, stats.processed_files, stats.missing_files, stats.corrupt_files,
+            stats.error_files, stats.extra_files, shard);
+
+    qsort(report_entries, report_count, sizeof(ReportEntry), compare_report_entry);
+    for (size_t i = 0; i < report_count; i++) {
+        fprintf(fp, "%c *%s\n", status_code(report_entries[i].status), report_entries[i].path);
+    }
+    report_free();
+
+    int failed = ferror(fp) != 0;
+    failed |= fclose(fp) != 0;
+    if (failed || rename(temp_path, path) != 0) {
+        log_msg(LOG_ERROR, "无法写入验证报告 '%s': %s", path, strerror(errno));
+        unlink(temp_path);
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+    log_msg(LOG_INFO, "验证报告: %s", path);
+    return MIRRORGUARD_OK;
+}
+
+// ---- 合并 ----
+
+// 检查各输入声明的分片：要么都未分片，要么 N 与分片方式一致、序号不重复且 1..N 齐全
+static int check_coverage(const int *index, const int *count, const int *by_dir, char *const *inputs, int n) {
+    int sharded = 0;
+    for (int i = 0; i < n; i++) sharded += count[i] > 0;
+    if (sharded == 0) return MIRRORGUARD_OK;
+    if (sharded != n) {
+        log_msg(LOG_ERROR, "输入中既有分片也有完整的清单/报告，无法合并");
+        return MIRRORGUARD_ERROR_CONFLICT;
+    }
+
+    int total = count[0];
+    unsigned char *seen = calloc((size_t)total + 1, 1);
+    if (!seen) return MIRRORGUARD_ERROR_MEMORY;
+
+    int result = MIRRORGUARD_OK;
+    for (int i = 0; i < n && result == MIRRORGUARD_OK; i++) {
+        if (count[i] != total || by_dir[i] != by_dir[0]) {
+            log_msg(LOG_ERROR, "分片方式不一致: %s (%d/%d) 与 %s (%d/%d)", inputs[i], index[i], count[i],
+                    inputs[0], index[0], total);
+            result = MIRRORGUARD_ERROR_CONFLICT;
+        } else if (seen[index[i]]) {
+            log_msg(LOG_ERROR, "分片 %d/%d 重复: %s", index[i], total, inputs[i]);
+            result = MIRRORGUARD_ERROR_CONFLICT;
+        } else {
+            seen[index[i]] = 1;
+        }
+    }
+    for (int i = 1; i <= total && result == MIRRORGUARD_OK; i++) {
+        if (!seen[i]) {
+            log_msg(LOG_ERROR, "缺少分片 %d/%d，合并结果将不完整", i, total);
+            result = MIRRORGUARD_ERROR_INVALID_ARGS;
+        }
+    }
+    free(seen);
+    return result;
+}
+
+// 归并来源：一个分片清单与其当前条目 (路径复制出来以 '\0' 结尾，两个缓冲交替使用以检查顺序)
+typedef struct {
+    ManifestReader reader;
+    const char *name;
+    FileInfo head;
+    char paths[2][MAX_PATH];
+    int current;
+    int has_head;
+} MergeSource;
+
+// 读入来源的下一个条目；来源未按路径排序时返回 -1
+static int merge_fill(MergeSource *source) {
+    ManifestEntry entry;
+    while (manifest_next(&source->reader, &entry)) {
+        if (entry.path_len >= MAX_PATH) {
+            log_msg(LOG_ERROR, "路径过长: %.*s", (int)entry.path_len, entry.path);
+            continue;
+        }
+        int next = source->has_head ? !source->current : source->current;
+        memcpy(source->paths[next], entry.path, entry.path_len);
+        source->paths[next][entry.path_len] = '\0';
+
+        FileInfo info;
+        info.path = source->paths[next];
+        info.digest = entry.digest;
+        info.size = entry.size < 0 ? 0 : (size_t)entry.size;
+        info.mtime = entry.mtime < 0 ? 0 : (time_t)entry.mtime;
+        if (source->has_head && compare_file_info_by_path(&source->head, &info) > 0) {
+            log_msg(LOG_ERROR, "分片清单未按路径排序: %s (可先用 -o mgidx --convert 排序)", source->name);
+            return -1;
+        }
+        source->head = info;
+        source->current = next;
+        source->has_head = 1;
+        return 1;
+    }
+    source->has_head = 0;
+    return 0;
+}
+
+static int merge_less(MergeSource *sources, const int *heap, int a, int b) {
+    return compare_file_info_by_path(&sources[heap[a]].head, &sources[heap[b]].head) < 0;
+}
+
+static void merge_sift_down(MergeSource *sources, int *heap, int size, int i) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < size && merge_less(sources, heap, left, smallest)) smallest = left;
+        if (right < size && merge_less(sources, heap, right, smallest)) smallest = right;
+        if (smallest == i) return;
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// 多路归并各分片清单 (均按路径有序)，逐条写出，内存占用与分片数成正比；
+// 同一路径出现在不同分片中说明分片重叠，拒绝合并
+static int merge_manifests(const char *output_path, char *const *inputs, int n) {
+    MergeSource *sources = calloc((size_t)n, sizeof(MergeSource));
+    int *heap = malloc((size_t)n * sizeof(int));
+    int *shard_info = malloc((size_t)n * 3 * sizeof(int));
+    if (!sources || !heap || !shard_info) {
+        free(sources);
+        free(heap);
+        free(shard_info);
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
+
+    int result = MIRRORGUARD_OK;
+    int opened = 0;
+    int fields = MANIFEST_FIELD_SIZE | MANIFEST_FIELD_MTIME;
+    size_t declared = 0;
+    for (; opened < n && result == MIRRORGUARD_OK; opened++) {
+        sources[opened].name = inputs[opened];
+        result = manifest_open(&sources[opened].reader, inputs[opened]);
+        if (result != MIRRORGUARD_OK) break;
+        ManifestReader *reader = &sources[opened].reader;
+        if (reader->algo != sources[0].reader.algo) {
+            log_msg(LOG_ERROR, "分片清单的摘要算法不一致: %s", inputs[opened]);
+            result = MIRRORGUARD_ERROR_CONFLICT;
+        }
+        fields &= reader->fields;
+        declared = declared != (size_t)-1 && reader->count > 0 ? declared + reader->count : (size_t)-1;
+        shard_info[opened] = reader->shard_index;
+        shard_info[n + opened] = reader->shard_count;
+        shard_info[2 * n + opened] = reader->shard_by_dir;
+    }
+    if (result == MIRRORGUARD_OK) {
+        result = check_coverage(shard_info, shard_info + n, shard_info + 2 * n, inputs, n);
+    }
+
+    char temp_manifest[MAX_PATH];
+    snprintf(temp_manifest, sizeof(temp_manifest), "%s.tmp.%d", output_path, getpid());
+    DigestAlgo algo = opened > 0 ? sources[0].reader.algo : DIGEST_ALGO_SHA256;
+    if (manifest_output_fields() == 0) fields = 0;
+
+    // 二进制清单由 mgidx_write 排序写出，先收集到文件列表
+    FileList *list = NULL;
+    ManifestWriter writer;
+    int writer_open = 0;
+    if (result == MIRRORGUARD_OK && manifest_output_binary()) {
+        list = create_file_list();
+        if (!list) result = MIRRORGUARD_ERROR_MEMORY;
+        else file_list_set_memory_limit(list, config.memory_limit);
+    } else if (result == MIRRORGUARD_OK && !config.dry_run) {
+        result = manifest_writer_open(&writer, temp_manifest, algo, fields, config.compress);
+        writer_open = result == MIRRORGUARD_OK;
+        if (writer_open) {
+            writer.shard[0] = '\0';  // 合并结果是完整清单
+            manifest_writer_header(&writer, declared == (size_t)-1 ? 0 : declared);
+        }
+    }
+
+    int heap_size = 0;
+    for (int i = 0; i < n && result == MIRRORGUARD_OK; i++) {
+        int filled = merge_fill(&sources[i]);
+        if (filled < 0) result = MIRRORGUARD_ERROR_INVALID_FORMAT;
+        else if (filled) heap[heap_size++] = i;
+    }
+    for (int i = heap_size / 2; i-- > 0; ) merge_sift_down(sources, heap, heap_size, i);
+
+    size_t total = 0;
+    char last_path[MAX_PATH];
+    int last_source = -1;
+    while (heap_size > 0 && result == MIRRORGUARD_OK) {
+        int s = heap[0];
+        const FileInfo *info = &sources[s].head;
+        if (last_source >= 0 && last_source != s && strcmp(last_path, info->path) == 0) {
+            log_msg(LOG_ERROR, "分片重叠: %s 同时出现在 %s 与 %s 中", info->path, inputs[last_source], inputs[s]);
+            result = MIRRORGUARD_ERROR_CONFLICT;
+            break;
+        }
+        snprintf(last_path, sizeof(last_path), "%s", info->path);
+        last_source = s;
+
+        if (list) {
+            if (add_file_to_list(list, info->path, &info->digest, info->size, info->mtime) != 0) {
+                result = MIRRORGUARD_ERROR_MEMORY;
+            }
+        } else if (writer_open && manifest_writer_entry(&writer, info) != 0) {
+            result = MIRRORGUARD_ERROR_FILE_IO;
+        }
+        total++;
+
+        int filled = merge_fill(&sources[s]);
+        if (filled < 0) {
+            result = MIRRORGUARD_ERROR_INVALID_FORMAT;
+        } else {
+            if (!filled) heap[0] = heap[--heap_size];
+            merge_sift_down(sources, heap, heap_size, 0);
+        }
+    }
+
+    for (int i = 0; i < opened; i++) {
+        if (result == MIRRORGUARD_OK && sources[i].reader.failed) {
+            log_msg(LOG_ERROR, "分片清单读取不完整: %s", inputs[i]);
+            result = MIRRORGUARD_ERROR_INVALID_FORMAT;
+        }
+    }
+
+    if (writer_open && manifest_writer_close(&writer) != 0 && result == MIRRORGUARD_OK) {
+        log_msg(LOG_ERROR, "写入清单失败: %s", strerror(errno));
+        result = MIRRORGUARD_ERROR_FILE_IO;
+    }
+    if (list) {
+        // 二进制清单记录所有分片的源目录 (去重)
+        const char *roots[MAX_SOURCE_DIRS];
+        int root_count = 0;
+        for (int i = 0; i < opened; i++) {
+            const char *root;
+            for (uint32_t r = 0; sources[i].reader.cursor && (root = mgidx_root(&sources[i].reader.index, r)); r++) {
+                int dup = 0;
+                for (int k = 0; k < root_count && !dup; k++) dup = strcmp(roots[k], root) == 0;
+                if (!dup && root_count < MAX_SOURCE_DIRS) roots[root_count++] = root;
+            }
+        }
+        if (result == MIRRORGUARD_OK && !config.dry_run) {
+            result = mgidx_write(temp_manifest, list, algo, fields, roots, root_count);
+        }
+        free_file_list(list);
+    }
+    for (int i = 0; i < opened; i++) manifest_close(&sources[i].reader);
+    free(sources);
+    free(heap);
+    free(shard_info);
+
+    if (!config.dry_run && result == MIRRORGUARD_OK && rename(temp_manifest, output_path) != 0) {
+        log_msg(LOG_ERROR, "无法完成清单: %s", strerror(errno));
+        result = MIRRORGUARD_ERROR_FILE_IO;
+    }
+    if (result != MIRRORGUARD_OK) {
+        if (!config.dry_run) unlink(temp_manifest);
+        return result;
+    }
+
+    log_msg(LOG_INFO, "分片清单合并完成: %s (%d 个分片，%zu 个条目)", output_path, n, total);
+    return MIRRORGUARD_OK;
+}
+
+// 报告来源：当前失败条目行 (不含换行)
+typedef struct {
+    FILE *fp;
+    char *line;
+    size_t cap;
+    ssize_t len;
+} ReportSource;
+
+static int report_fill(ReportSource *source) {
+    source->len = getline(&source->line, &source->cap, source->fp);
+    while (source->len > 0 && (source->line[source->len - 1] == '\n' || source->line[source->len - 1] == '\r')) {
+        source->line[--source->len] = '\0';
+    }
+    return source->len > 0;
+}
+
+// 报告行按路径 (跳过 "<状态> *") 比较
+static int report_line_less(const ReportSource *a, const ReportSource *b) {
+    const char *pa = a->len > 3 ? a->line + 3 : a->line;
+    const char *pb = b->len > 3 ? b->line + 3 : b->line;
+    int cmp = strcmp(pa, pb);
+    return cmp != 0 ? cmp < 0 : a->line[0] < b->line[0];
+}
+
+// 合并各分片的验证报告：计数相加，失败条目按路径归并，写出一份报告并输出汇总
+static int merge_reports(const char *output_path, char *const *inputs, int n) {
+    ReportSource *sources = calloc((size_t)n, sizeof(ReportSource));
+    int *shard_info = malloc((size_t)n * 3 * sizeof(int));
+    if (!sources || !shard_info) {
+        free(sources);
+        free(shard_info);
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
+
+    // total processed missing corrupt errors extra
+    unsigned long long sums[6] = { 0 };
+    static const char *const keys[6] = { "total=", "processed=", "missing=", "corrupt=", "errors=", "extra=" };
+    int result = MIRRORGUARD_OK;
+    for (int i = 0; i < n && result == MIRRORGUARD_OK; i++) {
+        sources[i].fp = fopen(inputs[i], "r");
+        if (!sources[i].fp) {
+            log_msg(LOG_ERROR, "无法打开验证报告 '%s': %s", inputs[i], strerror(errno));
+            result = MIRRORGUARD_ERROR_FILE_IO;
+            break;
+        }
+        if (!report_fill(&sources[i]) || strncmp(sources[i].line, REPORT_HEADER_PREFIX,
+                                                 strlen(REPORT_HEADER_PREFIX)) != 0) {
+            log_msg(LOG_ERROR, "不是验证报告: %s", inputs[i]);
+            result = MIRRORGUARD_ERROR_INVALID_FORMAT;
+            break;
+        }
+        for (int k = 0; k < 6; k++) {
+            const char *p = strstr(sources[i].line, keys[k]);
+            if (p) sums[k] += strtoull(p + strlen(keys[k]), NULL, 10);
+        }
+        shard_parse_header(sources[i].line, &shard_info[i], &shard_info[n + i], &shard_info[2 * n + i]);
+        report_fill(&sources[i]);
+    }
+    if (result == MIRRORGUARD_OK) {
+        result = check_coverage(shard_info, shard_info + n, shard_info + 2 * n, inputs, n);
+    }
+
+    char temp_path[MAX_PATH];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp.%d", output_path, getpid());
+    FILE *out = NULL;
+    if (result == MIRRORGUARD_OK && !config.dry_run) {
+        out = fopen(temp_path, "w");
+        if (!out) {
+            log_msg(LOG_ERROR, "无法创建验证报告 '%s': %s", temp_path, strerror(errno));
+            result = MIRRORGUARD_ERROR_FILE_IO;
+        } else {
+            fprintf(out, "%s total=%llu processed=%llu missing=%llu corrupt=%llu errors=%llu extra=%llu\n",
+                    REPORT_HEADER_PREFIX, sums[0], sums[1], sums[2], sums[3], sums[4], sums[5]);
+        }
+    }
+
+    // 分片数通常只有几十个，每次线性选出最小的一行即可；失败条目同时输出到日志
+    while (result == MIRRORGUARD_OK) {
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            if (sources[i].len > 0 && (best < 0 || report_line_less(&sources[i], &sources[best]))) best = i;
+        }
+        if (best < 0) break;
+
+        const char *line = sources[best].line;
+        const char *path = sources[best].len > 3 ? line + 3 : "";
+        switch (line[0]) {
+            case 'M': log_msg(LOG_ERROR, "❌ 缺失文件: %s", path); break;
+            case 'C': log_msg(LOG_ERROR, "❌ 哈希不匹配: %s", path); break;
+            case 'X': log_msg(LOG_WARN, "⚠  额外文件: %s", path); break;
+            default: log_msg(LOG_ERROR, "❌ 验证错误: %s", path); break;
+        }
+        if (out) fprintf(out, "%s\n", line);
+        report_fill(&sources[best]);
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (sources[i].fp) fclose(sources[i].fp);
+        free(sources[i].line);
+    }
+    free(sources);
+    free(shard_info);
+
+    if (out) {
+        int failed = ferror(out) != 0;
+        failed |= fclose(out) != 0;
+        if (result == MIRRORGUARD_OK && (failed || rename(temp_path, output_path) != 0)) {
+            log_msg(LOG_ERROR, "无法写入验证报告 '%s': %s", output_path, strerror(errno));
+            result = MIRRORGUARD_ERROR_FILE_IO;
+        }
+        if (result != MIRRORGUARD_OK) unlink(temp_path);
+    }
+    if (result != MIRRORGUARD_OK) return result;
+
+    log_msg(LOG_INFO, "\n合并验证结果 (%d 个分片):", n);
+    log_msg(LOG_INFO, "  总文件数: %llu", sums[0]);
+    log_msg(LOG_INFO, "  已处理: %llu", sums[1]);
+    log_msg(LOG_INFO, "  缺失文件: %llu", sums[2]);
+    log_msg(LOG_INFO, "  损坏文件: %llu", sums[3]);
+    log_msg(LOG_INFO, "  验证错误: %llu", sums[4]);
+    log_msg(LOG_INFO, "  额外文件: %llu", sums[5]);
+
+    if (sums[2] > 0 || sums[3] > 0 || sums[4] > 0) {
+        log_msg(LOG_ERROR, "❌ 镜像验证失败!");
+        return MIRRORGUARD_ERROR_VERIFY_FAILED;
+    }
+    log_msg(LOG_INFO, "✅ 镜像验证成功 - 100%% 完整!");
+    return MIRRORGUARD_OK;
+}
+
+// 按首个输入的内容选择合并方式：验证报告或清单
+int merge_shards(const char *output_path, char *const *inputs, int input_count) {
+    if (!output_path || !inputs || input_count < 1) {
+        log_msg(LOG_ERROR, "合并参数错误");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    char head[sizeof(REPORT_HEADER_PREFIX)];
+    size_t len = 0;
+    FILE *fp = fopen(inputs[0], "r");
+    if (fp) {
+        len = fread(head, 1, sizeof(head) - 1, fp);
+        fclose(fp);
+    }
+    head[len] = '\0';
+    if (strcmp(head, REPORT_HEADER_PREFIX) == 0) {
+        return merge_reports(output_path, inputs, input_count);
+    }
+    return merge_manifests(output_path, inputs, input_count);
+}
@@ -0,0 +1,320 @@
+#include "thread_pool.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+ThreadPool *g_hash_pool = NULL;
+
+// 尝试入队；队列已满时返回 0
+static int pool_enqueue(ThreadPool *pool, ThreadPoolTask fn, void *arg) {
+    size_t pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+    ThreadPoolSlot *slot;
+
+    for (;;) {
+        slot = &pool->slots[pos & pool->mask];
+        size_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->fn = fn;
+    slot->arg = arg;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// 尝试出队；队列为空时返回 0
+static int pool_dequeue(ThreadPool *pool, ThreadPoolJob *job) {
+    size_t pos = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+    ThreadPoolSlot *slot;
+
+    for (;;) {
+        slot = &pool->slots[pos & pool->mask];
+        size_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        long diff = (long)(seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->dequeue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    job->fn = slot->fn;
+    job->arg = slot->arg;
+    __atomic_store_n(&slot->sequence, pos + pool->mask + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// 休眠方先登记再复查队列，唤醒方先改队列再检查登记数；
+// 两侧之间的全屏障保证至少一方看到对方的写入，不会丢失唤醒
+static void pool_wake(ThreadPool *pool, int *sleepers, pthread_cond_t *cond) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(sleepers, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// 工作线程主循环：从队列取任务执行，直到池关闭且队列为空
+static void* thread_pool_worker(void *arg) {
+    ThreadPool *pool = (ThreadPool *)arg;
+    ThreadPoolJob job;
+
+    for (;;) {
+        if (!pool_dequeue(pool, &job)) {
+            pthread_mutex_lock(&pool->lock);
+            __atomic_add_fetch(&pool->idle_workers, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            int got = 0;
+            while (!(got = pool_dequeue(pool, &job)) && !pool->shutdown) {
+                pthread_cond_wait(&pool->not_empty, &pool->lock);
+            }
+            __atomic_sub_fetch(&pool->idle_workers, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&pool->lock);
+            if (!got) break;
+        }
+
+        pool_wake(pool, &pool->blocked_submitters, &pool->not_full);
+
+        job.fn(job.arg);
+
+        if (__atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_ACQ_REL) == 0) {
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_broadcast(&pool->idle);
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    return NULL;
+}
+
+ThreadPool* thread_pool_create(int threads, size_t queue_capacity) {
+    if (threads < 1) threads = 1;
+
+    size_t capacity = 2;
+    while (capacity < queue_capacity) capacity <<= 1;
+
+    // 入队/出队位置分处不同缓存行，结构体本身也需按缓存行对齐
+    ThreadPool *pool = NULL;
+    if (posix_memalign((void **)&pool, 64, sizeof(ThreadPool)) != 0) return NULL;
+    memset(pool, 0, sizeof(ThreadPool));
+
+    pool->slots = malloc(capacity * sizeof(ThreadPoolSlot));
+    pool->threads = malloc(threads * sizeof(pthread_t));
+    if (!pool->slots || !pool->threads) {
+        free(pool->slots);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        pool->slots[i].sequence = i;
+    }
+    pool->mask = capacity - 1;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, thread_pool_worker, pool) != 0) {
+            log_msg(LOG_WARN, "无法创建工作线程 %d，使用 %d 个线程", i + 1, i);
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        thread_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+// 提交任务；队列已满时阻塞等待
+int thread_pool_submit(ThreadPool *pool, ThreadPoolTask fn, void *arg) {
+    if (!pool || !fn) return -1;
+
+    __atomic_add_fetch(&pool->outstanding, 1, __ATOMIC_RELAXED);
+    if (!pool_enqueue(pool, fn, arg)) {
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->blocked_submitters, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int queued = 0;
+        while (!pool->shutdown && !(queued = pool_enqueue(pool, fn, arg))) {
+            pthread_cond_wait(&pool->not_full, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->blocked_submitters, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&pool->lock);
+        if (!queued) {
+            __atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+
+    pool_wake(pool, &pool->idle_workers, &pool->not_empty);
+    return 0;
+}
+
+// 提交任务；队列已满时立即返回 -1
+int thread_pool_try_submit(ThreadPool *pool, ThreadPoolTask fn, void *arg) {
+    if (!pool || !fn || __atomic_load_n(&pool->shutdown, __ATOMIC_RELAXED)) return -1;
+
+    __atomic_add_fetch(&pool->outstanding, 1, __ATOMIC_RELAXED);
+    if (!pool_enqueue(pool, fn, arg)) {
+        __atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    pool_wake(pool, &pool->idle_workers, &pool->not_empty);
+    return 0;
+}
+
+// 并行循环上下文：调用方与协助线程共享，引用计数归零时释放
+typedef struct {
+    ThreadPoolRangeTask fn;
+    void *arg;
+    size_t count;
+    size_t next;                   // 下一个待领取的迭代
+    size_t completed;              // 已完成的迭代数
+    int refs;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} ParallelFor;
+
+static void parallel_for_release(ParallelFor *pf) {
+    pthread_mutex_lock(&pf->lock);
+    int refs = --pf->refs;
+    pthread_mutex_unlock(&pf->lock);
+
+    if (refs == 0) {
+        pthread_mutex_destroy(&pf->lock);
+        pthread_cond_destroy(&pf->done);
+        free(pf);
+    }
+}
+
+// 领取并执行迭代，直到全部被领取
+static void parallel_for_drain(ParallelFor *pf) {
+    for (;;) {
+        pthread_mutex_lock(&pf->lock);
+        if (pf->next >= pf->count) {
+            pthread_mutex_unlock(&pf->lock);
+            return;
+        }
+        size_t index = pf->next++;
+        pthread_mutex_unlock(&pf->lock);
+
+        pf->fn(pf->arg, index);
+
+        pthread_mutex_lock(&pf->lock);
+        if (++pf->completed == pf->count) {
+            pthread_cond_broadcast(&pf->done);
+        }
+        pthread_mutex_unlock(&pf->lock);
+    }
+}
+
+static void parallel_for_helper(void *arg) {
+    ParallelFor *pf = (ParallelFor *)arg;
+    parallel_for_drain(pf);
+    parallel_for_release(pf);
+}
+
+// 并行执行 fn(arg, 0..count-1)
+// 调用方自身也参与执行，只等待已被领取的迭代完成，因此可在工作线程内调用而不会死锁
+void thread_pool_parallel_for(ThreadPool *pool, size_t count, ThreadPoolRangeTask fn, void *arg) {
+    if (count == 0 || !fn) return;
+
+    ParallelFor *pf = pool && count > 1 ? malloc(sizeof(ParallelFor)) : NULL;
+    if (!pf) {
+        for (size_t i = 0; i < count; i++) {
+            fn(arg, i);
+        }
+        return;
+    }
+
+    pf->fn = fn;
+    pf->arg = arg;
+    pf->count = count;
+    pf->next = 0;
+    pf->completed = 0;
+    pf->refs = 1;
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->done, NULL);
+
+    size_t helpers = count - 1;
+    if (helpers > (size_t)pool->thread_count) helpers = pool->thread_count;
+    for (size_t i = 0; i < helpers; i++) {
+        pthread_mutex_lock(&pf->lock);
+        pf->refs++;
+        pthread_mutex_unlock(&pf->lock);
+        if (thread_pool_try_submit(pool, parallel_for_helper, pf) != 0) {
+            pthread_mutex_lock(&pf->lock);
+            pf->refs--;
+            pthread_mutex_unlock(&pf->lock);
+            break; // 队列已满，剩余迭代由调用方执行
+        }
+    }
+
+    parallel_for_drain(pf);
+
+    pthread_mutex_lock(&pf->lock);
+    while (pf->completed < pf->count) {
+        pthread_cond_wait(&pf->done, &pf->lock);
+    }
+    pthread_mutex_unlock(&pf->lock);
+
+    parallel_for_release(pf);
+}
+
+// 等待所有已提交任务执行完毕
+void thread_pool_wait(ThreadPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&pool->outstanding, __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(ThreadPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_cond_broadcast(&pool->not_full);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_cond_destroy(&pool->not_full);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->threads);
+    free(pool->slots);
+    free(pool);
+}
@@ -0,0 +1,516 @@
+#define _GNU_SOURCE // syscall, MAP_POPULATE, struct statx
+#include "uring_io.h"
+#include "config.h"
+#include "logging.h"
+#include "file_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+extern Config config;
+extern Statistics stats;
+extern volatile sig_atomic_t g_interrupted;
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define MIRRORGUARD_HAVE_URING 1
+#endif
+#endif
+
+#ifdef MIRRORGUARD_HAVE_URING
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <linux/io_uring.h>
+
+#ifndef AT_FDCWD
+#define AT_FDCWD -100
+#endif
+
+#define URING_ENTRIES (URING_QUEUE_DEPTH * 2)
+
+// 完成事件的 user_data 标记
+#define URING_TAG_OPEN  1
+#define URING_TAG_STATX 2
+#define URING_TAG_CLOSE 3
+#define URING_TAG_READ  16 // + 槽位序号
+
+// 每个工作线程一个 ring，缓冲区注册后重复使用
+typedef struct {
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+    unsigned char *buffers;        // URING_QUEUE_DEPTH * URING_BUFFER_SIZE
+    int buffers_registered;
+} UringRing;
+
+// 读请求槽位
+typedef struct {
+    off_t offset;
+    size_t want;
+    size_t len;
+    int state;                     // 0=空闲 1=在途 2=已完成待哈希
+} UringSlot;
+
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static volatile int uring_disabled = 0;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_destroy(UringRing *ring) {
+    if (!ring) return;
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) munmap(ring->sq_ptr, ring->sq_size);
+    if (ring->ring_fd >= 0) close(ring->ring_fd);
+    free(ring->buffers);
+    free(ring);
+}
+
+static void ring_key_destructor(void *ptr) {
+    ring_destroy((UringRing *)ptr);
+}
+
+static void ring_key_init(void) {
+    pthread_key_create(&ring_key, ring_key_destructor);
+}
+
+static UringRing* ring_create(void) {
+    UringRing *ring = calloc(1, sizeof(UringRing));
+    if (!ring) return NULL;
+    ring->ring_fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = sys_io_uring_setup(URING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring_destroy(ring);
+            return NULL;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring_destroy(ring);
+        return NULL;
+    }
+
+    unsigned char *sq = ring->sq_ptr;
+    unsigned char *cq = ring->cq_ptr;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // 读缓冲区：页对齐，尽量注册为固定缓冲区以省去每次读的页表映射
+    if (posix_memalign((void **)&ring->buffers, 4096, (size_t)URING_QUEUE_DEPTH * URING_BUFFER_SIZE) != 0) {
+        ring->buffers = NULL;
+        ring_destroy(ring);
+        return NULL;
+    }
+    struct iovec iov[URING_QUEUE_DEPTH];
+    for (int i = 0; i < URING_QUEUE_DEPTH; i++) {
+        iov[i].iov_base = ring->buffers + (size_t)i * URING_BUFFER_SIZE;
+        iov[i].iov_len = URING_BUFFER_SIZE;
+    }
+    // 注册失败 (如锁定内存上限不足) 时使用普通读请求
+    ring->buffers_registered =
+        sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iov, URING_QUEUE_DEPTH) == 0;
+
+    return ring;
+}
+
+// 取得当前线程的 ring，首次调用时创建
+static UringRing* ring_get(void) {
+    if (uring_disabled) return NULL;
+
+    pthread_once(&ring_key_once, ring_key_init);
+    UringRing *ring = pthread_getspecific(ring_key);
+    if (ring) return ring;
+
+    ring = ring_create();
+    if (!ring) {
+        if (!uring_disabled) {
+            uring_disabled = 1;
+            log_msg(LOG_WARN, "io_uring 不可用，回退到同步读取");
+        }
+        return NULL;
+    }
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+static struct io_uring_sqe* ring_get_sqe(UringRing *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+
+    unsigned index = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    ring->to_submit++;
+    return sqe;
+}
+
+// 提交所有已准备的请求，并至少等待 wait_nr 个完成事件
+static int ring_submit(UringRing *ring, unsigned wait_nr) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned to_submit = ring->to_submit;
+    while (to_submit > 0 || wait_nr > 0) {
+        int ret = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr,
+                                     wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                if (g_interrupted) return -1;
+                continue;
+            }
+            return -1;
+        }
+        to_submit -= (unsigned)ret < to_submit ? (unsigned)ret : to_submit;
+        break;
+    }
+    ring->to_submit = to_submit;
+    return 0;
+}
+
+static int ring_peek_cqe(UringRing *ring, struct io_uring_cqe *out) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return 0;
+
+    *out = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// 等待一个完成事件；上一个文件异步关闭产生的事件直接丢弃
+static int ring_wait_cqe(UringRing *ring, struct io_uring_cqe *out) {
+    for (;;) {
+        while (ring_peek_cqe(ring, out)) {
+            if (out->user_data != URING_TAG_CLOSE) return 0;
+        }
+        if (ring_submit(ring, 1) != 0) return -1;
+    }
+}
+
+static void prep_rw(struct io_uring_sqe *sqe, int op, int fd, const void *addr,
+                    unsigned len, unsigned long long offset, unsigned long long user_data) {
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+}
+
+static void queue_read(UringRing *ring, int fd, UringSlot *slots, int slot, off_t offset, size_t want) {
+    struct io_uring_sqe *sqe = ring_get_sqe(ring);
+    unsigned char *buf = ring->buffers + (size_t)slot * URING_BUFFER_SIZE;
+    prep_rw(sqe, ring->buffers_registered ? IORING_OP_READ_FIXED : IORING_OP_READ,
+            fd, buf, want, offset, URING_TAG_READ + slot);
+    if (ring->buffers_registered) sqe->buf_index = slot;
+
+    slots[slot].offset = offset;
+    slots[slot].want = want;
+    slots[slot].len = 0;
+    slots[slot].state = 1;
+}
+
+// 同步补齐短读 (被信号打断、文件变化等)；返回实际读到的字节数
+static ssize_t complete_short_read(int fd, unsigned char *buf, size_t have, size_t want, off_t offset) {
+    while (have < want) {
+        ssize_t n = pread(fd, buf + have, want - have, offset + have);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break; // 文件被截断
+        have += n;
+    }
+    return (ssize_t)have;
+}
+
+// 等待所有在途读请求完成 (出错或提前结束时调用)
+static void drain_reads(UringRing *ring, UringSlot *slots) {
+    struct io_uring_cqe cqe;
+    for (int i = 0; i < URING_QUEUE_DEPTH; i++) {
+        while (slots[i].state == 1) {
+            if (ring_wait_cqe(ring, &cqe) != 0) return;
+            if (cqe.user_data >= URING_TAG_READ && cqe.user_data < URING_TAG_READ + URING_QUEUE_DEPTH) {
+                slots[cqe.user_data - URING_TAG_READ].state = 0;
+            }
+        }
+    }
+}
+
+static void close_async(UringRing *ring, int fd) {
+    struct io_uring_sqe *sqe = ring_get_sqe(ring);
+    if (!sqe) {
+        close(fd);
+        return;
+    }
+    prep_rw(sqe, IORING_OP_CLOSE, fd, NULL, 0, 0, URING_TAG_CLOSE);
+    ring_submit(ring, 0); // 关闭结果不关心，完成事件在后续等待中丢弃
+}
+
+// 通过 io_uring 读取并哈希文件：open/statx 批量提交，
+// 读请求保持 URING_QUEUE_DEPTH 个在途，完成后按偏移顺序送入摘要
+int uring_hash_file(const char *file_path, DigestCtx *mdctx) {
+    if (!file_path || !mdctx) return -1;
+
+    UringRing *ring = ring_get();
+    if (!ring) return URING_UNAVAILABLE;
+
+    struct statx stx;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe cqe;
+
+    // 批量提交 openat + statx (O_NONBLOCK 避免在 FIFO 等特殊文件上阻塞)
+    sqe = ring_get_sqe(ring);
+    prep_rw(sqe, IORING_OP_OPENAT, AT_FDCWD, file_path, 0, 0, URING_TAG_OPEN);
+    sqe->open_flags = O_RDONLY | O_NONBLOCK;
+    sqe = ring_get_sqe(ring);
+    prep_rw(sqe, IORING_OP_STATX, AT_FDCWD, file_path, STATX_TYPE | STATX_SIZE,
+            (unsigned long long)(uintptr_t)&stx, URING_TAG_STATX);
+
+    if (ring_submit(ring, 2) != 0) {
+        return URING_UNAVAILABLE;
+    }
+
+    int fd = -1;
+    int open_err = 0;
+    int statx_err = 0;
+    for (int got = 0; got < 2; got++) {
+        if (ring_wait_cqe(ring, &cqe) != 0) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        if (cqe.user_data == URING_TAG_OPEN) {
+            if (cqe.res >= 0) fd = cqe.res;
+            else open_err = -cqe.res;
+        } else if (cqe.user_data == URING_TAG_STATX) {
+            if (cqe.res < 0) statx_err = -cqe.res;
+        }
+    }
+
+    // 内核不支持这些操作码时整体回退
+    if (open_err == EINVAL || statx_err == EINVAL) {
+        if (fd >= 0) close(fd);
+        return URING_UNAVAILABLE;
+    }
+
+    if (statx_err) {
+        log_msg(LOG_WARN, "无法访问文件 '%s': %s", file_path, strerror(statx_err));
+        if (fd >= 0) close_async(ring, fd);
+        return -1;
+    }
+    if (!S_ISREG(stx.stx_mode)) {
+        log_msg(LOG_WARN, "非普通文件: %s", file_path);
+        if (fd >= 0) close_async(ring, fd);
+        return -1;
+    }
+    if (fd < 0) {
+        log_msg(LOG_WARN, "无法打开文件 '%s': %s", file_path, strerror(open_err));
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_RDONLY); // 确认为普通文件后恢复阻塞读
+
+    off_t size = (off_t)stx.stx_size;
+    off_t next_submit = 0;
+    off_t next_hash = 0;
+    off_t dropped = 0;
+    int failed = 0;
+    UringSlot slots[URING_QUEUE_DEPTH];
+    memset(slots, 0, sizeof(slots));
+
+    for (int i = 0; i < URING_QUEUE_DEPTH && next_submit < size; i++) {
+        size_t want = size - next_submit < URING_BUFFER_SIZE ? (size_t)(size - next_submit) : URING_BUFFER_SIZE;
+        queue_read(ring, fd, slots, i, next_submit, want);
+        next_submit += want;
+    }
+
+    while (next_hash < size && !failed) {
+        if (g_interrupted || ring_wait_cqe(ring, &cqe) != 0) {
+            failed = 1;
+            break;
+        }
+        if (cqe.user_data < URING_TAG_READ || cqe.user_data >= URING_TAG_READ + URING_QUEUE_DEPTH) {
+            continue;
+        }
+
+        int slot = (int)(cqe.user_data - URING_TAG_READ);
+        unsigned char *buf = ring->buffers + (size_t)slot * URING_BUFFER_SIZE;
+        ssize_t len = cqe.res;
+        if (len < 0 && (len == -EAGAIN || len == -EINTR)) {
+            len = 0;
+        } else if (len < 0) {
+            log_msg(LOG_ERROR, "读取文件 '%s' 失败: %s", file_path, strerror((int)-len));
+            slots[slot].state = 0;
+            failed = 1;
+            break;
+        }
+        if ((size_t)len < slots[slot].want) {
+            len = complete_short_read(fd, buf, (size_t)len, slots[slot].want, slots[slot].offset);
+            if (len < 0) {
+                log_msg(LOG_ERROR, "读取文件 '%s' 失败: %s", file_path, strerror(errno));
+                slots[slot].state = 0;
+                failed = 1;
+                break;
+            }
+            if ((size_t)len < slots[slot].want) {
+                size = slots[slot].offset + len; // 文件在读取过程中被截断
+            }
+        }
+        slots[slot].len = (size_t)len;
+        slots[slot].state = 2;
+
+        // 按偏移顺序哈希已完成的槽位，并复用槽位提交后续读取
+        int progressed = 1;
+        while (progressed && !failed) {
+            progressed = 0;
+            for (int i = 0; i < URING_QUEUE_DEPTH; i++) {
+                if (slots[i].state != 2 || slots[i].offset != next_hash) continue;
+
+                unsigned char *data = ring->buffers + (size_t)i * URING_BUFFER_SIZE;
+                if (digest_update(mdctx, data, slots[i].len) != 0) {
+                    failed = 1;
+                    break;
+                }
+                next_hash += slots[i].len;
+                slots[i].state = 0;
+                progressed = 1;
+                if (next_hash - dropped >= DONTNEED_WINDOW) {
+                    drop_file_cache(fd, dropped, next_hash - dropped);
+                    dropped = next_hash;
+                }
+
+                pthread_mutex_lock(&stats.lock);
+                stats.bytes_processed += slots[i].len;
+                pthread_mutex_unlock(&stats.lock);
+
+                if (next_submit < size) {
+                    size_t want = size - next_submit < URING_BUFFER_SIZE ? (size_t)(size - next_submit) : URING_BUFFER_SIZE;
+                    queue_read(ring, fd, slots, i, next_submit, want);
+                    next_submit += want;
+                }
+            }
+        }
+        if (ring->to_submit > 0 && ring_submit(ring, 0) != 0) {
+            failed = 1;
+        }
+    }
+
+    drain_reads(ring, slots);
+
+    // 与同步路径一致：读到 EOF 为止 (文件在 statx 之后增长的部分)
+    unsigned char *tail_buf = ring->buffers;
+    while (!failed && !g_interrupted) {
+        ssize_t n = pread(fd, tail_buf, URING_BUFFER_SIZE, next_hash);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_msg(LOG_ERROR, "读取文件 '%s' 失败: %s", file_path, strerror(errno));
+            failed = 1;
+            break;
+        }
+        if (n == 0) break;
+        if (digest_update(mdctx, tail_buf, n) != 0) {
+            failed = 1;
+            break;
+        }
+        next_hash += n;
+        pthread_mutex_lock(&stats.lock);
+        stats.bytes_processed += n;
+        pthread_mutex_unlock(&stats.lock);
+    }
+
+    drop_file_cache(fd, 0, 0);
+    close_async(ring, fd);
+    return failed || g_interrupted ? -1 : 0;
+}
+
+int uring_available(void) {
+    return ring_get() != NULL;
+}
+
+#else // !MIRRORGUARD_HAVE_URING
+
+int uring_hash_file(const char *file_path, DigestCtx *mdctx) {
+    (void)file_path;
+    (void)mdctx;
+    return URING_UNAVAILABLE;
+}
+
+int uring_available(void) {
+    return 0;
+}
+
+#endif
@@ -5,6 +5,12 @@
 #include "directory_scan.h"
 #include "file_utils.h"
 #include "progress.h"
+#include "thread_pool.h"
+#include "manifest.h"
+#include "mgidx.h"
+#include "journal.h"
+#include "shard.h"
+#include "dispatch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,84 +23,323 @@ extern Config config;
 extern Statistics stats;
 extern volatile sig_atomic_t g_interrupted;
 
-// 生成清单 (多源模式)
-int generate_manifest_multi(const char *manifest_path) {
-    if (!manifest_path) {
-        log_msg(LOG_ERROR, "生成清单参数错误");
-        return MIRRORGUARD_ERROR_INVALID_ARGS;
+// 验证窗口中的一个条目：工作线程校验后写回结果，主线程按序号顺序取出报告
+typedef struct VerifyWindow VerifyWindow;
+
+typedef struct {
+    VerifyWindow *window;
+    size_t ordinal;                // 清单中的序号
+    char *rel_path;
+    Digest expected;
+    long long expected_size;       // 清单未记录大小时为 -1
+    FileStatus result;
+    int skipped;                   // 已中断，未校验
+    int done;                      // 工作线程完成后置 1
+} VerifySlot;
+
+// 重排窗口：清单条目按序号放入环形槽位并提交到工作池并行校验，
+// 主线程从头部依次报告已完成的条目，日志与计数保持清单顺序；窗口满时等待最早的条目
+struct VerifyWindow {
+    VerifySlot slots[VERIFY_WINDOW];
+    const char *mirror_dir;
+    size_t head;                   // 下一个待报告的序号
+    size_t tail;                   // 下一个待提交的序号
+    size_t cursor;                 // 续传游标：清单序号小于它的条目均已报告
+    size_t cursor_processed;       // 游标处的已处理数
+    int stopped;                   // 已遇到中断跳过的条目，游标不再前进
+    int waiting;                   // 主线程正在等待头部条目
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+};
+
+static void verify_job_run(void *arg) {
+    VerifySlot *slot = (VerifySlot *)arg;
+    VerifyWindow *window = slot->window;
+
+    if (g_interrupted) {
+        slot->skipped = 1;
+    } else {
+        slot->result = verify_file(window->mirror_dir, slot->rel_path, &slot->expected, slot->expected_size);
+        // 读取中途被中断不算验证错误，续传时重新验证
+        if (slot->result == FILE_STATUS_ERROR && g_interrupted) slot->skipped = 1;
     }
 
-    FileList *list = create_file_list();
-    if (!list) {
-        return MIRRORGUARD_ERROR_MEMORY;
+    // 主线程未等待时不加锁；与 verify_wait 中 waiting/done 的顺序一致性读写配对，不会丢失唤醒
+    __atomic_store_n(&slot->done, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&window->waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&window->lock);
+        pthread_cond_signal(&window->done_cond);
+        pthread_mutex_unlock(&window->lock);
+    }
+}
+
+static void verify_wait(VerifyWindow *window, VerifySlot *slot) {
+    if (__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&window->lock);
+    __atomic_store_n(&window->waiting, 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&slot->done, __ATOMIC_SEQ_CST)) {
+        pthread_cond_wait(&window->done_cond, &window->lock);
     }
+    __atomic_store_n(&window->waiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&window->lock);
+}
 
-    log_msg(LOG_INFO, "开始扫描 %d 个源目录", config.source_count);
+// 报告一个条目的结果，续传时也用于回放上次运行的失败条目；
+// 计数只由主线程更新，用原子操作供 TUI 读取，无需 stats.lock
+static void verify_report_result(FileStatus result, const char *rel_path) {
+    report_add(result, rel_path);
+    if (result == FILE_STATUS_ERROR && strlen(rel_path) >= MAX_PATH) {
+        log_msg(LOG_ERROR, "❌ 路径过长: %s", rel_path);
+        __atomic_add_fetch(&stats.error_files, 1, __ATOMIC_RELAXED);
+    } else if (result == FILE_STATUS_MISSING) {
+        log_msg(LOG_ERROR, "❌ 缺失文件: %s", rel_path);
+        __atomic_add_fetch(&stats.missing_files, 1, __ATOMIC_RELAXED);
+    } else if (result == FILE_STATUS_CORRUPT) {
+        log_msg(LOG_ERROR, "❌ 哈希不匹配: %s", rel_path);
+        __atomic_add_fetch(&stats.corrupt_files, 1, __ATOMIC_RELAXED);
+    } else if (result == FILE_STATUS_ERROR) {
+        log_msg(LOG_ERROR, "❌ 验证错误: %s", rel_path);
+        __atomic_add_fetch(&stats.error_files, 1, __ATOMIC_RELAXED);
+    } else if (!config.quiet) {
+        log_msg(LOG_INFO, "✅ 有效: %s", rel_path);
+    }
+    size_t processed = __atomic_add_fetch(&stats.processed_files, 1, __ATOMIC_RELAXED);
+    update_progress_bar(0, processed);
+}
 
-    // 为每个源目录创建进度条
-    for (int i = 0; i < config.source_count; i++) {
-        char progress_name[MAX_PATH];
-        snprintf(progress_name, sizeof(progress_name), "扫描源%d", i + 1);
-        create_progress_bar(progress_name, 0, i); // 初始化为0，后续更新
+// 报告头部条目；失败结果与续传游标按清单顺序记入续传日志，中断跳过的条目之后游标不再前进
+static void verify_report(VerifySlot *slot) {
+    VerifyWindow *window = slot->window;
+    if (slot->skipped) {
+        window->stopped = 1;
+    } else {
+        verify_report_result(slot->result, slot->rel_path);
+        if (!window->stopped) {
+            if (slot->result != FILE_STATUS_VALID) {
+                journal_record_result(slot->result, slot->ordinal, slot->rel_path);
+            }
+            window->cursor = slot->ordinal + 1;
+            window->cursor_processed = stats.processed_files;
+            journal_checkpoint(window->cursor, window->cursor_processed, 0);
+        }
     }
+    free(slot->rel_path);
+    slot->rel_path = NULL;
+}
 
-    // 递归收集所有源目录的文件
-    for (int i = 0; i < config.source_count; i++) {
+// 依次报告头部已完成的条目；block 为非 0 时等待全部在途条目
+static void verify_drain(VerifyWindow *window, int block) {
+    while (window->head < window->tail) {
+        VerifySlot *slot = &window->slots[window->head % VERIFY_WINDOW];
+        if (block) {
+            verify_wait(window, slot);
+        } else if (!__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        verify_report(slot);
+        window->head++;
+    }
+}
+
+// 提交一个清单条目，接管 rel_path；窗口已满时先报告最早的条目；
+// 超长路径不提交校验，直接按验证错误报告
+static void verify_submit(VerifyWindow *window, char *rel_path, const ManifestEntry *entry, size_t ordinal) {
+    if (window->tail - window->head == VERIFY_WINDOW) {
+        VerifySlot *oldest = &window->slots[window->head % VERIFY_WINDOW];
+        verify_wait(window, oldest);
+        verify_report(oldest);
+        window->head++;
+    }
+
+    VerifySlot *slot = &window->slots[window->tail % VERIFY_WINDOW];
+    slot->rel_path = rel_path;
+    slot->window = window;
+    slot->ordinal = ordinal;
+    slot->expected = entry->digest;
+    slot->expected_size = entry->size;
+    slot->skipped = 0;
+    slot->done = 0;
+    window->tail++;
+
+    if (entry->path_len >= MAX_PATH) {
+        slot->result = FILE_STATUS_ERROR;
+        slot->done = 1;
+        return;
+    }
+
+    if (!g_hash_pool || thread_pool_submit(g_hash_pool, verify_job_run, slot) != 0) {
+        verify_job_run(slot);
+    }
+}
+
+// 中断或失败时刷盘保留续传日志
+static void journal_keep(void) {
+    const char *path = journal_path();
+    if (path && g_interrupted) {
+        log_msg(LOG_WARN, "已中断，进度已保存到续传日志 %s，使用 --resume 继续", path);
+    }
+    journal_close(1);
+}
+
+// 指定了 --resume 或 --journal 时才记录续传日志 (模拟运行不记录)：
+// 日志每个文件追加一行并定期 fsync，不需要续传时不承担这部分开销
+static int journal_wanted(void) {
+    return !config.dry_run && (config.resume || config.journal_path);
+}
+
+// 遍历源目录、等待哈希完成并写出清单；失败时清理临时文件，续传日志与文件列表由调用方处理
+static int generate_into(const char *manifest_path, FileList *list) {
+    // 树哈希模式：块摘要写入 <清单>.blocks，与清单一起原子重命名
+    char temp_blocks[MAX_PATH];
+    char blocks_path[MAX_PATH];
+    snprintf(temp_blocks, sizeof(temp_blocks), "%s.blocks.tmp.%d", manifest_path, getpid());
+    snprintf(blocks_path, sizeof(blocks_path), "%s.blocks", manifest_path);
+    int write_blocks = config.tree_hash && !config.dry_run;
+    if (write_blocks && block_log_open(temp_blocks) != 0) {
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+
+    // 分布式生成：遍历仍在本地进行，待哈希的文件由 worker 进程拉取 (scan_wait 时等待全部结果)
+    if (config.coordinator_addr) {
+        int dispatch_result = dispatch_start(config.coordinator_addr);
+        if (dispatch_result != MIRRORGUARD_OK) {
+            if (write_blocks) {
+                block_log_close();
+                unlink(temp_blocks);
+            }
+            return dispatch_result;
+        }
+    }
+
+    log_msg(LOG_INFO, "开始扫描 %d 个源目录", config.source_count);
+
+    // 总数随遍历增长，遍历结束后固定并给出剩余时间
+    create_progress_bar("生成清单", 0, 0);
+
+    // 依次遍历所有源目录，哈希在工作池中并行进行，全部遍历结束后统一等待
+    int scan_failed = 0;
+    for (int i = 0; i < config.source_count && !scan_failed; i++) {
         log_msg(LOG_INFO, "扫描源目录: %s", config.source_dirs[i]);
-        if (scan_directory(config.source_dirs[i], list) != 0) {
-            free_file_list(list);
-            return MIRRORGUARD_ERROR_FILE_IO;
+        scan_failed = scan_directory(config.source_dirs[i], list, i) != 0;
+    }
+    if (scan_wait() != 0 || scan_failed) {
+        if (write_blocks) {
+            block_log_close();
+            unlink(temp_blocks);
         }
+        return g_interrupted ? MIRRORGUARD_ERROR_INTERRUPTED : MIRRORGUARD_ERROR_FILE_IO;
     }
 
-    if (list->count == 0) {
+    if (write_blocks && block_log_close() != 0) {
+        log_msg(LOG_ERROR, "写入块摘要文件失败: %s", strerror(errno));
+        unlink(temp_blocks);
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+
+    size_t total = file_list_total(list);
+    if (total == 0) {
         log_msg(LOG_ERROR, "未找到可处理的文件");
-        free_file_list(list);
+        if (write_blocks) unlink(temp_blocks);
         return MIRRORGUARD_ERROR_GENERAL;
     }
 
-    log_msg(LOG_INFO, "找到 %zu 个文件，开始生成清单...", list->count);
+    log_msg(LOG_INFO, "找到 %zu 个文件，开始生成清单...", total);
 
     // 创建临时清单
     char temp_manifest[MAX_PATH];
     snprintf(temp_manifest, sizeof(temp_manifest), "%s.tmp.%d", manifest_path, getpid());
 
-    if (!config.dry_run) {
-        FILE *manifest = fopen(temp_manifest, "w");
-        if (!manifest) {
-            log_msg(LOG_ERROR, "无法创建临时清单: %s", strerror(errno));
-            free_file_list(list);
-            return MIRRORGUARD_ERROR_FILE_IO;
-        }
+    int result = MIRRORGUARD_OK;
+    if (!config.dry_run && manifest_output_binary()) {
+        // 二进制清单：记录源目录，条目按路径排序写出
+        result = mgidx_write(temp_manifest, list, config.digest_algo, manifest_output_fields(),
+                             config.source_dirs, config.source_count);
+    } else if (!config.dry_run) {
+        // --compress 时由后台线程分块压缩，与格式化并行
+        ManifestWriter writer;
+        result = manifest_writer_open(&writer, temp_manifest, config.digest_algo, manifest_output_fields(),
+                                      config.compress);
+
+        // 并行哈希的完成顺序不确定，按路径有序遍历保证清单稳定
+        // (超出内存上限时已写出的有序段在此多路归并)
+        FileListIter it;
+        if (result == MIRRORGUARD_OK && file_list_iter_begin(list, &it) != 0) {
+            manifest_writer_close(&writer);
+            result = MIRRORGUARD_ERROR_MEMORY;
+        } else if (result == MIRRORGUARD_OK) {
+            // 写入清单头与所有文件信息
+            manifest_writer_header(&writer, total);
+            const FileInfo *info;
+            while ((info = file_list_iter_next(&it)) != NULL) {
+                manifest_writer_entry(&writer, info);
+            }
+            file_list_iter_end(&it);
 
-        // 写入所有文件信息
-        for (size_t i = 0; i < list->count; i++) {
-            fprintf(manifest, "%s *%s\n", list->files[i].hash, list->files[i].path);
+            if (manifest_writer_close(&writer) != 0) {
+                log_msg(LOG_ERROR, "写入清单失败: %s", strerror(errno));
+                result = MIRRORGUARD_ERROR_FILE_IO;
+            }
         }
+    }
 
-        fclose(manifest);
+    // 原子重命名临时清单
+    if (result == MIRRORGUARD_OK && !config.dry_run && rename(temp_manifest, manifest_path) != 0) {
+        log_msg(LOG_ERROR, "无法完成清单: %s", strerror(errno));
+        result = MIRRORGUARD_ERROR_FILE_IO;
     }
+    if (result != MIRRORGUARD_OK) {
+        unlink(temp_manifest);
+        if (write_blocks) unlink(temp_blocks);
+        return result;
+    }
+    if (write_blocks && rename(temp_blocks, blocks_path) != 0) {
+        log_msg(LOG_ERROR, "无法完成块摘要文件: %s", strerror(errno));
+        unlink(temp_blocks);
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+
+    log_msg(LOG_INFO, "多源清单生成成功: %s", manifest_path);
+    log_msg(LOG_INFO, "总计文件数: %zu", total);
 
-    if (!config.dry_run) {
-        // 原子重命名临时清单
-        if (rename(temp_manifest, manifest_path) != 0) {
-            log_msg(LOG_ERROR, "无法完成清单: %s", strerror(errno));
-            unlink(temp_manifest);
+    finish_progress_bar(0);
+    return MIRRORGUARD_OK;
+}
+
+// 生成清单 (多源模式)
+int generate_manifest_multi(const char *manifest_path) {
+    if (!manifest_path) {
+        log_msg(LOG_ERROR, "生成清单参数错误");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    FileList *list = create_file_list();
+    if (!list) {
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
+    file_list_set_memory_limit(list, config.memory_limit);
+
+    // 续传日志：哈希完成的文件随时追加，中断后 --resume 只处理其余文件
+    char journal_default[MAX_PATH];
+    snprintf(journal_default, sizeof(journal_default), "%s.journal", manifest_path);
+    if (journal_wanted()) {
+        int journal_result = journal_open_generate(config.journal_path ? config.journal_path : journal_default,
+                                                   config.resume);
+        if (journal_result != MIRRORGUARD_OK) {
             free_file_list(list);
-            return MIRRORGUARD_ERROR_FILE_IO;
+            return journal_result;
         }
     }
 
-    log_msg(LOG_INFO, "多源清单生成成功: %s", manifest_path);
-    log_msg(LOG_INFO, "总计文件数: %zu", list->count);
-
-    // 完成所有进度条
-    for (int i = 0; i < config.source_count; i++) {
-        finish_progress_bar(i);
+    // 成功后删除续传日志；任何失败都刷盘保留，供 --resume 继续
+    int result = generate_into(manifest_path, list);
+    if (result == MIRRORGUARD_OK) {
+        journal_close(0);
+    } else {
+        journal_keep();
     }
 
     free_file_list(list);
-    return MIRRORGUARD_OK;
+    return result;
 }
 
 // 验证镜像
@@ -104,139 +349,216 @@ int verify_mirror(const char *mirror_dir, const char *manifest_path) {
         return MIRRORGUARD_ERROR_INVALID_ARGS;
     }
 
-    FILE *manifest = fopen(manifest_path, "r");
-    if (!manifest) {
-        log_msg(LOG_ERROR, "无法打开清单: %s", strerror(errno));
-        return MIRRORGUARD_ERROR_FILE_IO;
+    ManifestReader manifest;
+    int open_result = manifest_open(&manifest, manifest_path);
+    if (open_result != MIRRORGUARD_OK) {
+        return open_result;
     }
 
-    char line[MAX_PATH + SHA256_DIGEST_LENGTH * 2 + 10];
-    char expected_hash[SHA256_DIGEST_LENGTH * 2 + 1];
-    char rel_path[MAX_PATH];
-    int missing_count = 0;
-    int corrupt_count = 0;
-    int total_files = 0;
-    int total_errors = 0;
+    // 摘要算法以清单头为准
+    config.digest_algo = manifest.algo;
+
+    ManifestEntry entry;
+    size_t total_files = 0;
+    size_t excluded_files = 0;     // 被排除或不属于本分片的条目，不计入报告总数
 
     // 用于检测额外文件
     FileList *mirror_files = create_file_list();
     if (!mirror_files) {
-        fclose(manifest);
+        manifest_close(&manifest);
         return MIRRORGUARD_ERROR_MEMORY;
     }
 
-    log_msg(LOG_INFO, "开始验证镜像: %s", mirror_dir);
+    log_msg(LOG_INFO, "开始验证镜像: %s (算法: %s)", mirror_dir, digest_engine_get(manifest.algo)->name);
+
+    // 树哈希条目损坏时用块摘要文件定位损坏区间
+    char blocks_path[MAX_PATH];
+    snprintf(blocks_path, sizeof(blocks_path), "%s.blocks", manifest_path);
+    config.block_list_path = access(blocks_path, R_OK) == 0 ? blocks_path : NULL;
 
+    // 额外文件检测：只遍历镜像的元数据 (文件内容由验证任务读取一次)，
+    // 按路径建立索引，清单条目逐条查表标记，总代价与文件数成线性
+    unsigned char *verified = NULL;
+    char mirror_path[MAX_PATH];
     if (config.extra_check) {
         log_msg(LOG_INFO, "扫描镜像目录以检测额外文件...");
-        scan_directory(mirror_dir, mirror_files);
-        log_msg(LOG_INFO, "镜像中找到 %zu 个文件", mirror_files->count);
+        scan_directory_metadata(mirror_dir, mirror_files);
+        log_msg(LOG_INFO, "镜像中找到 %zu 个文件", file_list_total(mirror_files));
+        verified = calloc(mirror_files->count ? mirror_files->count : 1, 1);
+        if (!verified || file_list_build_index(mirror_files) != 0) {
+            free(verified);
+            free_file_list(mirror_files);
+            manifest_close(&manifest);
+            return MIRRORGUARD_ERROR_MEMORY;
+        }
     }
 
-    log_msg(LOG_INFO, "读取清单文件: %s", manifest_path);
+    VerifyWindow *window = malloc(sizeof(VerifyWindow));
+    if (!window) {
+        free(verified);
+        free_file_list(mirror_files);
+        manifest_close(&manifest);
+        return MIRRORGUARD_ERROR_MEMORY;
+    }
 
-    // 先统计总文件数
-    long pos = ftell(manifest);
-    while (fgets(line, sizeof(line), manifest)) {
-        if (sscanf(line, "%64s *%[^\n]", expected_hash, rel_path) == 2) {
-            total_files++;
+    // 续传日志：失败结果与已完成的清单序号按序记录；--resume 时回放上次的失败结果，跳过已验证的条目
+    JournalResume resume;
+    memset(&resume, 0, sizeof(resume));
+    char journal_default[MAX_PATH];
+    snprintf(journal_default, sizeof(journal_default), "%s.verify-journal", manifest_path);
+    if (journal_wanted()) {
+        int journal_result = journal_open_verify(config.journal_path ? config.journal_path : journal_default,
+                                                 manifest_path, mirror_dir, config.resume, &resume);
+        if (journal_result != MIRRORGUARD_OK) {
+            free(window);
+            free(verified);
+            free_file_list(mirror_files);
+            manifest_close(&manifest);
+            return journal_result;
         }
     }
-    fseek(manifest, pos, SEEK_SET);
 
-    // 创建进度条
-    create_progress_bar("验证镜像", total_files, 0);
+    window->mirror_dir = mirror_dir;
+    window->head = 0;
+    window->tail = 0;
+    window->cursor = resume.cursor;
+    window->cursor_processed = resume.processed;
+    window->stopped = 0;
+    window->waiting = 0;
+    pthread_mutex_init(&window->lock, NULL);
+    pthread_cond_init(&window->done_cond, NULL);
+
+    log_msg(LOG_INFO, "读取清单文件: %s", manifest_path);
+
+    // 总数取清单头声明的条目数，旧清单按文件大小估算并随读取修正，不再预先读一遍
+    create_progress_bar("验证镜像", manifest_estimate_total(&manifest, 0), 0);
 
-    // 验证清单中的每个文件
-    int processed = 0;
-    while (fgets(line, sizeof(line), manifest)) {
+    if (resume.cursor > 0) {
+        log_msg(LOG_INFO, "从第 %zu 个清单条目继续验证", resume.cursor + 1);
+        for (size_t i = 0; i < resume.result_count; i++) {
+            verify_report_result(resume.results[i].status, resume.results[i].path);
+        }
+        stats.processed_files = resume.processed;
+        update_progress_bar(0, resume.processed);
+    }
+    journal_free_resume(&resume);
+
+    // 清单只读一遍：条目流式提交到工作池并行校验，结果经重排窗口按清单顺序报告
+    while (manifest_next(&manifest, &entry)) {
         if (g_interrupted) {
             break;
         }
 
-        // 清单格式: <hash> *<relative_path>
-        if (sscanf(line, "%64s *%[^\n]", expected_hash, rel_path) != 2) {
-            continue; // 跳过无效行
+        size_t ordinal = total_files++;
+        if (manifest.count == 0 && total_files % 1024 == 0) {
+            set_progress_total(0, manifest_estimate_total(&manifest, total_files));
         }
 
+        // 上次运行已验证的条目只标记镜像中对应的文件
+        size_t index;
+        if (ordinal < window->cursor) {
+            if (entry.path_len < MAX_PATH) {
+                memcpy(mirror_path, entry.path, entry.path_len);
+                mirror_path[entry.path_len] = '\0';
+                if (config.report_path && should_exclude(mirror_path)) excluded_files++;
+                if (config.extra_check && file_list_find(mirror_files, mirror_path, &index)) verified[index] = 1;
+            } else if (config.report_path) {
+                char *long_path = strndup(entry.path, entry.path_len);
+                if (long_path && should_exclude(long_path)) excluded_files++;
+                free(long_path);
+            }
+            continue;
+        }
+
+        // 条目路径指向清单映射，复制一份交给验证任务
+        char *rel_path = strndup(entry.path, entry.path_len);
+        if (!rel_path) {
+            log_msg(LOG_ERROR, "内存分配失败: 验证任务");
+            __atomic_add_fetch(&stats.error_files, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        // 超长路径同样先按排除规则过滤，未被排除的才按验证错误报告
         if (should_exclude(rel_path)) {
+            free(rel_path);
+            excluded_files++;
             continue;
         }
 
-        FileStatus result = verify_file(mirror_dir, rel_path, expected_hash);
-
-        if (result == FILE_STATUS_MISSING) {
-            log_msg(LOG_ERROR, "❌ 缺失文件: %s", rel_path);
-            missing_count++;
-        } else if (result == FILE_STATUS_CORRUPT) {
-            log_msg(LOG_ERROR, "❌ 哈希不匹配: %s", rel_path);
-            corrupt_count++;
-        } else if (result == FILE_STATUS_ERROR) {
-            log_msg(LOG_ERROR, "❌ 验证错误: %s", rel_path);
-            total_errors++;
-        } else if (!config.quiet) {
-            log_msg(LOG_INFO, "✅ 有效: %s", rel_path);
-        }
-
-        // 更新统计
-        pthread_mutex_lock(&stats.lock);
-        stats.processed_files++;
-        if (result == FILE_STATUS_MISSING) stats.missing_files++;
-        else if (result == FILE_STATUS_CORRUPT) stats.corrupt_files++;
-        else if (result == FILE_STATUS_ERROR) stats.error_files++;
-        pthread_mutex_unlock(&stats.lock);
-
-        processed++;
-        update_progress_bar(0, processed);
-
-        // 从mirror_files中移除已验证的文件
-        if (config.extra_check) {
-            for (size_t i = 0; i < mirror_files->count; i++) {
-                if (mirror_files->files[i].path) {
-                    const char *mirror_path = mirror_files->files[i].path;
-                    if (strstr(mirror_path, rel_path) &&
-                        strlen(mirror_path) - strlen(mirror_dir) - 1 == strlen(rel_path)) {
-                        // 标记为已验证
-                        free(mirror_files->files[i].path);
-                        mirror_files->files[i].path = NULL;
-                        break;
-                    }
-                }
-            }
+        // 标记镜像中对应的文件
+        if (entry.path_len < MAX_PATH && config.extra_check && file_list_find(mirror_files, rel_path, &index)) {
+            verified[index] = 1;
         }
+
+        verify_submit(window, rel_path, &entry, ordinal);
+        verify_drain(window, 0);
     }
 
-    fclose(manifest);
+    // 等待并报告所有在途条目
+    verify_drain(window, 1);
+    thread_pool_wait(g_hash_pool);
+    set_progress_total(0, total_files);
+
+    // 中断时把游标刷盘，保留日志供 --resume 继续；正常结束后删除
+    int interrupted = g_interrupted;
+    int manifest_failed = manifest.failed;
+    if (interrupted || manifest_failed) {
+        journal_checkpoint(window->cursor, window->cursor_processed, 1);
+        journal_keep();
+    } else {
+        journal_close(0);
+    }
+    pthread_mutex_destroy(&window->lock);
+    pthread_cond_destroy(&window->done_cond);
+    free(window);
+    block_list_free();
+    config.block_list_path = NULL;
+
+    manifest_close(&manifest);
+    if (manifest_failed) {
+        log_msg(LOG_ERROR, "❌ 清单读取不完整，其余条目未验证");
+        __atomic_add_fetch(&stats.error_files, 1, __ATOMIC_RELAXED);
+    }
 
     // 完成进度条
     finish_progress_bar(0);
 
-    // 检查额外文件
+    // 检查额外文件 (清单不完整或验证中断时无从判断)
     if (config.extra_check) {
-        for (size_t i = 0; i < mirror_files->count; i++) {
-            if (mirror_files->files[i].path && !should_exclude(mirror_files->files[i].path)) {
-                log_msg(LOG_WARN, "⚠  额外文件: %s", mirror_files->files[i].path);
-                pthread_mutex_lock(&stats.lock);
-                stats.extra_files++;
-                pthread_mutex_unlock(&stats.lock);
-                free(mirror_files->files[i].path);
-                mirror_files->files[i].path = NULL;
+        for (size_t i = 0; i < mirror_files->count && !manifest_failed && !interrupted; i++) {
+            if (verified[i]) continue;
+            const char *path = file_list_path(mirror_files, i, mirror_path, sizeof(mirror_path));
+            if (!should_exclude(path)) {
+                log_msg(LOG_WARN, "⚠  额外文件: %s", path);
+                __atomic_add_fetch(&stats.extra_files, 1, __ATOMIC_RELAXED);
+                report_add(FILE_STATUS_EXTRA, path);
             }
         }
+        free(verified);
         free_file_list(mirror_files);
     } else {
         free_file_list(mirror_files);
     }
 
     log_msg(LOG_INFO, "\n验证结果:");
-    log_msg(LOG_INFO, "  总文件数: %d", total_files);
+    log_msg(LOG_INFO, "  总文件数: %zu", total_files);
     log_msg(LOG_INFO, "  已处理: %zu", stats.processed_files);
     log_msg(LOG_INFO, "  缺失文件: %zu", stats.missing_files);
     log_msg(LOG_INFO, "  损坏文件: %zu", stats.corrupt_files);
     log_msg(LOG_INFO, "  验证错误: %zu", stats.error_files);
     log_msg(LOG_INFO, "  额外文件: %zu", stats.extra_files);
 
-    if (missing_count > 0 || corrupt_count > 0 || total_errors > 0) {
+    if (interrupted) {
+        log_msg(LOG_ERROR, "❌ 验证已中断，结果不完整");
+        report_write(NULL, 0);  // 结果不完整，不写报告
+        return MIRRORGUARD_ERROR_INTERRUPTED;
+    }
+
+    // 验证报告供 --merge 汇总各分片的结果
+    if (report_write(config.dry_run ? NULL : config.report_path, total_files - excluded_files) != MIRRORGUARD_OK) {
+        return MIRRORGUARD_ERROR_FILE_IO;
+    }
+
+    if (stats.missing_files > 0 || stats.corrupt_files > 0 || stats.error_files > 0) {
         log_msg(LOG_ERROR, "❌ 镜像验证失败!");
         return MIRRORGUARD_ERROR_VERIFY_FAILED;
     }
@@ -244,3 +566,144 @@ int verify_mirror(const char *mirror_dir, const char *manifest_path) {
     log_msg(LOG_INFO, "✅ 镜像验证成功 - 100%% 完整!");
     return MIRRORGUARD_OK;
 }
+
+// 清单条目加入列表，供转换为二进制清单时排序
+static void add_convert_entry(void *arg, const ManifestEntry *entry) {
+    add_file_to_list_n((FileList *)arg, entry->path, entry->path_len, &entry->digest,
+                       entry->size < 0 ? 0 : entry->size, entry->mtime < 0 ? 0 : entry->mtime);
+}
+
+// 按输入顺序写出文本清单
+static int write_text_manifest(ManifestWriter *writer, ManifestReader *reader) {
+    char path[MAX_PATH];
+    FileInfo info;
+    ManifestEntry entry;
+    int result = manifest_writer_header(writer, reader->cursor || reader->blocks ? reader->count : 0);
+    while (result == 0 && manifest_next(reader, &entry)) {
+        if (entry.path_len >= MAX_PATH) {
+            log_msg(LOG_ERROR, "路径过长: %.*s", (int)entry.path_len, entry.path);
+            continue;
+        }
+        memcpy(path, entry.path, entry.path_len);
+        path[entry.path_len] = '\0';
+        info.path = path;
+        info.digest = entry.digest;
+        info.size = entry.size < 0 ? 0 : (size_t)entry.size;
+        info.mtime = entry.mtime < 0 ? 0 : (time_t)entry.mtime;
+        result = manifest_writer_entry(writer, &info);
+    }
+    return result;
+}
+
+// 清单格式转换：输出格式由 -o 决定，保留输入中记录的字段 (sha256sum 格式除外)
+int convert_manifest(const char *input_path, const char *output_path) {
+    if (!input_path || !output_path) {
+        log_msg(LOG_ERROR, "转换清单参数错误");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    ManifestReader reader;
+    int result = manifest_open(&reader, input_path);
+    if (result != MIRRORGUARD_OK) return result;
+    int fields = manifest_output_fields() == 0 ? 0 : reader.fields;
+
+    char temp_manifest[MAX_PATH];
+    snprintf(temp_manifest, sizeof(temp_manifest), "%s.tmp.%d", output_path, getpid());
+
+    size_t total = 0;
+    if (manifest_output_binary()) {
+        // 二进制清单要求按路径排序 (文本清单的顺序不定)
+        FileList *list = create_file_list();
+        if (!list) {
+            manifest_close(&reader);
+            return MIRRORGUARD_ERROR_MEMORY;
+        }
+        file_list_set_memory_limit(list, config.memory_limit);
+        manifest_for_each(&reader, add_convert_entry, list);
+        total = file_list_total(list);
+
+        const char *roots[MAX_SOURCE_DIRS];
+        int root_count = 0;
+        while (reader.cursor && root_count < MAX_SOURCE_DIRS &&
+               (roots[root_count] = mgidx_root(&reader.index, root_count)) != NULL) {
+            root_count++;
+        }
+        if (!config.dry_run) {
+            result = mgidx_write(temp_manifest, list, reader.algo, fields, roots, root_count);
+        }
+        free_file_list(list);
+    } else {
+        total = reader.count;
+        if (!config.dry_run) {
+            ManifestWriter writer;
+            result = manifest_writer_open(&writer, temp_manifest, reader.algo, fields, config.compress);
+            if (result == MIRRORGUARD_OK) {
+                // 分片清单转换后仍保留其分片声明
+                if (reader.shard_count > 0) {
+                    shard_format(writer.shard, sizeof(writer.shard), reader.shard_index, reader.shard_count,
+                                 reader.shard_by_dir);
+                }
+                int write_failed = write_text_manifest(&writer, &reader) != 0;
+                if (manifest_writer_close(&writer) != 0 || write_failed) {
+                    log_msg(LOG_ERROR, "写入清单失败: %s", strerror(errno));
+                    result = MIRRORGUARD_ERROR_FILE_IO;
+                }
+            }
+        }
+    }
+    if (result == MIRRORGUARD_OK && reader.failed) {
+        log_msg(LOG_ERROR, "输入清单读取不完整，未写出结果");
+        result = MIRRORGUARD_ERROR_INVALID_FORMAT;
+    }
+    manifest_close(&reader);
+
+    if (!config.dry_run && result == MIRRORGUARD_OK && rename(temp_manifest, output_path) != 0) {
+        log_msg(LOG_ERROR, "无法完成清单: %s", strerror(errno));
+        result = MIRRORGUARD_ERROR_FILE_IO;
+    }
+    if (result != MIRRORGUARD_OK) {
+        if (!config.dry_run) unlink(temp_manifest);
+        return result;
+    }
+
+    if (total > 0) {
+        log_msg(LOG_INFO, "清单转换完成: %s (%zu 个条目)", output_path, total);
+    } else {
+        log_msg(LOG_INFO, "清单转换完成: %s", output_path);
+    }
+    return MIRRORGUARD_OK;
+}
+
+// 按路径查询清单条目，找到的条目以清单自身的格式输出到标准输出
+int lookup_manifest(const char *manifest_path, char *const *paths, int path_count) {
+    if (!manifest_path || !paths || path_count <= 0) {
+        log_msg(LOG_ERROR, "查询清单参数错误");
+        return MIRRORGUARD_ERROR_INVALID_ARGS;
+    }
+
+    ManifestReader reader;
+    int result = manifest_open(&reader, manifest_path);
+    if (result != MIRRORGUARD_OK) return result;
+
+    for (int i = 0; i < path_count; i++) {
+        char *rel_path = normalize_path(paths[i]);
+        ManifestEntry entry;
+        if (!rel_path || !manifest_lookup(&reader, rel_path, &entry)) {
+            log_msg(LOG_WARN, "清单中没有: %s", paths[i]);
+            result = MIRRORGUARD_ERROR_GENERAL;
+            free(rel_path);
+            continue;
+        }
+        FileInfo info;
+        info.path = rel_path;
+        info.digest = entry.digest;
+        info.size = entry.size < 0 ? 0 : (size_t)entry.size;
+        info.mtime = entry.mtime < 0 ? 0 : (time_t)entry.mtime;
+        manifest_write_entry(stdout, &info, reader.algo, reader.fields);
+        free(rel_path);
+    }
+    fflush(stdout);
+
+    manifest_close(&reader);
+    return result;
+}
@@ -0,0 +1,42 @@
+# 测试公用函数 (由各 test_*.sh 引入)：MG 为被测程序，WORK 为本测试的临时目录，结束时删除
+MG=${MG:?需要设置 MG 为 mirrorguard 路径}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/mgtest.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+set -e
+
+fail() {
+    echo "  FAIL: $*" >&2
+    exit 1
+}
+
+# 运行命令并检查退出码，输出保存在 $WORK/out
+expect_rc() {
+    want=$1
+    shift
+    set +e
+    "$@" >"$WORK/out" 2>&1
+    rc=$?
+    set -e
+    if [ "$rc" -ne "$want" ]; then
+        cat "$WORK/out" >&2
+        fail "期望退出码 $want，实际 $rc: $*"
+    fi
+}
+
+# 在 $1 下生成一棵小目录树：若干子目录、空文件、较大文件与带空格的文件名
+make_tree() {
+    mkdir -p "$1/a/b" "$1/c" "$1/d e"
+    for i in 1 2 3 4 5 6 7 8; do
+        echo "file $i" >"$1/a/f$i"
+        echo "nested $i" >"$1/a/b/g$i"
+        echo "other $i" >"$1/c/h$i"
+    done
+    : >"$1/empty"
+    echo "spaced" >"$1/d e/x y"
+    dd if=/dev/urandom of="$1/c/big" bs=1024 count=300 2>/dev/null
+}
+
+# 当前构建可用的摘要算法 (来自 --version)
+available_algos() {
+    "$MG" --version | sed -n 's/^摘要算法: //p' | tr '/' ' '
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# 运行 tests/test_*.sh：每个脚本独立运行，用法: run_tests.sh <mirrorguard 路径>
+dir=$(cd "$(dirname "$0")" && pwd)
+MG=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+export MG
+
+passed=0
+failed=0
+for t in "$dir"/test_*.sh; do
+    name=$(basename "$t" .sh)
+    if sh "$t" >/dev/null; then
+        echo "✅ $name"
+        passed=$((passed + 1))
+    else
+        echo "❌ $name"
+        failed=$((failed + 1))
+    fi
+done
+
+echo "通过 $passed，失败 $failed"
+[ "$failed" -eq 0 ]
@@ -0,0 +1,34 @@
+#!/bin/sh
+# 摘要引擎：当前构建可用的每种算法都能生成并验证清单，内容改动可被发现；已移除/未知的算法被拒绝
+. "$(dirname "$0")/lib.sh"
+
+make_tree "$WORK/src"
+for algo in $(available_algos); do
+    expect_rc 0 "$MG" -q -F --algo "$algo" -g "$WORK/src" "$WORK/m.$algo"
+    head -1 "$WORK/m.$algo" | grep -q "algo=$algo" || fail "$algo: 清单头未记录算法"
+    expect_rc 0 "$MG" -q -v "$WORK/src" "$WORK/m.$algo"
+
+    # 树哈希使用同一引擎
+    expect_rc 0 "$MG" -q -F --algo "$algo" --tree-hash --block-size 64K -g "$WORK/src" "$WORK/t.$algo"
+    grep -q "tree-$algo:" "$WORK/t.$algo" || fail "$algo: 缺少树哈希条目"
+    expect_rc 0 "$MG" -q -v "$WORK/src" "$WORK/t.$algo"
+done
+
+# 同样大小的改动只能由摘要发现
+cp -r "$WORK/src" "$WORK/mod"
+echo "file X" >"$WORK/mod/a/f1"
+for algo in $(available_algos); do
+    expect_rc 5 "$MG" -q -v "$WORK/mod" "$WORK/m.$algo"
+done
+
+expect_rc 2 "$MG" -q -F --algo blake2b -g "$WORK/src" "$WORK/x"
+expect_rc 2 "$MG" -q -F --algo md5 -g "$WORK/src" "$WORK/x"
+
+# 树哈希校验失败时按块摘要文件定位损坏区间；块摘要文件中超大的块序号只报告为缺少的块
+cp -r "$WORK/src" "$WORK/blk"
+expect_rc 0 "$MG" -q -F --tree-hash --block-size 64K -g "$WORK/blk" "$WORK/t"
+printf 'X' | dd of="$WORK/blk/c/big" bs=1 seek=70000 conv=notrunc 2>/dev/null
+sed -n 's/^0 \([0-9a-f]*\) \*c\/big$/9223372036854775808 \1 *c\/big/p' "$WORK/t.blocks" >>"$WORK/t.blocks"
+expect_rc 5 timeout 30 "$MG" -q -v "$WORK/blk" "$WORK/t"
+grep -q "损坏区间: c/big 字节 \[65536, 131072) (块 1-1)" "$WORK/out" || fail "未定位损坏区间"
+grep -q "缺少块: c/big" "$WORK/out" || fail "未报告块摘要文件多出的块"
@@ -0,0 +1,38 @@
+#!/bin/sh
+# 协调器与 worker：多个 worker 分担哈希，结果与本地生成的清单一致
+. "$(dirname "$0")/lib.sh"
+
+make_tree "$WORK/src"
+for d in 1 2 3 4; do
+    mkdir "$WORK/src/many$d"
+    for i in $(seq 1 100); do echo "$d $i" >"$WORK/src/many$d/f$i"; done
+done
+expect_rc 0 "$MG" -q -F -g "$WORK/src" "$WORK/ref"
+
+# 先启动协调器，开始监听后暂停它，两个 worker 都进入连接队列后再继续；
+# 否则一个 worker 可能在另一个连上之前就做完全部文件，协调器已退出
+sock="$WORK/mg.sock"
+"$MG" -q -F --coordinator "unix:$sock" -g "$WORK/src" "$WORK/m" >"$WORK/c.log" 2>&1 &
+coordinator=$!
+for i in $(seq 1 50); do
+    [ -S "$sock" ] && break
+    sleep 0.1
+done
+sleep 0.2
+kill -STOP "$coordinator"
+"$MG" -q --threads 2 --worker "unix:$sock" >"$WORK/w1.log" 2>&1 &
+w1=$!
+"$MG" -q --threads 3 --worker "unix:$sock" >"$WORK/w2.log" 2>&1 &
+w2=$!
+sleep 0.5
+kill -CONT "$coordinator"
+
+for p in coordinator:c w1:w1 w2:w2; do
+    set +e
+    eval "wait \$${p%%:*}"
+    rc=$?
+    set -e
+    [ "$rc" -eq 0 ] || { cat "$WORK/${p#*:}.log" >&2; fail "${p%%:*} 退出码 $rc"; }
+done
+cmp -s "$WORK/ref" "$WORK/m" || fail "分布式生成的清单与本地生成的不同"
+[ ! -e "$sock" ] || fail "未删除套接字文件"
@@ -0,0 +1,78 @@
+#!/bin/sh
+# 分块压缩清单 (-z)：往返转换一致，可直接 zcat，按块查找，拒绝损坏的块索引
+# (需要 zlib 构建；块索引字段按小端读写)
+. "$(dirname "$0")/lib.sh"
+
+"$MG" --version | grep -q "分块压缩清单: zlib" || {
+    echo "跳过: 当前构建不支持压缩清单"
+    exit 0
+}
+
+# 约 1.8 MiB 文本的清单，分成多块
+awk 'BEGIN {
+    print "# mirrorguard algo=sha256 fields=size count=20000"
+    for (d = 0; d < 100; d++)
+        for (i = 0; i < 200; i++)
+            printf "%064d %d *dir%03d/file%06d\n", d * 200 + i, i, d, d * 200 + i
+}' >"$WORK/in.txt"
+
+sed 1d "$WORK/in.txt" >"$WORK/in.txt.body"
+expect_rc 0 "$MG" -q -F -z --convert "$WORK/in.txt" "$WORK/m.gz"
+gzip -t "$WORK/m.gz" || fail "gzip -t 校验失败"
+zcat "$WORK/m.gz" >"$WORK/zcat.txt"
+sed 1d "$WORK/zcat.txt" | cmp -s - "$WORK/in.txt.body" || fail "zcat 输出的条目与输入不同"
+expect_rc 0 "$MG" -q -F --convert "$WORK/m.gz" "$WORK/back.txt"
+sed 1d "$WORK/back.txt" | cmp -s - "$WORK/in.txt.body" || fail "压缩清单转回文本的条目与输入不同"
+
+# 首条、末条、块边界附近与不存在的路径
+for p in dir000/file000000 dir099/file019999 dir050/file010000 dir049/file009999; do
+    expect_rc 0 "$MG" --lookup "$WORK/m.gz" "$p"
+    [ "$(cat "$WORK/out")" = "$(grep -F "*$p" "$WORK/in.txt")" ] || fail "查找 $p 结果不符"
+done
+for p in a dir050/file0100000 zzz; do
+    expect_rc 1 "$MG" --lookup "$WORK/m.gz" "$p"
+done
+
+# 在 $1 的偏移 $2 处写入八进制字节 $3
+patch_byte() {
+    printf "\\$3" | dd of="$1" bs=1 seek="$2" conv=notrunc 2>/dev/null
+}
+
+expect_corrupt() {
+    expect_rc 7 "$MG" --lookup "$1" dir000/file000000
+    grep -q "$2" "$WORK/out" || { cat "$WORK/out" >&2; fail "$1: 未报告 $2"; }
+}
+
+# 尾部成员 66 字节，其附加数据 (索引偏移 u64 | 块数 u64 | ...) 从倒数第 50 字节开始
+size=$(wc -c <"$WORK/m.gz")
+footer=$((size - 50))
+index_offset=$(od -A n -t u8 -j "$footer" -N 8 "$WORK/m.gz" | tr -d ' ')
+first=$((index_offset + 16))    # 第一个块索引项 (空成员头 10 字节 + 附加字段头 6 字节之后)
+
+head -c $((size - 1)) "$WORK/m.gz" >"$WORK/truncated.gz"
+expect_corrupt "$WORK/truncated.gz" "缺少块索引"
+
+cp "$WORK/m.gz" "$WORK/usize.gz"             # 首块解压长度改为 4 GiB 附近
+patch_byte "$WORK/usize.gz" $((first + 15)) 377
+expect_corrupt "$WORK/usize.gz" "块索引损坏"
+
+cp "$WORK/m.gz" "$WORK/csize.gz"             # 首块压缩长度越过块索引
+patch_byte "$WORK/csize.gz" $((first + 11)) 177
+expect_corrupt "$WORK/csize.gz" "块索引损坏"
+
+cp "$WORK/m.gz" "$WORK/offset.gz"            # 首块偏移越过块索引
+patch_byte "$WORK/offset.gz" $((first + 7)) 001
+expect_corrupt "$WORK/offset.gz" "块索引损坏"
+
+cp "$WORK/m.gz" "$WORK/count.gz"             # 块数多于索引项
+patch_byte "$WORK/count.gz" $((footer + 8)) 377
+expect_corrupt "$WORK/count.gz" "块索引损坏"
+
+cp "$WORK/m.gz" "$WORK/index-offset.gz"      # 索引偏移越过尾部
+patch_byte "$WORK/index-offset.gz" $((footer + 7)) 001
+expect_corrupt "$WORK/index-offset.gz" "块索引损坏"
+
+# 生成与验证直接使用压缩清单
+make_tree "$WORK/src"
+expect_rc 0 "$MG" -q -F -z -g "$WORK/src" "$WORK/src.gz"
+expect_rc 0 "$MG" -q -v "$WORK/src" "$WORK/src.gz"
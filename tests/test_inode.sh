@@ -0,0 +1,25 @@
+#!/bin/sh
+# 同一 inode 的多个路径 (硬链接、-f 下的符号链接) 只读取一次，其余路径复用摘要
+. "$(dirname "$0")/lib.sh"
+
+# 链接都在子目录中，目标文件通常先被扫描到
+mkdir -p "$WORK/src/d" "$WORK/src/e"
+dd if=/dev/urandom of="$WORK/src/a" bs=1024 count=200 2>/dev/null
+ln -s ../a "$WORK/src/d/l1"
+ln -s ../a "$WORK/src/e/l2"
+
+# 文件本身无论先于还是晚于链接被扫描到，另外两个路径都复用摘要
+expect_rc 0 "$MG" -F -f -g "$WORK/src" "$WORK/m"
+grep -q "同一 inode 的 2 个路径复用已有摘要" "$WORK/out" || {
+    cat "$WORK/out" >&2
+    fail "-f: 符号链接与目标文件未共用一次读取"
+}
+[ "$(grep -c '\*\(a\|d/l1\|e/l2\)$' "$WORK/m")" -eq 3 ] || fail "-f: 清单缺少链接路径"
+[ "$(grep '\*\(a\|d/l1\|e/l2\)$' "$WORK/m" | cut -d' ' -f1 | sort -u | wc -l)" -eq 1 ] ||
+    fail "-f: 链接路径与目标文件摘要不同"
+
+# 硬链接
+ln "$WORK/src/a" "$WORK/src/h"
+expect_rc 0 "$MG" -F -g "$WORK/src" "$WORK/m2"
+grep -q "同一 inode 的 1 个路径复用已有摘要" "$WORK/out" || fail "硬链接未共用一次读取"
+expect_rc 0 "$MG" -q -v "$WORK/src" "$WORK/m2"
@@ -0,0 +1,10 @@
+#!/bin/sh
+# 读取路径：各缓存模式与 I/O 引擎 (含小文件) 生成的清单与默认路径一致
+. "$(dirname "$0")/lib.sh"
+
+make_tree "$WORK/src"
+expect_rc 0 "$MG" -q -F -g "$WORK/src" "$WORK/ref"
+for opt in --cache-mode=dontneed --cache-mode=direct --io-engine=uring; do
+    expect_rc 0 "$MG" -q -F $opt -g "$WORK/src" "$WORK/m"
+    cmp -s "$WORK/ref" "$WORK/m" || fail "$opt: 清单与默认路径不同"
+done
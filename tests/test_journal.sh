@@ -0,0 +1,44 @@
+#!/bin/sh
+# 续传日志：仅在 --resume/--journal 时记录，生成失败后保留，--resume 按 (源目录, 相对路径) 复用已完成的文件
+. "$(dirname "$0")/lib.sh"
+
+# 两个源目录中有相对路径、大小、mtime 都相同但内容不同的文件
+mkdir -p "$WORK/r1/d" "$WORK/r2/d"
+echo aaaa >"$WORK/r1/d/x"
+echo bbbb >"$WORK/r2/d/x"
+echo only >"$WORK/r1/y"
+touch -d 2020-01-01 "$WORK/r1/d/x" "$WORK/r2/d/x"
+cd "$WORK"
+expect_rc 0 "$MG" -q -F -g r1 r2 ref
+
+# 清单写入失败 (目录不存在)：日志保留已完成的文件
+expect_rc 3 "$MG" -q -F --journal j -g r1 r2 nodir/m
+[ "$(grep -c '\*' j)" -eq 3 ] || fail "日志未记录全部已完成文件"
+
+expect_rc 0 "$MG" -F --resume --journal j -g r1 r2 m
+grep -q "复用 3 个已完成文件" "$WORK/out" || fail "未复用日志中的文件"
+cmp -s ref m || fail "续传结果与完整生成不同"
+[ ! -e j ] || fail "成功后未删除日志"
+
+# 源目录列表不同 (数目不同，或数目相同但目录不同) 的日志不能续传
+cp -r r2 r3
+echo cccc >r3/d/x
+touch -d 2020-01-01 r3/d/x
+expect_rc 3 "$MG" -q -F --journal j -g r1 r2 nodir/m
+expect_rc 8 "$MG" -q -F --resume --journal j -g r1 m
+expect_rc 8 "$MG" -q -F --resume --journal j -g r1 r3 m
+expect_rc 8 "$MG" -q -F --resume --journal j -g r2 r1 m
+# 同一目录的不同写法视为相同
+expect_rc 0 "$MG" -F --resume --journal j -g ./r1 "$WORK/r2/" m
+grep -q "复用 3 个已完成文件" "$WORK/out" || fail "同一源目录的另一种写法未复用日志"
+
+# 未指定 --resume/--journal 时不写日志
+expect_rc 0 "$MG" -q -F -g r1 r2 plain
+[ ! -e plain.journal ] || fail "未要求续传时写了日志"
+expect_rc 3 "$MG" -q -F -g r1 r2 nodir/plain
+if ls "$WORK" | grep -q journal; then fail "未要求续传时写了日志"; fi
+
+# 只有 --resume 时使用默认路径，成功后删除
+mkdir "$WORK/out-dir"
+expect_rc 0 "$MG" -q -F --resume -g r1 r2 out-dir/m
+[ ! -e out-dir/m.journal ] || fail "成功后未删除默认路径的日志"
@@ -0,0 +1,74 @@
+#!/bin/sh
+# 二进制清单 (.mgidx)：与文本清单往返转换一致，按路径查找首/末/中间/不存在的条目，拒绝结构损坏的文件
+# (损坏用例按小端字节序改写文件头字段)
+. "$(dirname "$0")/lib.sh"
+
+# 跨越多个重启点 (每 16 条一个) 的目录树
+mkdir -p "$WORK/src/a" "$WORK/src/z"
+for i in $(seq 1 40); do echo "$i" >"$WORK/src/a/f$i"; done
+echo first >"$WORK/src/0first"
+echo last >"$WORK/src/z/zz"
+
+expect_rc 0 "$MG" -q -F --record-mtime -g "$WORK/src" "$WORK/m.txt"
+expect_rc 0 "$MG" -q -F -o mgidx -g "$WORK/src" "$WORK/m.idx"
+expect_rc 0 "$MG" -q -F --convert "$WORK/m.idx" "$WORK/back.txt"
+cmp -s "$WORK/m.txt" "$WORK/back.txt" || fail "mgidx 转回文本与直接生成的文本清单不同"
+expect_rc 0 "$MG" -q -F -o mgidx --convert "$WORK/m.txt" "$WORK/m2.idx"
+expect_rc 0 "$MG" -q -F --convert "$WORK/m2.idx" "$WORK/back2.txt"
+cmp -s "$WORK/m.txt" "$WORK/back2.txt" || fail "文本经 mgidx 往返后不同"
+expect_rc 0 "$MG" -q -v "$WORK/src" "$WORK/m.idx"
+
+# 查找：首条、末条、任意顺序的全部条目
+first=$(sed -n 2p "$WORK/m.txt")
+last=$(tail -1 "$WORK/m.txt")
+expect_rc 0 "$MG" --lookup "$WORK/m.idx" 0first
+[ "$(cat "$WORK/out")" = "$first" ] || fail "首条查找结果不符"
+expect_rc 0 "$MG" --lookup "$WORK/m.idx" z/zz
+[ "$(cat "$WORK/out")" = "$last" ] || fail "末条查找结果不符"
+sed '1d' "$WORK/m.txt" | sort -r >"$WORK/expect"
+expect_rc 0 "$MG" --lookup "$WORK/m.idx" $(sed 's/.*\*//' "$WORK/expect")
+cmp -s "$WORK/expect" "$WORK/out" || fail "逐条查找结果与文本清单不同"
+
+# 不存在的路径 (排在首条之前、中间、末条之后) 只警告并返回 1
+for p in 0 a/f100 zzz; do
+    expect_rc 1 "$MG" --lookup "$WORK/m.idx" "$p"
+    grep -q "清单中没有" "$WORK/out" || fail "缺失路径 $p 未报告"
+done
+
+# 在 $1 的偏移 $2 处写入八进制字节 $3
+patch_byte() {
+    printf "\\$3" | dd of="$1" bs=1 seek="$2" conv=notrunc 2>/dev/null
+}
+
+expect_corrupt() {
+    expect_rc 7 "$MG" --lookup "$1" 0first
+    grep -q "损坏\|不支持\|不是" "$WORK/out" || { cat "$WORK/out" >&2; fail "$1: 未报告清单损坏"; }
+}
+
+size=$(wc -c <"$WORK/m.idx")
+head -c 40 "$WORK/m.idx" >"$WORK/short-header.idx"
+expect_corrupt "$WORK/short-header.idx"
+head -c $((size - 10)) "$WORK/m.idx" >"$WORK/short-paths.idx"
+expect_corrupt "$WORK/short-paths.idx"
+head -c 1000 "$WORK/m.idx" >"$WORK/short-records.idx"
+expect_corrupt "$WORK/short-records.idx"
+
+cp "$WORK/m.idx" "$WORK/record-size.idx"   # record_size (偏移 12) 加一
+patch_byte "$WORK/record-size.idx" 12 071
+expect_corrupt "$WORK/record-size.idx"
+
+cp "$WORK/m.idx" "$WORK/paths-offset.idx"  # paths_offset (偏移 56) 最高字节
+patch_byte "$WORK/paths-offset.idx" 63 001
+expect_corrupt "$WORK/paths-offset.idx"
+
+cp "$WORK/m.idx" "$WORK/index-offset.idx"  # index_offset (偏移 40) 未按 8 字节对齐
+patch_byte "$WORK/index-offset.idx" 40 115
+expect_corrupt "$WORK/index-offset.idx"
+
+cp "$WORK/m.idx" "$WORK/records-offset.idx" # records_offset (偏移 48) 小于 index_offset
+patch_byte "$WORK/records-offset.idx" 48 010
+expect_corrupt "$WORK/records-offset.idx"
+
+cp "$WORK/m.idx" "$WORK/count.idx"         # count (偏移 24) 超出记录区
+patch_byte "$WORK/count.idx" 24 377
+expect_corrupt "$WORK/count.idx"
@@ -0,0 +1,55 @@
+#!/bin/sh
+# 分片：各分片清单的并集与不分片的清单一致 (按路径/按首级目录)，--merge 拒绝重叠、重复、缺失与头部不一致的分片
+. "$(dirname "$0")/lib.sh"
+
+make_tree "$WORK/src"
+for i in $(seq 1 30); do echo "$i" >"$WORK/src/a/b/n$i"; done
+for i in $(seq 1 12); do mkdir "$WORK/src/top$i" && echo "$i" >"$WORK/src/top$i/t"; done
+cd "$WORK"
+expect_rc 0 "$MG" -q -F -g src full
+sed 1d full >full.body
+
+for by in path dir; do
+    for i in 1 2 3; do
+        expect_rc 0 "$MG" -q -F --shard "$i/3" --shard-by "$by" -g src "s$by.$i"
+        head -1 "s$by.$i" | grep -q "shard=$i/3" || fail "$by: 分片头缺少 shard=$i/3"
+    done
+
+    # 分片互不重叠，并集等于完整清单
+    cat "s$by.1" "s$by.2" "s$by.3" | grep -v '^#' | sort -t '*' -k 2 >union
+    sort -t '*' -k 2 full.body | cmp -s - union || fail "$by: 分片并集与完整清单不同"
+
+    # 合并 (任意输入顺序) 得到完整清单，头部不再带分片字段
+    expect_rc 0 "$MG" -q -F --merge "merged.$by" "s$by.3" "s$by.1" "s$by.2"
+    head -1 "merged.$by" | grep -q shard && fail "$by: 合并结果仍带分片字段"
+    sed 1d "merged.$by" | cmp -s - full.body || fail "$by: 合并结果与完整清单不同"
+    expect_rc 0 "$MG" -q -v src "merged.$by"
+done
+
+# 重复、缺失的分片
+expect_rc 8 "$MG" -q -F --merge bad spath.1 spath.1 spath.2 spath.3
+grep -q "重复" "$WORK/out" || fail "未报告重复分片"
+expect_rc 2 "$MG" -q -F --merge bad spath.1 spath.2
+grep -q "缺少分片 3/3" "$WORK/out" || fail "未报告缺失分片"
+
+# 头部不一致：分片数、分片依据
+expect_rc 0 "$MG" -q -F --shard 2/2 -g src half.2
+expect_rc 8 "$MG" -q -F --merge bad spath.1 half.2 spath.3
+grep -q "分片方式不一致" "$WORK/out" || fail "未报告分片数不一致"
+expect_rc 8 "$MG" -q -F --merge bad spath.1 sdir.2 spath.3
+grep -q "分片方式不一致" "$WORK/out" || fail "未报告分片依据不一致"
+
+# 头部不一致：摘要算法 (当前构建有多种算法时)
+other=$(available_algos | tr ' ' '\n' | grep -v '^sha256$' | head -1)
+if [ -n "$other" ]; then
+    expect_rc 0 "$MG" -q -F --algo "$other" --shard 2/3 -g src other.2
+    expect_rc 8 "$MG" -q -F --merge bad spath.1 other.2 spath.3
+    grep -q "摘要算法不一致" "$WORK/out" || fail "未报告摘要算法不一致"
+fi
+
+# 头部声称互补但内容重叠的分片
+{ echo "# mirrorguard algo=sha256 fields=size shard=1/2"; cat full.body; } >overlap.1
+{ echo "# mirrorguard algo=sha256 fields=size shard=2/2"; grep 'a/f1$' full.body; } >overlap.2
+expect_rc 8 "$MG" -q -F --merge bad overlap.1 overlap.2
+grep -q "分片重叠: a/f1 " "$WORK/out" || fail "未报告重叠的路径"
+[ ! -e bad ] || fail "合并失败时留下了输出文件"
@@ -0,0 +1,15 @@
+#!/bin/sh
+# 验证时的排除规则：超长路径的清单条目同样受 -x/-i 约束，未被排除时按错误报告
+. "$(dirname "$0")/lib.sh"
+
+make_tree "$WORK/src"
+expect_rc 0 "$MG" -q -F -g "$WORK/src" "$WORK/m"
+
+long=skip/$(printf '%05000d' 0)
+sed 's/count=[0-9]*//' "$WORK/m" >"$WORK/long"
+echo "0000000000000000000000000000000000000000000000000000000000000000 1 *$long" >>"$WORK/long"
+
+expect_rc 0 "$MG" -q -e -x /skip -v "$WORK/src" "$WORK/long"
+expect_rc 0 "$MG" -q -e -i 'a/**' -i '*/h*' -i big -i empty -i '*y' -v "$WORK/src" "$WORK/long"
+expect_rc 5 "$MG" -q -e -v "$WORK/src" "$WORK/long"
+grep -q "路径过长" "$WORK/out" || fail "超长路径未按错误报告"